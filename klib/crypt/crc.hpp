@@ -0,0 +1,154 @@
+#ifndef KLIB_CRC_HPP
+#define KLIB_CRC_HPP
+
+#include <cstdint>
+#include <array>
+#include <span>
+
+namespace klib::crypt::detail {
+    /**
+     * @brief Generate the lookup table of a msb first crc16 for
+     * every byte value
+     *
+     * @param polynomial
+     * @return std::array<uint16_t, 256>
+     */
+    consteval std::array<uint16_t, 256> crc16_table(const uint16_t polynomial) {
+        std::array<uint16_t, 256> result = {};
+
+        for (uint32_t i = 0; i < result.size(); i++) {
+            uint16_t crc = static_cast<uint16_t>(i << 8);
+
+            for (uint32_t b = 0; b < 8; b++) {
+                crc = (crc & 0x8000) ? ((crc << 1) ^ polynomial) : (crc << 1);
+            }
+
+            result[i] = crc;
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Generate the lookup table of a lsb first (reflected) crc32
+     * for every byte value
+     *
+     * @param polynomial reflected polynomial
+     * @return std::array<uint32_t, 256>
+     */
+    consteval std::array<uint32_t, 256> crc32_table(const uint32_t polynomial) {
+        std::array<uint32_t, 256> result = {};
+
+        for (uint32_t i = 0; i < result.size(); i++) {
+            uint32_t crc = i;
+
+            for (uint32_t b = 0; b < 8; b++) {
+                crc = (crc & 0x1) ? ((crc >> 1) ^ polynomial) : (crc >> 1);
+            }
+
+            result[i] = crc;
+        }
+
+        return result;
+    }
+}
+
+namespace klib::crypt {
+    /**
+     * @brief Crc7 with the polynomial x^7 + x^3 + 1 (used by sd/mmc
+     * cards for the commands)
+     *
+     */
+    class crc7 {
+    public:
+        /**
+         * @brief Calculate the crc7 over the data
+         *
+         * @param data
+         * @param crc previous crc result when calculating in multiple parts
+         * @return uint8_t 7 bit crc
+         */
+        constexpr static uint8_t calculate(const std::span<const uint8_t> data, uint8_t crc = 0x00) {
+            for (auto d : data) {
+                // process every bit starting with the msb
+                for (uint32_t i = 0; i < 8; i++) {
+                    crc <<= 1;
+
+                    if ((d ^ crc) & 0x80) {
+                        crc ^= 0x09;
+                    }
+
+                    d <<= 1;
+                }
+            }
+
+            return crc & 0x7f;
+        }
+    };
+
+    /**
+     * @brief Crc16 ccitt with the polynomial x^16 + x^12 + x^5 + 1 and
+     * a initial value of 0x0000 (xmodem). Used by sd/mmc cards for the
+     * data blocks
+     *
+     * @details uses a 256 entry lookup table (512 bytes) to process a
+     * whole byte per iteration
+     *
+     */
+    class crc16 {
+    protected:
+        // lookup table with the crc of every byte value
+        constexpr static std::array<uint16_t, 256> table = detail::crc16_table(0x1021);
+
+    public:
+        /**
+         * @brief Calculate the crc16 over the data
+         *
+         * @param data
+         * @param crc previous crc result when calculating in multiple parts
+         * @return uint16_t
+         */
+        constexpr static uint16_t calculate(const std::span<const uint8_t> data, uint16_t crc = 0x0000) {
+            for (const auto d : data) {
+                crc = (crc << 8) ^ table[((crc >> 8) ^ d) & 0xff];
+            }
+
+            return crc;
+        }
+    };
+
+    /**
+     * @brief Crc32 with the polynomial 0x04c11db7 (ethernet, zip, dfu
+     * suffix). Uses a initial value and final xor of 0xffffffff
+     *
+     * @details uses a 256 entry lookup table (1024 bytes) to process a
+     * whole byte per iteration
+     *
+     */
+    class crc32 {
+    protected:
+        // lookup table with the crc of every byte value
+        constexpr static std::array<uint32_t, 256> table = detail::crc32_table(0xedb88320);
+
+    public:
+        /**
+         * @brief Calculate the crc32 over the data
+         *
+         * @param data
+         * @param crc previous crc result when calculating in multiple parts
+         * @return uint32_t
+         */
+        constexpr static uint32_t calculate(const std::span<const uint8_t> data, const uint32_t crc = 0x00000000) {
+            // undo the final xor of the previous result
+            uint32_t result = ~crc;
+
+            for (const auto d : data) {
+                result = (result >> 8) ^ table[(result ^ d) & 0xff];
+            }
+
+            return ~result;
+        }
+    };
+}
+
+#endif
@@ -466,6 +466,57 @@ namespace klib::graphics {
             set_pixel(position, graphics::detail::color_to_raw<Mode>(col));
         }
 
+        /**
+         * @brief Get a pixel from the framebuffer (raw pixel data)
+         *
+         * @param position
+         * @return color_type
+         */
+        constexpr color_type get_pixel(const klib::vector2u &position) const {
+            color_type raw = 0;
+
+            // get the data using the same layout as set pixel
+            if constexpr ((color_mode::bits % 8) == 0) {
+                constexpr uint32_t bytes = ((color_mode::bits + 7) / 8);
+
+                // index to read the data from
+                const auto index = ((position.y * width) + position.x) * bytes;
+
+                for (uint32_t i = 0; i < bytes; i++) {
+                    if constexpr (Endian == std::endian::big) {
+                        raw |= static_cast<color_type>(buffer[index + i]) << (((bytes - 1) * 8) - (i * 8));
+                    }
+                    else {
+                        raw |= static_cast<color_type>(buffer[index + i]) << (i * 8);
+                    }
+                }
+            }
+            else {
+                // get the amount of bits before the current pixel
+                const uint32_t bits = ((position.y * width) + position.x) * color_mode::bits;
+
+                // get all the bits
+                for (uint32_t i = 0; i < color_mode::bits; ) {
+                    const uint32_t index = ((bits + i) / 8);
+                    const uint32_t shift = ((bits + i) % 8);
+
+                    // check how many bits we can read
+                    const uint32_t update = klib::min(8 - shift, (color_mode::bits - i));
+
+                    // get the mask where we want to read
+                    const uint32_t mask = (klib::exp2(update) - 1);
+
+                    // get the bits
+                    raw |= ((buffer[index] >> (8 - (shift + update))) & mask) << ((color_mode::bits - i) - update);
+
+                    // update the bit index
+                    i += update;
+                }
+            }
+
+            return raw;
+        }
+
         /**
          * @brief Clear the framebuffer with the specified color (raw pixel data)
          *
@@ -0,0 +1,621 @@
+#ifndef KLIB_GRAPHICS_JPEG_HPP
+#define KLIB_GRAPHICS_JPEG_HPP
+
+#include <cstdint>
+#include <array>
+#include <span>
+
+#include <klib/math.hpp>
+#include <klib/vector2.hpp>
+#include <klib/graphics/color.hpp>
+
+namespace klib::graphics::detail::jpeg {
+    /**
+     * @brief Huffman code with the amount of bits in the code
+     *
+     */
+    struct huffman_code {
+        uint16_t code;
+        uint8_t size;
+    };
+
+    // natural order index of every coefficient in zigzag order
+    constexpr std::array<uint8_t, 64> zigzag = {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+    };
+
+    // example luminance quantization table (natural order) from
+    // annex k of the jpeg specification
+    constexpr std::array<uint8_t, 64> luminance_quantization = {
+        16, 11, 10, 16, 24, 40, 51, 61,
+        12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56,
+        14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77,
+        24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101,
+        72, 92, 95, 98, 112, 100, 103, 99
+    };
+
+    // example chrominance quantization table (natural order) from
+    // annex k of the jpeg specification
+    constexpr std::array<uint8_t, 64> chrominance_quantization = {
+        17, 18, 24, 47, 99, 99, 99, 99,
+        18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99,
+        47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99
+    };
+
+    // standard huffman tables from annex k of the jpeg specification. The
+    // bits contain the amount of codes for every code length (1 - 16)
+    constexpr std::array<uint8_t, 16> dc_luminance_bits = {
+        0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    constexpr std::array<uint8_t, 12> dc_luminance_values = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+    };
+
+    constexpr std::array<uint8_t, 16> dc_chrominance_bits = {
+        0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
+    };
+
+    constexpr std::array<uint8_t, 12> dc_chrominance_values = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+    };
+
+    constexpr std::array<uint8_t, 16> ac_luminance_bits = {
+        0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d
+    };
+
+    constexpr std::array<uint8_t, 162> ac_luminance_values = {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    };
+
+    constexpr std::array<uint8_t, 16> ac_chrominance_bits = {
+        0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
+    };
+
+    constexpr std::array<uint8_t, 162> ac_chrominance_values = {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    };
+
+    /**
+     * @brief Generate the huffman codes for every symbol using the
+     * amount of codes for every code length
+     *
+     * @tparam Size
+     * @param bits
+     * @param values
+     * @return std::array<huffman_code, 256>
+     */
+    template <std::size_t Size>
+    consteval std::array<huffman_code, 256> huffman_table(const std::array<uint8_t, 16>& bits, const std::array<uint8_t, Size>& values) {
+        std::array<huffman_code, 256> result = {};
+
+        uint32_t code = 0;
+        uint32_t index = 0;
+
+        // assign the codes in increasing order for every length
+        for (uint32_t length = 1; length <= bits.size(); length++) {
+            for (uint32_t i = 0; i < bits[length - 1]; i++) {
+                result[values[index]] = {
+                    static_cast<uint16_t>(code),
+                    static_cast<uint8_t>(length)
+                };
+
+                code++;
+                index++;
+            }
+
+            code <<= 1;
+        }
+
+        return result;
+    }
+
+    constexpr auto dc_luminance = huffman_table(dc_luminance_bits, dc_luminance_values);
+    constexpr auto dc_chrominance = huffman_table(dc_chrominance_bits, dc_chrominance_values);
+    constexpr auto ac_luminance = huffman_table(ac_luminance_bits, ac_luminance_values);
+    constexpr auto ac_chrominance = huffman_table(ac_chrominance_bits, ac_chrominance_values);
+}
+
+namespace klib::graphics {
+    /**
+     * @brief Fixed point baseline jpeg encoder. Encodes with 4:2:0
+     * chroma subsampling using the standard huffman tables
+     *
+     * @details the source is read in strips of 16 pixel rows (a single
+     * row of minimum coded units). Only a single minimum coded unit is
+     * stored in ram while encoding. The output is passed in small chunks
+     * to the output callback, this allows the stream to be written
+     * directly into the transfer buffers of a usb camera. The source
+     * needs a static width, height and mode and a get_pixel function
+     * (e.g. klib::graphics::framebuffer)
+     *
+     * @tparam ChunkSize size of the output chunks
+     */
+    template <uint32_t ChunkSize = 64>
+    class jpeg_encoder {
+    protected:
+        // fixed point constants used in the integer dct
+        constexpr static uint32_t const_bits = 13;
+        constexpr static uint32_t pass1_bits = 2;
+
+        // quantization tables in zigzag order (as stored in the file)
+        std::array<uint8_t, 64> luminance = {};
+        std::array<uint8_t, 64> chrominance = {};
+
+        // reciprocal of the quantization divisor (natural order) in
+        // 16.16 fixed point. Includes the scaling of the dct
+        std::array<uint16_t, 64> luminance_reciprocal = {};
+        std::array<uint16_t, 64> chrominance_reciprocal = {};
+
+        // output chunk
+        uint8_t chunk[ChunkSize] = {};
+        uint32_t chunk_size = 0;
+
+        // bit accumulator for the entropy coded data
+        uint32_t bit_buffer = 0;
+        uint32_t bit_count = 0;
+
+        // total amount of bytes written in the current image
+        uint32_t written = 0;
+
+        template <typename Output>
+        void put(Output& output, const uint8_t value) {
+            chunk[chunk_size++] = value;
+            written++;
+
+            // flush the chunk when it is full
+            if (chunk_size >= ChunkSize) {
+                output(std::span<const uint8_t>{chunk, chunk_size});
+                chunk_size = 0;
+            }
+        }
+
+        template <typename Output>
+        void put16(Output& output, const uint16_t value) {
+            put(output, value >> 8);
+            put(output, value & 0xff);
+        }
+
+        template <typename Output>
+        void put_bits(Output& output, const uint32_t code, const uint32_t size) {
+            // add the bits to the accumulator. We never have more than
+            // 7 + 16 bits in the accumulator
+            bit_buffer = (bit_buffer << size) | (code & ((1 << size) - 1));
+            bit_count += size;
+
+            while (bit_count >= 8) {
+                const uint8_t value = (bit_buffer >> (bit_count - 8)) & 0xff;
+
+                put(output, value);
+
+                // stuff a zero byte after every 0xff
+                if (value == 0xff) {
+                    put(output, 0x00);
+                }
+
+                bit_count -= 8;
+            }
+        }
+
+        template <typename Output>
+        void flush_bits(Output& output) {
+            // pad the last byte with ones
+            if (bit_count) {
+                put_bits(output, 0x7f, 8 - bit_count);
+            }
+        }
+
+        template <typename Output, std::size_t Size>
+        void put_table(Output& output, const uint8_t id, const std::array<uint8_t, 16>& bits, const std::array<uint8_t, Size>& values) {
+            put(output, id);
+
+            for (const auto b : bits) {
+                put(output, b);
+            }
+
+            for (const auto v : values) {
+                put(output, v);
+            }
+        }
+
+        template <typename Output>
+        void write_headers(Output& output, const uint16_t width, const uint16_t height) {
+            namespace tables = detail::jpeg;
+
+            // start of image and jfif header
+            constexpr uint8_t jfif[] = {
+                0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+                0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+            };
+
+            for (const auto b : jfif) {
+                put(output, b);
+            }
+
+            // quantization tables
+            put16(output, 0xffdb);
+            put16(output, 2 + (2 * 65));
+
+            put(output, 0x00);
+            for (const auto q : luminance) {
+                put(output, q);
+            }
+
+            put(output, 0x01);
+            for (const auto q : chrominance) {
+                put(output, q);
+            }
+
+            // start of frame (baseline). Luminance is sampled 2x2 and
+            // the chrominance components 1x1
+            put16(output, 0xffc0);
+            put16(output, 17);
+            put(output, 8);
+            put16(output, height);
+            put16(output, width);
+            put(output, 3);
+
+            constexpr uint8_t components[] = {
+                0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01
+            };
+
+            for (const auto b : components) {
+                put(output, b);
+            }
+
+            // huffman tables
+            put16(output, 0xffc4);
+            put16(output, 2 + (4 * 17) + (2 * 12) + (2 * 162));
+
+            put_table(output, 0x00, tables::dc_luminance_bits, tables::dc_luminance_values);
+            put_table(output, 0x10, tables::ac_luminance_bits, tables::ac_luminance_values);
+            put_table(output, 0x01, tables::dc_chrominance_bits, tables::dc_chrominance_values);
+            put_table(output, 0x11, tables::ac_chrominance_bits, tables::ac_chrominance_values);
+
+            // start of scan
+            constexpr uint8_t scan[] = {
+                0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02,
+                0x11, 0x03, 0x11, 0x00, 0x3f, 0x00
+            };
+
+            for (const auto b : scan) {
+                put(output, b);
+            }
+        }
+
+        /**
+         * @brief Integer forward dct on a 8x8 block (islow algorithm from
+         * the independent jpeg group). The output is scaled by 8
+         *
+         * @param block
+         */
+        static void dct(int32_t *const block) {
+            constexpr int32_t fix_0_298631336 = 2446;
+            constexpr int32_t fix_0_390180644 = 3196;
+            constexpr int32_t fix_0_541196100 = 4433;
+            constexpr int32_t fix_0_765366865 = 6270;
+            constexpr int32_t fix_0_899976223 = 7373;
+            constexpr int32_t fix_1_175875602 = 9633;
+            constexpr int32_t fix_1_501321110 = 12299;
+            constexpr int32_t fix_1_847759065 = 15137;
+            constexpr int32_t fix_1_961570560 = 16069;
+            constexpr int32_t fix_2_053119869 = 16819;
+            constexpr int32_t fix_2_562915447 = 20995;
+            constexpr int32_t fix_3_072711026 = 25172;
+
+            // first pass on the rows, second pass on the columns
+            for (uint32_t pass = 0; pass < 2; pass++) {
+                // step between the input values and between the rows/columns
+                const uint32_t step = pass ? 8 : 1;
+                const uint32_t next = pass ? 1 : 8;
+
+                // descale shift for the even and odd parts
+                const uint32_t even_shift = pass ? pass1_bits : 0;
+                const uint32_t odd_shift = pass ? (const_bits + pass1_bits) : (const_bits - pass1_bits);
+
+                const auto descale = [](const int32_t value, const uint32_t shift) {
+                    return shift ? ((value + (1 << (shift - 1))) >> shift) : value;
+                };
+
+                for (uint32_t i = 0; i < 8; i++) {
+                    int32_t *const d = &block[i * next];
+
+                    const int32_t tmp0 = d[0 * step] + d[7 * step];
+                    const int32_t tmp7 = d[0 * step] - d[7 * step];
+                    const int32_t tmp1 = d[1 * step] + d[6 * step];
+                    const int32_t tmp6 = d[1 * step] - d[6 * step];
+                    const int32_t tmp2 = d[2 * step] + d[5 * step];
+                    const int32_t tmp5 = d[2 * step] - d[5 * step];
+                    const int32_t tmp3 = d[3 * step] + d[4 * step];
+                    const int32_t tmp4 = d[3 * step] - d[4 * step];
+
+                    // even part
+                    const int32_t tmp10 = tmp0 + tmp3;
+                    const int32_t tmp13 = tmp0 - tmp3;
+                    const int32_t tmp11 = tmp1 + tmp2;
+                    const int32_t tmp12 = tmp1 - tmp2;
+
+                    if (pass) {
+                        d[0 * step] = descale(tmp10 + tmp11, even_shift);
+                        d[4 * step] = descale(tmp10 - tmp11, even_shift);
+                    }
+                    else {
+                        d[0 * step] = (tmp10 + tmp11) << pass1_bits;
+                        d[4 * step] = (tmp10 - tmp11) << pass1_bits;
+                    }
+
+                    const int32_t z1 = (tmp12 + tmp13) * fix_0_541196100;
+                    d[2 * step] = descale(z1 + (tmp13 * fix_0_765366865), odd_shift);
+                    d[6 * step] = descale(z1 - (tmp12 * fix_1_847759065), odd_shift);
+
+                    // odd part
+                    const int32_t z5 = (tmp4 + tmp5 + tmp6 + tmp7) * fix_1_175875602;
+                    const int32_t z1o = (tmp4 + tmp7) * -fix_0_899976223;
+                    const int32_t z2 = (tmp5 + tmp6) * -fix_2_562915447;
+                    const int32_t z3 = ((tmp4 + tmp6) * -fix_1_961570560) + z5;
+                    const int32_t z4 = ((tmp5 + tmp7) * -fix_0_390180644) + z5;
+
+                    d[7 * step] = descale((tmp4 * fix_0_298631336) + z1o + z3, odd_shift);
+                    d[5 * step] = descale((tmp5 * fix_2_053119869) + z2 + z4, odd_shift);
+                    d[3 * step] = descale((tmp6 * fix_3_072711026) + z2 + z3, odd_shift);
+                    d[1 * step] = descale((tmp7 * fix_1_501321110) + z1o + z4, odd_shift);
+                }
+            }
+        }
+
+        template <typename Output>
+        void encode_value(Output& output, const int32_t value) {
+            // get the amount of bits needed for the magnitude
+            const uint32_t magnitude = static_cast<uint32_t>(value < 0 ? -value : value);
+            const uint32_t size = 32 - klib::clz(magnitude);
+
+            // negative values are stored as the ones complement
+            put_bits(output, static_cast<uint32_t>(value < 0 ? (value - 1) : value), size);
+        }
+
+        template <typename Output>
+        void encode_block(Output& output, int32_t *const block, const std::array<uint16_t, 64>& reciprocal,
+            const std::array<detail::jpeg::huffman_code, 256>& dc, const std::array<detail::jpeg::huffman_code, 256>& ac,
+            int32_t& previous_dc)
+        {
+            // transform the block
+            dct(block);
+
+            // quantize all the coefficients
+            int32_t quantized[64];
+
+            for (uint32_t i = 0; i < 64; i++) {
+                const int32_t value = block[detail::jpeg::zigzag[i]];
+                const uint32_t divisor = reciprocal[detail::jpeg::zigzag[i]];
+
+                // round to the nearest value using the reciprocal of the divisor
+                const int32_t q = static_cast<int32_t>(
+                    ((static_cast<uint32_t>(value < 0 ? -value : value) * divisor) + 0x8000) >> 16
+                );
+
+                quantized[i] = value < 0 ? -q : q;
+            }
+
+            // encode the difference with the previous dc value
+            const int32_t diff = quantized[0] - previous_dc;
+            previous_dc = quantized[0];
+
+            const uint32_t dc_size = 32 - klib::clz(static_cast<uint32_t>(diff < 0 ? -diff : diff));
+            put_bits(output, dc[dc_size].code, dc[dc_size].size);
+            encode_value(output, diff);
+
+            // encode the ac values with run length encoding
+            uint32_t run = 0;
+
+            for (uint32_t i = 1; i < 64; i++) {
+                if (!quantized[i]) {
+                    run++;
+                    continue;
+                }
+
+                // write zero run lengths of 16
+                while (run > 15) {
+                    put_bits(output, ac[0xf0].code, ac[0xf0].size);
+                    run -= 16;
+                }
+
+                const uint32_t size = 32 - klib::clz(static_cast<uint32_t>(quantized[i] < 0 ? -quantized[i] : quantized[i]));
+                const uint8_t symbol = (run << 4) | size;
+
+                put_bits(output, ac[symbol].code, ac[symbol].size);
+                encode_value(output, quantized[i]);
+
+                run = 0;
+            }
+
+            // end of block when the rest is zero
+            if (run) {
+                put_bits(output, ac[0x00].code, ac[0x00].size);
+            }
+        }
+
+        template <typename Source>
+        static klib::graphics::color read_pixel(const Source& source, const uint32_t x, const uint32_t y) {
+            const auto raw = source.get_pixel({x, y});
+
+            // fast path for rgb565 without the generic mapping
+            if constexpr (Source::mode == graphics::mode::rgb565) {
+                const uint8_t r = (raw >> 11) & 0x1f;
+                const uint8_t g = (raw >> 5) & 0x3f;
+                const uint8_t b = raw & 0x1f;
+
+                return {
+                    static_cast<uint8_t>((r << 3) | (r >> 2)),
+                    static_cast<uint8_t>((g << 2) | (g >> 4)),
+                    static_cast<uint8_t>((b << 3) | (b >> 2)),
+                    0xff
+                };
+            }
+            else {
+                return graphics::detail::raw_to_color<Source::mode>(raw);
+            }
+        }
+
+    public:
+        /**
+         * @brief Construct a new jpeg encoder
+         *
+         * @param quality quality between 1 and 100
+         */
+        jpeg_encoder(const uint8_t quality = 75) {
+            set_quality(quality);
+        }
+
+        /**
+         * @brief Change the quality of the encoder. Scales the quantization
+         * tables the same as the independent jpeg group encoder
+         *
+         * @param quality quality between 1 and 100
+         */
+        void set_quality(const uint8_t quality) {
+            const uint32_t q = klib::min(klib::max(quality, 1), 100);
+            const uint32_t scale = (q < 50) ? (5000 / q) : (200 - (q * 2));
+
+            for (uint32_t i = 0; i < 64; i++) {
+                const uint32_t index = detail::jpeg::zigzag[i];
+
+                const uint32_t y = klib::min(klib::max(
+                    ((detail::jpeg::luminance_quantization[index] * scale) + 50) / 100, 1), 255
+                );
+                const uint32_t c = klib::min(klib::max(
+                    ((detail::jpeg::chrominance_quantization[index] * scale) + 50) / 100, 1), 255
+                );
+
+                luminance[i] = y;
+                chrominance[i] = c;
+
+                // the dct output is scaled by 8. Include this in the divisor
+                luminance_reciprocal[index] = static_cast<uint16_t>(0x10000 / (y * 8));
+                chrominance_reciprocal[index] = static_cast<uint16_t>(0x10000 / (c * 8));
+            }
+        }
+
+        /**
+         * @brief Encode the source to a jpeg stream
+         *
+         * @tparam Source
+         * @tparam Output callable with a std::span<const uint8_t> argument
+         * @param source
+         * @param output
+         * @return uint32_t amount of bytes written
+         */
+        template <typename Source, typename Output>
+        uint32_t encode(const Source& source, Output&& output) {
+            // reset the stream state
+            chunk_size = 0;
+            bit_buffer = 0;
+            bit_count = 0;
+            written = 0;
+
+            write_headers(output, Source::width, Source::height);
+
+            // previous dc values for every component
+            int32_t dc_y = 0;
+            int32_t dc_cb = 0;
+            int32_t dc_cr = 0;
+
+            // encode the image in strips of 16 rows
+            for (uint32_t my = 0; my < Source::height; my += 16) {
+                for (uint32_t mx = 0; mx < Source::width; mx += 16) {
+                    int32_t y[4][64];
+                    int32_t cb[64] = {};
+                    int32_t cr[64] = {};
+
+                    for (uint32_t py = 0; py < 16; py++) {
+                        // repeat the last row and column when the image
+                        // is not a multiple of the block size
+                        const uint32_t sy = klib::min(my + py, Source::height - 1);
+
+                        for (uint32_t px = 0; px < 16; px++) {
+                            const uint32_t sx = klib::min(mx + px, Source::width - 1);
+
+                            const auto col = read_pixel(source, sx, sy);
+                            const int32_t r = col.red;
+                            const int32_t g = col.green;
+                            const int32_t b = col.blue;
+
+                            // convert to ycbcr in 8.8 fixed point
+                            y[((py / 8) * 2) + (px / 8)][((py % 8) * 8) + (px % 8)] = (
+                                (((77 * r) + (150 * g) + (29 * b) + 128) >> 8) - 128
+                            );
+
+                            // sum the 2x2 chrominance values
+                            const uint32_t index = ((py / 2) * 8) + (px / 2);
+                            cb[index] += ((-43 * r) - (85 * g) + (128 * b));
+                            cr[index] += ((128 * r) - (107 * g) - (21 * b));
+                        }
+                    }
+
+                    // average the 2x2 chrominance values
+                    for (uint32_t i = 0; i < 64; i++) {
+                        cb[i] = (cb[i] + (2 << 8)) >> 10;
+                        cr[i] = (cr[i] + (2 << 8)) >> 10;
+                    }
+
+                    for (uint32_t i = 0; i < 4; i++) {
+                        encode_block(output, y[i], luminance_reciprocal,
+                            detail::jpeg::dc_luminance, detail::jpeg::ac_luminance, dc_y
+                        );
+                    }
+
+                    encode_block(output, cb, chrominance_reciprocal,
+                        detail::jpeg::dc_chrominance, detail::jpeg::ac_chrominance, dc_cb
+                    );
+                    encode_block(output, cr, chrominance_reciprocal,
+                        detail::jpeg::dc_chrominance, detail::jpeg::ac_chrominance, dc_cr
+                    );
+                }
+            }
+
+            // flush the remaining bits and write the end of image
+            flush_bits(output);
+            put16(output, 0xffd9);
+
+            // flush the last chunk
+            if (chunk_size) {
+                output(std::span<const uint8_t>{chunk, chunk_size});
+                chunk_size = 0;
+            }
+
+            return written;
+        }
+    };
+}
+
+#endif
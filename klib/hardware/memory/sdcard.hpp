@@ -2,10 +2,16 @@
 #define KLIB_SDCARD_HPP
 
 #include <cstdint>
+#include <array>
+#include <span>
+#include <algorithm>
 #include <optional>
 #include <type_traits>
 
+#include <klib/klib.hpp>
 #include <klib/math.hpp>
+#include <klib/ringbuffer.hpp>
+#include <klib/crypt/crc.hpp>
 
 namespace klib::io {
     /**
@@ -16,10 +22,18 @@ namespace klib::io {
      *
      * credits to http://elm-chan.org/docs/mmc/mmc_e.html
      *
+     * @details when Crc is enabled the crc checking on the card is
+     * enabled (CMD59). All commands get a crc7 and all data blocks are
+     * checked/sent with a crc16. Transfers that fail are retried
+     * Retries amount of times (starting at the first block that
+     * failed)
+     *
      * @tparam Bus
      * @tparam Cs
+     * @tparam Crc
+     * @tparam Retries
      */
-    template <typename Bus, typename Cs>
+    template <typename Bus, typename Cs, bool Crc = false, uint32_t Retries = 2>
     class sd {
     protected:
         /**
@@ -60,6 +74,8 @@ namespace klib::io {
             CMD55 = 0x37,
             // read OCR
             CMD58 = 0x3a,
+            // enable/disable crc checking
+            CMD59 = 0x3b,
         };
 
         /**
@@ -73,6 +89,24 @@ namespace klib::io {
             mmc_v3
         };
 
+        /**
+         * @brief Create a block filled with 0xff. The sd card
+         * requires the host to keep mosi high while reading
+         *
+         * @return std::array<uint8_t, Size>
+         */
+        template <uint32_t Size>
+        consteval static std::array<uint8_t, Size> create_fill_block() {
+            std::array<uint8_t, Size> result = {};
+
+            // set the buffer to all 1's for the sd specification
+            for (uint32_t i = 0; i < Size; i++) {
+                result[i] = 0xff;
+            }
+
+            return result;
+        }
+
         #pragma pack(push, 1)
         /**
          * @brief command to send to the sd card
@@ -112,6 +146,9 @@ namespace klib::io {
         static_assert(sizeof(command) == (48 / 8), "invalid command size");
         static_assert(sizeof(uint8_t) == sizeof(uint8_t), "invalid response size");
 
+        // card type detected during init
+        static inline type card_type = type::unknown;
+
         static void write_bus(const uint8_t *const data, const uint16_t size) {
             // write the command to the spi bus
             Bus::write({data, size});
@@ -197,6 +234,19 @@ namespace klib::io {
             }
         }
 
+        static void send_command(command cmd) {
+            // add the crc to the command when we have crc enabled. The
+            // crc is calculated over everything except the last byte
+            if constexpr (Crc) {
+                cmd.crc = klib::crypt::crc7::calculate(
+                    {reinterpret_cast<const uint8_t*>(&cmd), sizeof(cmd) - 1}
+                );
+            }
+
+            // send the command to the bus
+            write_bus(cmd);
+        }
+
         template <bool R1Only = true>
         static auto write_command(const command cmd) {
             // wait until the device is ready
@@ -206,7 +256,7 @@ namespace klib::io {
             }
 
             // send the command to the bus
-            write_bus(cmd);
+            send_command(cmd);
 
             // receive the response. Can take
             // up to 10 reads
@@ -316,6 +366,51 @@ namespace klib::io {
             Bus::write_read(tx, crc);
         }
 
+        static bool check_crc(const uint8_t *const data) {
+            // check if we need to check the crc at all
+            if constexpr (!Crc) {
+                discard_crc();
+
+                return true;
+            }
+            else {
+                const uint8_t tx[] = {0xff, 0xff};
+                uint8_t crc[2];
+
+                // make sure the in and out match in size
+                static_assert(sizeof(tx) == sizeof(crc));
+
+                // read the crc
+                Bus::write_read(tx, crc);
+
+                // the crc is send msb first
+                return (
+                    ((static_cast<uint16_t>(crc[0]) << 8) | crc[1]) ==
+                    klib::crypt::crc16::calculate({data, block_size})
+                );
+            }
+        }
+
+        static void write_crc(const uint8_t *const data) {
+            // check if we need to send a valid crc
+            if constexpr (!Crc) {
+                // the card ignores the crc. Send a dummy
+                discard_crc();
+            }
+            else {
+                // calculate the crc over the data
+                const uint16_t crc = klib::crypt::crc16::calculate({data, block_size});
+
+                // send the crc msb first
+                const uint8_t tx[] = {
+                    static_cast<uint8_t>(crc >> 8),
+                    static_cast<uint8_t>(crc)
+                };
+
+                Bus::write(tx);
+            }
+        }
+
         static bool read_block(uint8_t *const data, uint32_t timeout = (200'000 / 20)) {
             // data to send while waiting
             const uint8_t tx = 0xff;
@@ -339,25 +434,14 @@ namespace klib::io {
                 return false;
             }
 
-            // create a array with all 0xff to transmit
-            uint8_t buffer[64];
-
-            // set the buffer to all 1's for the sd specification
-            for (uint32_t i = 0; i < sizeof(buffer); i++) {
-                buffer[i] = 0xff;
-            }
-
-            // read using the buffer size
-            for (uint32_t i = 0; i < (block_size / sizeof(buffer)); i++) {
-                Bus::write_read(
-                    buffer, {&data[i * sizeof(buffer)], sizeof(buffer)}
-                );
-            }
+            // array with all 0xff to transmit while reading the block
+            constexpr static auto fill = create_fill_block<block_size>();
 
-            // read the crc and discard it
-            discard_crc();
+            // read the whole block in one transfer
+            Bus::write_read(fill, {data, block_size});
 
-            return true;
+            // read the crc and check it when enabled
+            return check_crc(data);
         }
 
         static bool write_block(const uint8_t *const data, const uint8_t token) {
@@ -371,14 +455,25 @@ namespace klib::io {
 
             // check if we are sending a stop
             if (token == 0xfd) {
-                return true;
+                const uint8_t tx = 0xff;
+                uint8_t stuff;
+
+                // make sure the in and out match in size
+                static_assert(sizeof(tx) == sizeof(stuff));
+
+                // skip the stuff byte after the stop token
+                Bus::write_read({&tx, sizeof(tx)}, {&stuff, sizeof(stuff)});
+
+                // wait until the card has finished programming
+                return wait_till_ready() == 0xff;
             }
 
             // write the block to the card
             Bus::write({data, block_size});
 
-            // read the crc and discard it
-            discard_crc();
+            // write the crc of the block. A crc mismatch will
+            // be reported by the card in the data response
+            write_crc(data);
 
             const uint8_t tx = 0xff;
             uint8_t rx = 0x00;
@@ -410,6 +505,56 @@ namespace klib::io {
             return (rx & 0x1f) == 0x05;
         }
 
+        static bool stop_transmission() {
+            // create the stop command. We cannot use write_command as
+            // waiting for the card to be ready would consume the data
+            // the card is still sending
+            const command stop = {
+                .cmd = static_cast<uint8_t>(sd_cmd::CMD12),
+                .argument = 0x00,
+                .crc = 0x00
+            };
+
+            // send the stop command
+            send_command(stop);
+
+            // the byte directly after the stop command is a stuff byte
+            const uint8_t tx = 0xff;
+            uint8_t stuff;
+
+            // make sure the in and out match in size
+            static_assert(sizeof(tx) == sizeof(stuff));
+
+            // discard the stuff byte
+            Bus::write_read({&tx, sizeof(tx)}, {&stuff, sizeof(stuff)});
+
+            // get the response to the stop command
+            const uint8_t r1 = receive_response();
+
+            // wait until the card is not busy anymore (R1b response)
+            return (wait_till_ready() == 0xff) && (r1 == 0x00);
+        }
+
+        static bool enable_crc() {
+            // set the cs pin manually
+            Cs::template set<false>();
+
+            // create the command to enable the crc checking
+            const command crc_on = {
+                .cmd = static_cast<uint8_t>(sd_cmd::CMD59),
+                .argument = klib::bswap(static_cast<uint32_t>(0x1)),
+                .crc = 0x00
+            };
+
+            // send the command
+            const uint8_t r1 = write_command(crc_on);
+
+            // restore the cs pin manually
+            Cs::template set<true>();
+
+            return r1 == 0x00;
+        }
+
         static type init_impl() {
             // set the cs pin manually
             Cs::template set<true>();
@@ -549,6 +694,119 @@ namespace klib::io {
             return type::unknown;
         }
 
+        static uint32_t write_impl(const uint32_t sector, const uint8_t *const data, const uint32_t blocks) {
+            // set the cs pin manually
+            Cs::template set<false>();
+
+            // check if we can use the single block write
+            if (blocks == 1) {
+                const command cmd = {
+                    .cmd = static_cast<uint8_t>(sd_cmd::CMD24),
+                    .argument = klib::bswap(static_cast<uint32_t>(sector)),
+                    .crc = 0x00
+                };
+
+                // send the write single block command and write the block
+                // to the card
+                const bool result = (
+                    (write_command(cmd) == 0x00) && write_block(data, 0xfe)
+                );
+
+                // clear the cs pin manually
+                Cs::template set<true>();
+
+                return result;
+            }
+
+            // sd cards support a pre-erase of the blocks we are going
+            // to write. This speeds up the multiple block write
+            if (card_type == type::sd_v1 || card_type == type::sd_v2) {
+                const command pre_erase = {
+                    .cmd = static_cast<uint8_t>(sd_cmd::ACMD23),
+                    .argument = klib::bswap(blocks),
+                    .crc = 0x00
+                };
+
+                // send the pre-erase. This is only a hint for the card
+                // so we do not care about the result
+                write_app_command(pre_erase);
+            }
+
+            const command cmd = {
+                .cmd = static_cast<uint8_t>(sd_cmd::CMD25),
+                .argument = klib::bswap(static_cast<uint32_t>(sector)),
+                .crc = 0x00
+            };
+
+            // send the write multiple block command
+            if (write_command(cmd) != 0x00) {
+                // clear the cs pin manually
+                Cs::template set<true>();
+
+                // return error while writing
+                return 0;
+            }
+
+            uint32_t written = 0;
+
+            // write all the blocks using the multiple block token
+            while ((written < blocks) && write_block(&data[written * block_size], 0xfc)) {
+                written++;
+            }
+
+            // send the stop token. We always send this to stop the
+            // transaction even if we failed writing a block. If the
+            // stop fails we do not know what the card has written
+            if (!write_block(nullptr, 0xfd)) {
+                written = 0;
+            }
+
+            // clear the cs pin manually
+            Cs::template set<true>();
+
+            return written;
+        }
+
+        static uint32_t read_impl(const uint32_t sector, uint8_t *const data, const uint32_t blocks) {
+            // set the cs pin manually
+            Cs::template set<false>();
+
+            const command cmd = {
+                .cmd = static_cast<uint8_t>(
+                    (blocks == 1) ? sd_cmd::CMD17 : sd_cmd::CMD18
+                ),
+                .argument = klib::bswap(static_cast<uint32_t>(sector)),
+                .crc = 0x00
+            };
+
+            // send the read command
+            if (write_command(cmd) != 0x00) {
+                // clear the cs pin manually
+                Cs::template set<true>();
+
+                // return error while reading
+                return 0;
+            }
+
+            uint32_t done = 0;
+
+            // read all the blocks from the card
+            while ((done < blocks) && read_block(&data[done * block_size])) {
+                done++;
+            }
+
+            // stop the multiple block read. We always send this to
+            // stop the transaction even if we failed reading a block
+            if (blocks > 1) {
+                stop_transmission();
+            }
+
+            // clear the cs pin manually
+            Cs::template set<true>();
+
+            return done;
+        }
+
     public:
         // block size of this storage type
         constexpr static uint32_t block_size = 512;
@@ -560,12 +818,23 @@ namespace klib::io {
          * @return false
          */
         static bool init() {
+            // get the type of the card
+            card_type = init_impl();
+
+            // enable the crc checking on the card if we need it
+            if constexpr (Crc) {
+                if (card_type != type::unknown && !enable_crc()) {
+                    card_type = type::unknown;
+                }
+            }
+
             // return if we have a valid type
-            return init_impl() != type::unknown;
+            return card_type != type::unknown;
         }
 
         /**
-         * @brief Write 1 or more blocks to the sd card
+         * @brief Write 1 or more blocks to the sd card. Uses a
+         * multiple block write when more than 1 block is written
          *
          * @param sector
          * @param data
@@ -574,45 +843,40 @@ namespace klib::io {
          * @return false
          */
         static bool write(const uint32_t sector, const uint8_t *const data, const uint32_t blocks) {
-            // set the cs pin manually
-            Cs::template set<false>();
+            // amount of blocks written successfully
+            uint32_t written = 0;
 
-            // write using the single block write
-            for (uint32_t i = 0; i < blocks; i++) {
-                const command cmd = {
-                    .cmd = static_cast<uint8_t>(sd_cmd::CMD24),
-                    .argument = klib::bswap(static_cast<uint32_t>(sector + i)),
-                    .crc = 0x00
-                };
+            // amount of times the current block failed
+            uint32_t failed = 0;
 
-                // send the write single block command
-                const uint8_t t = write_command(cmd);
+            while (written < blocks) {
+                // write the remaining blocks
+                const uint32_t count = write_impl(
+                    sector + written, &data[written * block_size], blocks - written
+                );
 
-                if (t != 0x00) {
-                   // clear the cs pin manually
-                    Cs::template set<true>();
+                written += count;
 
-                    // return error while writing
-                    return false;
+                // check if we are done
+                if (written >= blocks) {
+                    break;
                 }
 
-                // read a block from the card
-                if (!write_block(&data[i * block_size], 0xfe)) {
-                    // clear the cs pin manually
-                    Cs::template set<true>();
+                // a different block failed if we made progress. Only
+                // retry when we can detect transfer errors using the crc
+                failed = count ? 1 : (failed + 1);
 
+                if (!Crc || failed > Retries) {
                     return false;
                 }
             }
 
-            // clear the cs pin manually
-            Cs::template set<true>();
-
             return true;
         }
 
         /**
-         * @brief Read 1 or more blocks from the sd card
+         * @brief Read 1 or more blocks from the sd card. Uses a
+         * multiple block read when more than 1 block is read
          *
          * @param sector
          * @param data
@@ -621,42 +885,565 @@ namespace klib::io {
          * @return false
          */
         static bool read(const uint32_t sector, uint8_t *const data, const uint32_t blocks) {
+            // amount of blocks read successfully
+            uint32_t done = 0;
+
+            // amount of times the current block failed
+            uint32_t failed = 0;
+
+            while (done < blocks) {
+                // read the remaining blocks
+                const uint32_t count = read_impl(
+                    sector + done, &data[done * block_size], blocks - done
+                );
+
+                done += count;
+
+                // check if we are done
+                if (done >= blocks) {
+                    break;
+                }
+
+                // a different block failed if we made progress. Only
+                // retry when we can detect transfer errors using the crc
+                failed = count ? 1 : (failed + 1);
+
+                if (!Crc || failed > Retries) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    };
+
+    /**
+     * @brief Sd card interface that uses dma for the data transfers.
+     * Requests are queued and processed in the background by a state
+     * machine that is advanced from the completion interrupt of the
+     * rx dma channel. Waiting for the data token and the busy signal
+     * is done by reading small chunks using the dma instead of polling
+     * the bus with the cpu. Commands and responses are short and are
+     * still transferred using the bus directly.
+     *
+     * Both dma channels are required as the sd card needs 0xff on mosi
+     * while we are reading data. The rx channel is used for the
+     * completion as it always finishes after the tx channel.
+     *
+     * @warning the blocking read/write functions should not be used
+     * while there are requests in the queue
+     *
+     * @tparam DmaTx
+     * @tparam DmaRx
+     * @tparam Bus
+     * @tparam Cs
+     * @tparam QueueSize
+     */
+    template <
+        typename DmaTx, typename DmaRx,
+        typename Bus, typename Cs,
+        uint32_t QueueSize = 4
+    >
+    class sd_dma: public sd<Bus, Cs> {
+    public:
+        // callback type that is called when a request is done
+        using callback = void(*)(const bool success);
+
+    protected:
+        // using for the base class
+        using base = sd<Bus, Cs>;
+
+        /**
+         * @brief Request information for the queue
+         *
+         */
+        struct request {
+            // start sector of the request
+            uint32_t sector;
+
+            // pointer to the data to read/write
+            uint8_t *data;
+
+            // amount of blocks to read/write
+            uint32_t blocks;
+
+            // flag if the request is a write
+            bool write;
+
+            // callback to call when the request is done
+            callback done;
+        };
+
+        /**
+         * @brief States of the background state machine
+         *
+         */
+        enum class state {
+            idle,
+            command,
+            read_token,
+            read_data,
+            write_data,
+            write_busy,
+            stop_busy,
+        };
+
+        // amount of bytes we read at once when we are waiting
+        // for a token or for the card to be ready
+        constexpr static uint32_t poll_size = 16;
+
+        // max amount of polls while waiting for a token (200ms at 400khz)
+        constexpr static uint32_t token_polls = (200'000 / 20) / poll_size;
+
+        // max amount of polls while waiting for the card to be ready
+        // (500ms at 400khz)
+        constexpr static uint32_t busy_polls = (500'000 / 20) / poll_size;
+
+        // all the requests. The first item in the queue is the
+        // active request
+        static inline klib::ringbuffer<request, QueueSize> requests;
+
+        // current state of the state machine
+        static inline volatile state current = state::idle;
+
+        // current block in the active request
+        static inline uint32_t block = 0;
+
+        // amount of bytes of the current block we already have
+        static inline uint32_t offset = 0;
+
+        // remaining polls before we timeout
+        static inline uint32_t polls = 0;
+
+        // buffer for reading while waiting on a token or busy
+        static inline uint8_t poll_buffer[poll_size] = {};
+
+        // data we send while receiving. Not incremented by the dma
+        const static inline uint8_t fill = 0xff;
+
+        // data we receive while transmitting. Not incremented by
+        // the dma
+        static inline uint8_t discard = 0x00;
+
+        /**
+         * @brief Receive data using the dma. Sends 0xff while receiving
+         *
+         * @param rx
+         */
+        static void receive(const std::span<uint8_t> rx) {
+            // some busses need their fifo empty before using the dma
+            if constexpr (requires { Bus::clear_rx_fifo(); }) {
+                Bus::clear_rx_fifo();
+            }
+
+            // start the read first so we do not miss any data
+            DmaRx::template read<true>(rx, irq_handler);
+
+            // write 0xff for every byte we are reading
+            DmaTx::template write<false>(std::span<const uint8_t>{&fill, rx.size()});
+        }
+
+        /**
+         * @brief Transmit data using the dma. Discards the received data
+         *
+         * @param tx
+         */
+        static void transmit(const std::span<const uint8_t> tx) {
+            // some busses need their fifo empty before using the dma
+            if constexpr (requires { Bus::clear_rx_fifo(); }) {
+                Bus::clear_rx_fifo();
+            }
+
+            // read into a single byte as we do not care about the result
+            DmaRx::template read<false>(std::span<uint8_t>{&discard, tx.size()}, irq_handler);
+
+            // write the data
+            DmaTx::template write<true>(tx);
+        }
+
+        /**
+         * @brief Start waiting for the card to be ready in the background
+         *
+         * @param next
+         */
+        static void wait_ready(const state next) {
+            current = next;
+            polls = busy_polls;
+
+            receive(poll_buffer);
+        }
+
+        /**
+         * @brief Returns if the last poll showed the card is ready
+         *
+         * @return true
+         * @return false
+         */
+        static bool poll_ready() {
+            // the card keeps miso low while it is busy
+            return poll_buffer[poll_size - 1] == 0xff;
+        }
+
+        /**
+         * @brief Start receiving the next block
+         *
+         */
+        static void start_read_block() {
+            current = state::read_token;
+            polls = token_polls;
+            offset = 0;
+
+            receive(poll_buffer);
+        }
+
+        /**
+         * @brief Start transmitting the next block
+         *
+         */
+        static void start_write_block() {
+            const auto &r = requests[0];
+
+            // send the single or multiple block token
+            const uint8_t token = (r.blocks == 1) ? 0xfe : 0xfc;
+            Bus::write({&token, sizeof(token)});
+
+            current = state::write_data;
+
+            // write the whole block in the background
+            transmit({&r.data[block * base::block_size], base::block_size});
+        }
+
+        /**
+         * @brief Send the command for the active request and start
+         * the first block
+         *
+         */
+        static void start_request() {
+            const auto &r = requests[0];
+
+            // reset the block counter
+            block = 0;
+
             // set the cs pin manually
             Cs::template set<false>();
 
-            // read by using the single block read command
-            for (uint32_t i = 0; i < blocks; i++) {
-                const command cmd = {
-                    .cmd = static_cast<uint8_t>(sd_cmd::CMD17),
-                    .argument = klib::bswap(static_cast<uint32_t>(sector + i)),
+            // sd cards support a pre-erase of the blocks we are going
+            // to write. This speeds up the multiple block write
+            if (r.write && r.blocks > 1 &&
+                (base::card_type == base::type::sd_v1 || base::card_type == base::type::sd_v2))
+            {
+                const typename base::command pre_erase = {
+                    .cmd = static_cast<uint8_t>(base::sd_cmd::ACMD23),
+                    .argument = klib::bswap(r.blocks),
                     .crc = 0x00
                 };
 
-                // send the read single block command
-                const uint8_t t = write_command(cmd);
+                // send the pre-erase. This is only a hint for the card
+                // so we do not care about the result
+                base::write_app_command(pre_erase);
+            }
 
-                if (t != 0x00) {
-                   // clear the cs pin manually
-                    Cs::template set<true>();
+            // get the command for the request
+            typename base::sd_cmd c;
 
-                    // return error while writing
-                    return false;
-                }
+            if (r.write) {
+                c = (r.blocks == 1) ? base::sd_cmd::CMD24 : base::sd_cmd::CMD25;
+            }
+            else {
+                c = (r.blocks == 1) ? base::sd_cmd::CMD17 : base::sd_cmd::CMD18;
+            }
 
-                // read a block from the card
-                if (!read_block(&data[i * block_size])) {
-                    // clear the cs pin manually
-                    Cs::template set<true>();
+            const typename base::command cmd = {
+                .cmd = static_cast<uint8_t>(c),
+                .argument = klib::bswap(static_cast<uint32_t>(r.sector)),
+                .crc = 0x00
+            };
 
-                    return false;
+            // send the command
+            if (base::write_command(cmd) != 0x00) {
+                return finish(false);
+            }
+
+            // start the first block
+            if (r.write) {
+                start_write_block();
+            }
+            else {
+                start_read_block();
+            }
+        }
+
+        /**
+         * @brief Stop the active request and start the next one
+         *
+         * @param success
+         */
+        static void finish(bool success) {
+            // get the active request
+            const request r = requests[0];
+
+            // stop any multiple block transfer that failed halfway
+            if (!success && r.blocks > 1 && current != state::command) {
+                if (r.write) {
+                    base::write_block(nullptr, 0xfd);
+                }
+                else {
+                    base::stop_transmission();
                 }
             }
 
             // clear the cs pin manually
             Cs::template set<true>();
 
+            // remove the request from the queue
+            (void)requests.copy_and_pop();
+
+            // start the next request if we have any
+            if (requests.empty()) {
+                current = state::idle;
+            }
+            else {
+                current = state::command;
+            }
+
+            // notify the user
+            if (r.done) {
+                r.done(success);
+            }
+
+            // start the next request. Done after the callback so the
+            // user gets the result in order
+            if (current == state::command) {
+                start_request();
+            }
+        }
+
+        /**
+         * @brief Handle a finished block
+         *
+         */
+        static void block_done() {
+            const auto &r = requests[0];
+
+            // move to the next block
+            block++;
+
+            // check if we have more blocks
+            if (block < r.blocks) {
+                if (r.write) {
+                    start_write_block();
+                }
+                else {
+                    start_read_block();
+                }
+
+                return;
+            }
+
+            // check if we need to stop a multiple block transfer
+            if (r.blocks > 1) {
+                if (r.write) {
+                    const uint8_t token = 0xfd;
+                    uint8_t stuff[2];
+
+                    // send the stop token and skip the stuff byte
+                    Bus::write({&token, sizeof(token)});
+                    Bus::write_read({&fill, sizeof(fill)}, {stuff, 1});
+
+                    // wait in the background until the card is done
+                    return wait_ready(state::stop_busy);
+                }
+
+                // stop the multiple block read
+                return finish(base::stop_transmission());
+            }
+
+            finish(true);
+        }
+
+        /**
+         * @brief Interrupt handler for the rx dma channel
+         *
+         */
+        static void irq_handler() {
+            const auto &r = requests[0];
+
+            switch (current) {
+                case state::read_token: {
+                    // search for the first byte that is not 0xff
+                    uint32_t index = 0;
+
+                    while (index < poll_size && poll_buffer[index] == 0xff) {
+                        index++;
+                    }
+
+                    // check if we need to poll again
+                    if (index >= poll_size) {
+                        if (!(--polls)) {
+                            return finish(false);
+                        }
+
+                        return receive(poll_buffer);
+                    }
+
+                    // anything else than a start token is a error
+                    if (poll_buffer[index] != 0xfe) {
+                        return finish(false);
+                    }
+
+                    // the data after the token is already the start of the block
+                    uint8_t *const data = &r.data[block * base::block_size];
+                    offset = (poll_size - 1) - index;
+
+                    std::copy_n(&poll_buffer[index + 1], offset, data);
+
+                    // receive the rest of the block in the background
+                    current = state::read_data;
+                    return receive({&data[offset], base::block_size - offset});
+                }
+                case state::read_data:
+                    // read the crc and discard it
+                    base::discard_crc();
+
+                    return block_done();
+                case state::write_data: {
+                    // write a dummy crc
+                    base::discard_crc();
+
+                    const uint8_t tx = 0xff;
+                    uint8_t rx = 0x00;
+
+                    // wait for the data response
+                    for (uint32_t i = 0; i < 64; i++) {
+                        // read the data response
+                        Bus::write_read({&tx, sizeof(tx)}, {&rx, sizeof(rx)});
+
+                        // check if the data is accepted
+                        if ((rx & 0x1f) == 0x05) {
+                            break;
+                        }
+                    }
+
+                    // check if the card accepted the data
+                    if ((rx & 0x1f) != 0x05) {
+                        return finish(false);
+                    }
+
+                    // wait in the background until the card is done
+                    return wait_ready(state::write_busy);
+                }
+                case state::write_busy:
+                case state::stop_busy:
+                    // check if the card is still busy
+                    if (!poll_ready()) {
+                        if (!(--polls)) {
+                            return finish(false);
+                        }
+
+                        return receive(poll_buffer);
+                    }
+
+                    // check if we were waiting for the stop token
+                    if (current == state::stop_busy) {
+                        return finish(true);
+                    }
+
+                    return block_done();
+                default:
+                    break;
+            }
+        }
+
+        /**
+         * @brief Add a request to the queue. Starts the request if
+         * there is no active request
+         *
+         * @param r
+         * @return true
+         * @return false
+         */
+        static bool add_request(const request &r) {
+            // disable all interrupts while changing the queue
+            target::disable_irq();
+
+            // check if we have space for the request
+            if (requests.full()) {
+                target::enable_irq();
+
+                return false;
+            }
+
+            requests.push(r);
+
+            // check if we need to start the request
+            const bool start = (current == state::idle);
+
+            if (start) {
+                current = state::command;
+            }
+
+            // enable the interrupts again
+            target::enable_irq();
+
+            if (start) {
+                start_request();
+            }
+
             return true;
         }
+
+    public:
+        /**
+         * @brief Read 1 or more blocks from the sd card in the
+         * background. The callback is called from the dma interrupt
+         * when all the blocks are read
+         *
+         * @param sector
+         * @param data
+         * @param blocks
+         * @param done
+         * @return true request is queued
+         * @return false queue is full
+         */
+        static bool read_async(const uint32_t sector, uint8_t *const data, const uint32_t blocks, const callback done = nullptr) {
+            if (!blocks) {
+                return false;
+            }
+
+            return add_request({sector, data, blocks, false, done});
+        }
+
+        /**
+         * @brief Write 1 or more blocks to the sd card in the
+         * background. The callback is called from the dma interrupt
+         * when all the blocks are written. The data needs to stay
+         * valid until the callback is called
+         *
+         * @param sector
+         * @param data
+         * @param blocks
+         * @param done
+         * @return true request is queued
+         * @return false queue is full
+         */
+        static bool write_async(const uint32_t sector, const uint8_t *const data, const uint32_t blocks, const callback done = nullptr) {
+            if (!blocks) {
+                return false;
+            }
+
+            // we only read from the data in a write request
+            return add_request({sector, const_cast<uint8_t*>(data), blocks, true, done});
+        }
+
+        /**
+         * @brief Returns if there are requests in the queue
+         *
+         * @return true
+         * @return false
+         */
+        static bool is_busy() {
+            return current != state::idle;
+        }
     };
 }
 
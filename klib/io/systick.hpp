@@ -3,6 +3,7 @@
 
 #include <cstdint>
 
+#include <klib/math.hpp>
 #include <klib/io/core_clock.hpp>
 #include <klib/units.hpp>
 
@@ -51,11 +52,22 @@ namespace klib::io {
         // days of runtime in ms
         static volatile inline time::ms runtime = 0;
 
+        // amount of counts in a single tick (1 ms)
+        static inline uint32_t period = 0;
+
+        // amount of ticks the current interrupt is delayed for. 0 when
+        // the timer runs normally
+        static volatile inline uint32_t suppressed = 0;
+
         template <typename Irq, bool ExternalClockSource = false>
         static void init_impl() {
             // clear the systick value
             port->value = 0;
 
+            // store the counts in a single tick for the tickless mode
+            period = port->load + 1;
+            suppressed = 0;
+
             // register our handler
             Irq::template register_irq<Irq::arm_vector::systick>(irq_handler);
 
@@ -222,6 +234,87 @@ namespace klib::io {
             }
         }
 
+        /**
+         * @brief Delay the next interrupt by a amount of ticks. Used
+         * to stop the timer from waking the cpu every ms when nothing
+         * needs to run. The runtime is updated when the interrupt
+         * fires or when resume_ticks is called after a early wakeup.
+         * Should be called from a interrupt or with the interrupts
+         * disabled
+         *
+         * @param ticks
+         * @return uint32_t amount of ticks the interrupt is delayed
+         */
+        static uint32_t suppress_ticks(const uint32_t ticks) {
+            // stop the timer while we change the reload value
+            const uint32_t ctrl = port->ctrl;
+            port->ctrl = ctrl & ~0x1;
+
+            // get the counts left in the current tick. The counter
+            // counts down
+            const uint32_t remaining = port->value;
+
+            // limit the amount of ticks to the 24 bit counter
+            const uint32_t count = klib::min(ticks, ((0xffffff - remaining) / period) + 1);
+
+            // check if we need to suppress anything. When the counter
+            // reached zero a tick is pending and we let it run normally
+            if (count <= 1 || ((ctrl | port->ctrl) & (0x1 << 16))) {
+                port->ctrl |= 0x1;
+
+                return 0;
+            }
+
+            // fire the interrupt at the end of the last tick. Writing
+            // the value register loads the reload value
+            port->load = remaining + ((count - 1) * period) - 1;
+            port->value = 0;
+            suppressed = count;
+
+            port->ctrl |= 0x1;
+
+            return count;
+        }
+
+        /**
+         * @brief Update the runtime after a early wakeup from a
+         * suppressed tick and start the normal tick again. Should
+         * be called from a interrupt or with the interrupts disabled
+         *
+         */
+        static void resume_ticks() {
+            // check if we are suppressing ticks
+            if (!suppressed) {
+                return;
+            }
+
+            // stop the timer. Reading the control register clears the
+            // count flag so we keep the value of both reads
+            const uint32_t ctrl = port->ctrl;
+            port->ctrl = ctrl & ~0x1;
+
+            // check if the counter reached zero. The interrupt is pending
+            // and will add all the suppressed ticks
+            if ((ctrl | port->ctrl) & (0x1 << 16)) {
+                port->ctrl |= 0x1;
+
+                return;
+            }
+
+            // get the counts that have elapsed since we suppressed
+            const uint32_t elapsed = port->load - port->value;
+
+            // add the ticks that have fully elapsed
+            runtime.value = runtime.value + (elapsed / period);
+            suppressed = 0;
+
+            // run the rest of the current tick. The interrupt
+            // restores the normal reload value
+            port->load = (period - (elapsed % period)) - 1;
+            port->value = 0;
+            port->ctrl |= 0x1;
+        }
+
         /**
          * @brief Register a callback after the init sequence
          *
@@ -245,8 +338,18 @@ namespace klib::io {
             // the systick control register
             (void) port->ctrl;
 
-            // increment the current runtime value
-            runtime.value++;
+            // check if the reload value was changed by the tickless mode
+            if (port->load != (period - 1)) {
+                // restore the normal tick. The counter already reloaded
+                // the old value, clear it so it reloads the new value
+                port->load = period - 1;
+                port->value = 0;
+            }
+
+            // increment the current runtime value with all the
+            // ticks we have suppressed
+            runtime.value = runtime.value + (suppressed ? suppressed : 1);
+            suppressed = 0;
 
             // only run the callback when enabled
             if constexpr (Callback) {
@@ -2,18 +2,45 @@
 #define KLIB_USB_BULK_HPP
 
 #include <algorithm>
+#include <atomic>
 
 #include <klib/string.hpp>
 #include <klib/usb/usb/device.hpp>
 #include <klib/usb/usb/descriptor.hpp>
 
 namespace klib::usb::device {
-    template <uint8_t InEndpoint = 0x2, uint8_t OutEndpoint = 0x05>
+    /**
+     * @brief Generic bulk device. Reads and writes are queued as transfer
+     * requests per endpoint. The next request is armed from the callback
+     * of the previous one so the endpoint does not idle while the user
+     * handles the data
+     *
+     * @tparam InEndpoint
+     * @tparam OutEndpoint
+     * @tparam QueueSize amount of requests that can be queued per endpoint
+     * @tparam MaxPacketSize max packet size of the bulk endpoints. Only
+     * high speed controllers support 512 byte bulk packets
+     */
+    template <
+        uint8_t InEndpoint = 0x2, uint8_t OutEndpoint = 0x05,
+        uint32_t QueueSize = 4, uint16_t MaxPacketSize = 0x40
+    >
     class bulk {
     public:
         // using for the array of callbacks
         using interrupt_callback = void(*)();
 
+        // callback of a single transfer request. Called with the buffer
+        // of the request and the amount of bytes transferred
+        using request_callback = void(*)(uint8_t *const data, const usb::error error_code, const uint32_t transferred);
+
+        // make sure we have a valid queue and packet size
+        static_assert(QueueSize > 0, "invalid queue size");
+        static_assert(
+            MaxPacketSize == 8 || MaxPacketSize == 16 || MaxPacketSize == 32 ||
+            MaxPacketSize == 64 || MaxPacketSize == 512, "invalid bulk packet size"
+        );
+
     protected:
         /**
          * @brief Enum with the string descriptor indexes
@@ -57,7 +84,7 @@ namespace klib::usb::device {
 
         // device descriptor for the bulk device
         const __attribute__((aligned(4))) static inline descriptor::device device = {
-            .bcdUSB = static_cast<uint16_t>(setup::usb_version::usb_v1_1),
+            .bcdUSB = (MaxPacketSize > 0x40) ? setup::usb_version::usb_v2_0 : setup::usb_version::usb_v1_1,
             .bDeviceClass = descriptor::class_type::vendor_specific,
             .bDeviceSubClass = 0x00,
             .bDeviceProtocol = 0x00,
@@ -72,10 +99,8 @@ namespace klib::usb::device {
         };
 
         // configuration descriptor
-        const __attribute__((aligned(4))) static inline config_descriptor config = {
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
             {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x01,
                 .bConfigurationValue = 0x01,
                 .iConfiguration = 0x00,
                 .bmAttributes = 0xA0,
@@ -84,7 +109,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x00,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x02,
                 .bInterfaceClass = 0xff,
                 .bInterfaceSubClass = 0x00,
                 .bInterfaceProtocol = 0x00,
@@ -93,16 +117,16 @@ namespace klib::usb::device {
             {
                 .bEndpointAddress = 0x80 | InEndpoint,
                 .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::bulk),
-                .wMaxPacketSize = 0x0040,
+                .wMaxPacketSize = MaxPacketSize,
                 .bInterval = 0x01
             },
             {
                 .bEndpointAddress = OutEndpoint,
                 .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::bulk),
-                .wMaxPacketSize = 0x0040,
+                .wMaxPacketSize = MaxPacketSize,
                 .bInterval = 0x01
             }
-        };
+        });
 
         // language descriptor for the bulk device
         const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
@@ -129,43 +153,304 @@ namespace klib::usb::device {
         static inline interrupt_callback receive_callback = nullptr;
 
         /**
-         * @brief Callback for when a write or read is
-         * finished. Calls the user callbacks if available
+         * @brief A single queued transfer request
+         *
+         */
+        struct transfer_request {
+            // buffer of the request. Only written for out requests
+            uint8_t *data;
+
+            // size of the buffer
+            uint32_t size;
+
+            // callback called when the request is done
+            request_callback callback;
+        };
+
+        /**
+         * @brief Queue with the transfer requests of a single endpoint.
+         * The write index is only changed by the user and the read index
+         * only in the endpoint callback. The request at the read index is
+         * armed on the endpoint
+         *
+         */
+        struct transfer_queue {
+            // queued requests
+            transfer_request requests[QueueSize];
+
+            // free running indices in the requests
+            std::atomic<uint32_t> write;
+            std::atomic<uint32_t> read;
+
+            // flag if a request is armed on the endpoint
+            std::atomic<bool> active;
+
+            // flag if the zero length packet of the current request
+            // is being sent
+            bool zlp;
+        };
+
+        // request queues for the in and out endpoint
+        static inline transfer_queue transmit_queue = {};
+        static inline transfer_queue receive_queue = {};
+
+        /**
+         * @brief Get the request queue for the read or write direction
+         *
+         * @tparam Read
+         * @return transfer_queue&
+         */
+        template <bool Read>
+        static transfer_queue& get_queue() {
+            if constexpr (Read) {
+                return receive_queue;
+            }
+            else {
+                return transmit_queue;
+            }
+        }
+
+        /**
+         * @brief Arm a transfer on the endpoint of the direction
          *
          * @tparam Usb
-         * @param endpoint
-         * @param mode
+         * @tparam Read
+         * @param data
+         * @param size
+         * @return true
+         * @return false
+         */
+        template <typename Usb, bool Read>
+        static bool arm(uint8_t *const data, const uint32_t size) {
+            if constexpr (Read) {
+                return Usb::read(callback<Usb>, usb::get_endpoint(config.endpoint1.bEndpointAddress),
+                    usb::endpoint_mode::out, {data, size}
+                );
+            }
+            else {
+                return Usb::write(callback<Usb>, usb::get_endpoint(config.endpoint0.bEndpointAddress),
+                    usb::get_endpoint_mode(config.endpoint0.bEndpointAddress), {data, size}
+                );
+            }
+        }
+
+        /**
+         * @brief Call the callbacks of a finished request
+         *
+         * @tparam Read
+         * @param request
          * @param error_code
+         * @param transferred
          */
-        template <typename Usb>
-        static void callback(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
-            // only continue if we do not have any errors
-            if (error_code != usb::error::no_error) {
-                // we have a error
-                return;
+        template <bool Read>
+        static void notify(const transfer_request& request, const usb::error error_code, const uint32_t transferred) {
+            if (request.callback) {
+                request.callback(request.data, error_code, transferred);
             }
 
-            // check if we are configured
-            if (!configuration) {
+            // the registered callbacks are only called for successful requests
+            if (error_code != usb::error::no_error) {
                 return;
             }
 
-            // check if we should read or write
-            if (mode == usb::endpoint_mode::in) {
+            if constexpr (Read) {
+                if (receive_callback) {
+                    receive_callback();
+                }
+            }
+            else {
                 if (transmit_callback) {
                     transmit_callback();
                 }
             }
+        }
+
+        /**
+         * @brief Remove the request at the read index from the queue and
+         * call the callbacks of the request
+         *
+         * @tparam Read
+         * @param error_code
+         * @param transferred
+         */
+        template <bool Read>
+        static void complete(const usb::error error_code, const uint32_t transferred) {
+            auto& queue = get_queue<Read>();
+
+            // copy the request so the entry can be reused in the callbacks
+            const transfer_request request = queue.requests[queue.read.load() % QueueSize];
+            queue.read++;
+
+            notify<Read>(request, error_code, transferred);
+        }
+
+        /**
+         * @brief Arm the request at the read index. Does nothing
+         * when the queue is empty
+         *
+         * @tparam Usb
+         * @tparam Read
+         */
+        template <typename Usb, bool Read>
+        static void start_next() {
+            auto& queue = get_queue<Read>();
+
+            while (true) {
+                // check if we have anything left in the queue
+                if (queue.read.load() == queue.write.load()) {
+                    queue.active = false;
+
+                    // make sure nothing was queued after the check above
+                    if (queue.read.load() == queue.write.load() || queue.active.exchange(true)) {
+                        return;
+                    }
+                }
+
+                const auto& request = queue.requests[queue.read.load() % QueueSize];
+                queue.zlp = false;
+
+                if (arm<Usb, Read>(request.data, request.size)) {
+                    return;
+                }
+
+                // could not arm the request, cancel it
+                complete<Read>(usb::error::cancel, 0);
+            }
+        }
+
+        /**
+         * @brief Cancel all the requests in the queue. Calls the callback
+         * of every request with the error code
+         *
+         * @tparam Usb
+         * @tparam Read
+         * @param error_code
+         */
+        template <typename Usb, bool Read>
+        static void flush(const usb::error error_code) {
+            auto& queue = get_queue<Read>();
+
+            // only cancel the requests we have now. Requests added in
+            // the callbacks are started after
+            const uint32_t end = queue.write.load();
+
+            while (queue.read.load() != end) {
+                complete<Read>(error_code, 0);
+            }
+
+            queue.active = false;
+
+            // make sure requests queued from the callbacks are not lost
+            if (queue.read.load() != queue.write.load() && !queue.active.exchange(true)) {
+                start_next<Usb, Read>();
+            }
+        }
+
+        /**
+         * @brief Add a request to the queue of the direction. Arms the
+         * endpoint when it is idle
+         *
+         * @tparam Usb
+         * @tparam Read
+         * @param data
+         * @param size
+         * @param callback
+         * @return true
+         * @return false
+         */
+        template <typename Usb, bool Read>
+        static bool push(uint8_t *const data, const uint32_t size, const request_callback callback) {
+            auto& queue = get_queue<Read>();
+
+            // check if we are configured and have space left
+            if (!configuration || (queue.write.load() - queue.read.load()) >= QueueSize) {
+                return false;
+            }
+
+            queue.requests[queue.write.load() % QueueSize] = {data, size, callback};
+            queue.write++;
+
+            // start the endpoint if it is idle. Otherwise the request
+            // is armed from the callback of the previous request
+            if (!queue.active.exchange(true)) {
+                start_next<Usb, Read>();
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Callback for when a write or read is finished. Arms
+         * the next request before calling the callbacks of the finished
+         * request so the endpoint stays busy
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         */
+        template <typename Usb>
+        static void callback(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            if (mode == usb::endpoint_mode::in) {
+                return transfer_done<Usb, false>(error_code, transferred);
+            }
             else {
-                if (receive_callback) {
-                    receive_callback();
+                return transfer_done<Usb, true>(error_code, transferred);
+            }
+        }
+
+        /**
+         * @brief Handle the end of the transfer of the request at the
+         * read index
+         *
+         * @tparam Usb
+         * @tparam Read
+         * @param error_code
+         * @param transferred
+         */
+        template <typename Usb, bool Read>
+        static void transfer_done(const usb::error error_code, const uint32_t transferred) {
+            auto& queue = get_queue<Read>();
+
+            // only continue if we do not have any errors
+            if (error_code != usb::error::no_error || !configuration) {
+                // we have a error. Return all the requests to the user
+                return flush<Usb, Read>(
+                    (error_code != usb::error::no_error) ? error_code : usb::error::reset
+                );
+            }
+
+            // get the size of the request. The zero length packet does not
+            // have any data so we use the size of the request
+            const uint32_t size = queue.zlp ? queue.requests[queue.read.load() % QueueSize].size : transferred;
+
+            // check if we need to send a zero length packet to tell the
+            // host the transfer is done
+            if constexpr (!Read) {
+                if (!queue.zlp && size && (size % config.endpoint0.wMaxPacketSize) == 0) {
+                    queue.zlp = true;
+
+                    if (arm<Usb, Read>(nullptr, 0)) {
+                        return;
+                    }
                 }
             }
+
+            // copy the request before starting the next one
+            const transfer_request request = queue.requests[queue.read.load() % QueueSize];
+            queue.read++;
+
+            // arm the next request before the callbacks so the bus does
+            // not idle while the user handles the data
+            start_next<Usb, Read>();
+
+            notify<Read>(request, error_code, size);
         }
 
     public:
         /**
-         * @brief Register the transmit and receive callbacks
+         * @brief Register the transmit and receive callbacks. The
+         * callbacks are called after every request
          *
          * @param transmit
          * @param receive
@@ -179,11 +464,12 @@ namespace klib::usb::device {
         }
 
         /**
-         * @brief Setup a read. Calls the receive callback when
-         * all the data is send to the host
+         * @brief Queue a read. Calls the receive callback when the
+         * buffer is full or the host ended the transfer with a short
+         * packet
          *
          * @tparam Usb
-         * @tparam Async
+         * @tparam Async when false waits until all the reads are done
          * @param data
          * @param size
          * @return true
@@ -191,22 +477,16 @@ namespace klib::usb::device {
          */
         template <typename Usb, bool Async = false>
         static bool setup(uint8_t *const data, const uint32_t size) {
-            if (data == nullptr || !size || is_busy<Usb, true>()) {
-                // we are still transmitting
+            if (!submit_read<Usb>(data, size)) {
                 return false;
             }
 
-            // start a read on the endpoint
-            Usb::read(callback<Usb>, usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                usb::endpoint_mode::out, {data, size}
-            );
-
             // check if we should exit
             if constexpr (Async) {
                 return true;
             }
 
-            // wait until we are done transmitting all characters
+            // wait until all the reads are done
             while (is_busy<Usb, true>()) {
                 // wait
             }
@@ -216,11 +496,11 @@ namespace klib::usb::device {
         }
 
         /**
-         * @brief write data to the host. Calls the transmit
+         * @brief Queue data to write to the host. Calls the transmit
          * callback when all the data is send
          *
          * @tparam Usb
-         * @tparam Async
+         * @tparam Async when false waits until all the writes are done
          * @param data
          * @param size
          * @return true
@@ -228,27 +508,13 @@ namespace klib::usb::device {
          */
         template <typename Usb, bool Async = false>
         static bool write(const uint8_t *const data, const uint32_t size) {
-            // check if we are configured
-            if (!configuration) {
-                return false;
-            }
-
             // check if we have a valid size
             if (size == 0) {
-                // return we are done. Nothing to do here
-                return true;
+                // return we are done when we are configured. Nothing to do here
+                return configuration;
             }
 
-            // check if a request is already pending
-            if (is_busy<Usb, false>()) {
-                // a other request is already pending exit
-                return false;
-            }
-
-            // start to the write to the endpoint
-            if (!Usb::write(callback<Usb>, usb::get_endpoint(config.endpoint0.bEndpointAddress),
-                usb::get_endpoint_mode(config.endpoint0.bEndpointAddress), {data, size}))
-            {
+            if (!submit_write<Usb>(data, size)) {
                 return false;
             }
 
@@ -257,7 +523,7 @@ namespace klib::usb::device {
                 return true;
             }
 
-            // wait until we are done transmitting all characters
+            // wait until all the writes are done
             while (is_busy<Usb, false>()) {
                 // do nothing
             }
@@ -265,6 +531,69 @@ namespace klib::usb::device {
             return true;
         }
 
+        /**
+         * @brief Queue a write request. The request is armed directly
+         * when the endpoint is idle or from the callback of the previous
+         * request. A zero length packet is added when the size is a
+         * multiple of the max packet size. A size of 0 sends a single
+         * zero length packet
+         *
+         * @warning data should be valid until the callback is called
+         *
+         * @tparam Usb
+         * @param data
+         * @param size
+         * @param callback called when the request is done or canceled
+         * @return true when the request is queued
+         * @return false when not configured or the queue is full
+         */
+        template <typename Usb>
+        static bool submit_write(const uint8_t *const data, const uint32_t size, const request_callback callback = nullptr) {
+            if (data == nullptr && size) {
+                return false;
+            }
+
+            // we remove the const here as write requests are never written
+            return push<Usb, false>(const_cast<uint8_t*>(data), size, callback);
+        }
+
+        /**
+         * @brief Queue a read request. The request is done when the
+         * buffer is full or the host sends a short packet
+         *
+         * @warning data should be valid until the callback is called
+         *
+         * @tparam Usb
+         * @param data
+         * @param size
+         * @param callback called when the request is done or canceled
+         * @return true when the request is queued
+         * @return false when not configured or the queue is full
+         */
+        template <typename Usb>
+        static bool submit_read(uint8_t *const data, const uint32_t size, const request_callback callback = nullptr) {
+            if (data == nullptr || !size) {
+                return false;
+            }
+
+            return push<Usb, true>(data, size, callback);
+        }
+
+        /**
+         * @brief Returns the amount of requests in the queue (including
+         * the request that is being transferred)
+         *
+         * @tparam Usb
+         * @tparam Read
+         * @return uint32_t
+         */
+        template <typename Usb, bool Read>
+        static uint32_t queued() {
+            auto& queue = get_queue<Read>();
+
+            return queue.write.load() - queue.read.load();
+        }
+
         /**
          * @brief Returns if the read or write is busy based
          * on the template parameter
@@ -276,20 +605,10 @@ namespace klib::usb::device {
          */
         template <typename Usb, bool Read>
         static bool is_busy() {
-            if constexpr (Read) {
-                // return if the read is still pending
-                return Usb::is_pending(
-                    usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint1.bEndpointAddress)
-                );
-            }
-            else {
-                // return if the transmit is still pending
-                return Usb::is_pending(
-                    usb::get_endpoint(config.endpoint0.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint0.bEndpointAddress)
-                );
-            }
+            auto& queue = get_queue<Read>();
+
+            // return if we still have requests in the queue
+            return queue.active || (queue.write.load() != queue.read.load());
         }
 
         /**
@@ -322,17 +641,14 @@ namespace klib::usb::device {
             configuration = 0x00;
             remote_wakeup = false;
 
-            // make sure the endpoints support bulk
-            // endpoints
-            static_assert(Usb::template is_valid_endpoint<
-                InEndpoint,
-                klib::usb::descriptor::transfer_type::bulk
-            >(), "invalid bulk endpoint selected");
-
-            static_assert(Usb::template is_valid_endpoint<
-                OutEndpoint,
-                klib::usb::descriptor::transfer_type::bulk
-            >(), "invalid bulk endpoint selected");
+            // clear the request queues
+            transmit_queue.read = transmit_queue.write.load();
+            transmit_queue.active = false;
+            receive_queue.read = receive_queue.write.load();
+            receive_queue.active = false;
+
+            // make sure all the endpoints in the configuration are supported
+            static_assert(descriptor::valid_endpoints<Usb, config>(), "invalid endpoint selected");
         }
 
         /**
@@ -355,6 +671,10 @@ namespace klib::usb::device {
         template <typename Usb>
         static void disconnected() {
             configuration = 0x00;
+
+            // return all the requests to the user
+            flush<Usb, false>(usb::error::reset);
+            flush<Usb, true>(usb::error::reset);
         }
 
         /**
@@ -366,6 +686,10 @@ namespace klib::usb::device {
         static void bus_reset() {
             // clear all the variables to default
             configuration = 0x00;
+
+            // return all the requests to the user
+            flush<Usb, false>(usb::error::reset);
+            flush<Usb, true>(usb::error::reset);
         }
 
         /**
@@ -5,6 +5,7 @@
 #include <span>
 #include <atomic>
 
+#include <klib/math.hpp>
 #include <klib/string.hpp>
 #include <klib/usb/usb/device.hpp>
 #include <klib/usb/usb/descriptor.hpp>
@@ -125,10 +126,8 @@ namespace klib::usb::device {
         #pragma pack(pop)
 
         // configuration descriptor
-        constexpr __attribute__((aligned(4))) static inline config_descriptor config = {
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
             {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x02,
                 .bConfigurationValue = 0x01,
                 .iConfiguration = 0x00,
                 .bmAttributes = 0x80,
@@ -145,7 +144,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x00,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = static_cast<uint8_t>(video::interface_type::video),
                 .bInterfaceSubClass = static_cast<uint16_t>(video::interface_subtype::videocontrol),
                 .bInterfaceProtocol = static_cast<uint8_t>(video::protocol_code::protocol_15),
@@ -217,7 +215,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x01,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x00,
                 .bInterfaceClass = static_cast<uint8_t>(video::interface_type::video),
                 .bInterfaceSubClass = static_cast<uint16_t>(video::interface_subtype::videostreaming),
                 .bInterfaceProtocol = static_cast<uint8_t>(video::protocol_code::protocol_15),
@@ -267,7 +264,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x01,
                 .bAlternateSetting = 0x01,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = static_cast<uint8_t>(video::interface_type::video),
                 .bInterfaceSubClass = static_cast<uint16_t>(video::interface_subtype::videostreaming),
                 .bInterfaceProtocol = static_cast<uint8_t>(video::protocol_code::protocol_15),
@@ -279,7 +275,7 @@ namespace klib::usb::device {
                 .wMaxPacketSize = MaxIsoEndpointSize,
                 .bInterval = 0x01
             }
-        };
+        });
     };
 
     /**
@@ -396,10 +392,8 @@ namespace klib::usb::device {
         #pragma pack(pop)
 
         // configuration descriptor
-        constexpr __attribute__((aligned(4))) static inline config_descriptor config = {
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
             {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x02,
                 .bConfigurationValue = 0x01,
                 .iConfiguration = 0x00,
                 .bmAttributes = 0x80,
@@ -416,7 +410,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x00,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = static_cast<uint8_t>(video::interface_type::video),
                 .bInterfaceSubClass = static_cast<uint16_t>(video::interface_subtype::videocontrol),
                 .bInterfaceProtocol = static_cast<uint8_t>(video::protocol_code::protocol_15),
@@ -488,7 +481,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x01,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x00,
                 .bInterfaceClass = static_cast<uint8_t>(video::interface_type::video),
                 .bInterfaceSubClass = static_cast<uint16_t>(video::interface_subtype::videostreaming),
                 .bInterfaceProtocol = static_cast<uint8_t>(video::protocol_code::protocol_15),
@@ -540,7 +532,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x01,
                 .bAlternateSetting = 0x01,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = static_cast<uint8_t>(video::interface_type::video),
                 .bInterfaceSubClass = static_cast<uint16_t>(video::interface_subtype::videostreaming),
                 .bInterfaceProtocol = static_cast<uint8_t>(video::protocol_code::protocol_15),
@@ -552,17 +543,129 @@ namespace klib::usb::device {
                 .wMaxPacketSize = MaxIsoEndpointSize,
                 .bInterval = 0x01
             }
-        };
+        });
     };
 
     /**
      * @brief USB camera class that uses a video type to allow writing video frames to the host
      * 
      * @tparam VideoType 
+     * @tparam FrameQueueSize amount of frames that can be queued for streaming
      */
-    template <typename VideoType>
+    template <typename VideoType, uint32_t FrameQueueSize = 2>
     class camera {
+    public:
+        // size of the uvc payload header in front of every isochronous packet
+        constexpr static uint32_t header_size = 2;
+
+        // callback that is called when a queued frame is done streaming
+        using frame_callback = void(*)(const uint8_t *const data);
+
+        /**
+         * @brief Frame layout with a reserved header slot in front of every
+         * payload. This allows the camera to send the payloads directly
+         * from the frame without copying them
+         *
+         * @details every payload is placed on a 4 byte aligned stride of
+         * the isochronous endpoint size. The first 2 bytes of every stride
+         * are reserved for the uvc payload header
+         *
+         * @tparam Size maximum amount of image bytes in the frame
+         */
+        template <uint32_t Size>
+        class frame {
+        public:
+            // amount of image data in a single payload
+            constexpr static uint32_t payload_size = VideoType::max_iso_endpoint_size - header_size;
+
+            // distance between the start of every payload
+            constexpr static uint32_t stride = (VideoType::max_iso_endpoint_size + 3) & ~0x3;
+
+            // amount of payloads in the frame
+            constexpr static uint32_t payload_count = (Size + payload_size - 1) / payload_size;
+
+            // maximum amount of image bytes in the frame
+            constexpr static uint32_t max_size = Size;
+
+            // raw buffer with the headers and the image data
+            __attribute__((aligned(4))) uint8_t raw[payload_count * stride] = {};
+
+            /**
+             * @brief Get the image data of a payload
+             *
+             * @param index
+             * @return std::span<uint8_t>
+             */
+            constexpr std::span<uint8_t> payload(const uint32_t index) {
+                return {
+                    &raw[(index * stride) + header_size],
+                    klib::min(payload_size, Size - (index * payload_size))
+                };
+            }
+
+            /**
+             * @brief Access a image byte in the frame
+             *
+             * @param index
+             * @return uint8_t&
+             */
+            constexpr uint8_t& operator[](const uint32_t index) {
+                return raw[((index / payload_size) * stride) + header_size + (index % payload_size)];
+            }
+
+            /**
+             * @brief Copy image data into the frame at a offset. Data past
+             * the end of the frame is dropped
+             *
+             * @details can be used as the output of a encoder (e.g.
+             * klib::graphics::jpeg_encoder) to write the stream directly
+             * into the frame
+             *
+             * @param offset
+             * @param data
+             * @return uint32_t amount of bytes copied
+             */
+            constexpr uint32_t copy(uint32_t offset, std::span<const uint8_t> data) {
+                // limit the data to the size of the frame
+                data = data.first(klib::min(data.size(), Size - klib::min(offset, Size)));
+
+                const uint32_t result = data.size();
+
+                while (data.size()) {
+                    // get the amount we can copy in the current payload
+                    const uint32_t size = klib::min(
+                        payload_size - (offset % payload_size), data.size()
+                    );
+
+                    std::copy_n(data.data(), size, &(*this)[offset]);
+
+                    offset += size;
+                    data = data.subspan(size);
+                }
+
+                return result;
+            }
+        };
+
     protected:
+        /**
+         * @brief Frame in the stream queue
+         *
+         */
+        struct queued_frame {
+            // raw frame data with the header slots
+            uint8_t* raw;
+
+            // amount of image bytes in the frame
+            uint32_t size;
+
+            // distance between every payload in the raw data
+            uint32_t stride;
+
+            // callback when the frame is done
+            frame_callback callback;
+        };
+
         // device descriptor for the camera
         const __attribute__((aligned(4))) static inline descriptor::device device = {
             .bcdUSB = setup::usb_version::usb_v1_1,
@@ -582,6 +685,20 @@ namespace klib::usb::device {
         __attribute__((aligned(4))) static inline video::probe_control probe_control = {};
         __attribute__((aligned(4))) static inline video::probe_control commit_control = {};
 
+        // response to a probe request. We only support a single format and
+        // frame so the response does not depend on what the host proposes
+        constexpr __attribute__((aligned(4))) static inline video::probe_control probe_response = {
+            .bmHint = 0x0001,
+            .bFormatIndex = VideoType::config.format.bFormatIndex,
+            .bFrameIndex = VideoType::config.frame.bFrameIndex,
+            .dwFrameInterval = VideoType::config.frame.dwDefaultFrameInterval,
+            .dwMaxVideoFrameSize = static_cast<uint32_t>(
+                (VideoType::config.frame.wHeight * VideoType::config.frame.wWidth * 16) / 2
+            ),
+            .dwMaxPayloadTransferSize = VideoType::config.endpoint1.wMaxPacketSize,
+            .dwClockFrequency = VideoType::config.vc_interface.dwClockFrequency,
+        };
+
         // language descriptor for the camera
         const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
             .bString = {0x0409}
@@ -610,6 +727,21 @@ namespace klib::usb::device {
         static inline std::atomic<const uint8_t*> buffer = nullptr;
         static inline std::atomic<uint32_t> bytes_to_transfer = 0;
 
+        // queue with frames to stream. The write index is only changed by the
+        // user and the read index only in the endpoint callback
+        static inline queued_frame frame_queue[FrameQueueSize] = {};
+        static inline std::atomic<uint32_t> queue_write = 0;
+        static inline std::atomic<uint32_t> queue_read = 0;
+
+        // current payload in the front frame
+        static inline uint32_t frame_payload = 0;
+
+        // frame id bit that is toggled for every frame
+        static inline uint8_t frame_id = 0;
+
+        // flag if the endpoint is busy streaming the queue
+        static inline std::atomic<bool> streaming = false;
+
         template <typename Usb>
         static usb::handshake set_current_impl(const klib::usb::setup_packet &packet) {
             // check if we have a valid packet
@@ -688,18 +820,10 @@ namespace klib::usb::device {
 
                 // check if we have a probe request
                 if (cs == 0x01) {
-                    // overwrite anything the host might have set differently
-                    probe_control.dwFrameInterval = VideoType::config.frame.dwDefaultFrameInterval;
-                    probe_control.dwMaxVideoFrameSize = static_cast<uint32_t>(
-                        (VideoType::config.frame.wHeight * VideoType::config.frame.wWidth * 16) / 2
-                    );
-                    probe_control.dwMaxPayloadTransferSize = VideoType::config.endpoint1.wMaxPacketSize;
-                    probe_control.dwClockFrequency = VideoType::config.vc_interface.dwClockFrequency;
-
-                    // write the data to the control endpoint
+                    // write the precomputed response to the control endpoint
                     if (Usb::write(usb::status_callback<Usb>,
                         usb::control_endpoint, usb::endpoint_mode::in,
-                        {reinterpret_cast<const uint8_t*>(&probe_control), klib::min(packet.wLength, sizeof(probe_control))}))
+                        {reinterpret_cast<const uint8_t*>(&probe_response), klib::min(packet.wLength, sizeof(probe_response))}))
                     {
                         // no issue for now ack
                         return usb::handshake::wait;
@@ -781,6 +905,89 @@ namespace klib::usb::device {
             }
         }
 
+        template <typename Usb>
+        static void stream_callback(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            // check if we have a nak. If we have do nothing
+            if (error_code == usb::error::nak) {
+                return;
+            }
+
+            // check if we have an error
+            if (error_code != usb::error::no_error) {
+                // something went wrong, stall the endpoint and return
+                // all the queued frames to the user
+                Usb::stall(endpoint, mode);
+                flush();
+
+                return;
+            }
+
+            while (true) {
+                // check if we have a frame to stream
+                if (queue_read.load() == queue_write.load()) {
+                    streaming = false;
+
+                    // make sure no frame was queued after the check above. If
+                    // the user also saw we were streaming we need to continue
+                    if (queue_read.load() == queue_write.load() || streaming.exchange(true)) {
+                        return;
+                    }
+                }
+
+                const auto& current = frame_queue[queue_read.load() % FrameQueueSize];
+                const uint32_t offset = frame_payload * (sizeof(video_buffer) - header_size);
+
+                // check if we have any data left in the frame. A empty frame
+                // still sends a single end of frame header
+                if (offset < current.size || (!current.size && !frame_payload)) {
+                    const uint32_t size = klib::min(sizeof(video_buffer) - header_size, current.size - offset);
+
+                    // fill the reserved header slot in front of the payload.
+                    // Mark the end of the frame in the last payload
+                    uint8_t *const header = &current.raw[frame_payload * current.stride];
+                    header[0] = header_size;
+                    header[1] = 0x80 | frame_id | (((offset + size) >= current.size) ? 0x02 : 0x00);
+
+                    frame_payload++;
+
+                    // send the payload directly from the frame
+                    Usb::write(stream_callback<Usb>, endpoint, mode, {header, size + header_size});
+
+                    return;
+                }
+
+                // frame is done. Move to the next frame
+                frame_payload = 0;
+                frame_id ^= 0x01;
+
+                const auto callback = current.callback;
+                const auto raw = current.raw;
+
+                queue_read++;
+
+                // notify the user the frame can be reused
+                if (callback) {
+                    callback(raw);
+                }
+            }
+        }
+
+        static void flush() {
+            // return all the frames to the user
+            while (queue_read.load() != queue_write.load()) {
+                const auto& current = frame_queue[queue_read.load() % FrameQueueSize];
+
+                queue_read++;
+
+                if (current.callback) {
+                    current.callback(current.raw);
+                }
+            }
+
+            frame_payload = 0;
+            streaming = false;
+        }
+
     public:
         /**
          * @brief Returns if the device is configured
@@ -868,6 +1075,62 @@ namespace klib::usb::device {
             }
         }
 
+        /**
+         * @brief Queue a frame for streaming. The payloads are sent directly
+         * from the frame without copying them. The frame should not be changed
+         * until the callback is called
+         *
+         * @warning should not be mixed with the write function
+         *
+         * @details multiple frames can be queued so the next frame can be
+         * rendered while the previous is being streamed. The callback is
+         * called from the usb interrupt when the frame is done
+         *
+         * @tparam Usb
+         * @tparam Size
+         * @param data frame with the reserved header slots
+         * @param callback called when the frame is done streaming
+         * @param size amount of image bytes in the frame
+         * @return true when the frame is queued
+         * @return false when the queue is full
+         */
+        template <typename Usb, uint32_t Size>
+        static bool queue(frame<Size>& data, const frame_callback callback = nullptr, const uint32_t size = Size) {
+            // check if we have space in the queue
+            if ((queue_write.load() - queue_read.load()) >= FrameQueueSize) {
+                return false;
+            }
+
+            // add the frame to the queue
+            frame_queue[queue_write.load() % FrameQueueSize] = {
+                data.raw, klib::min(size, Size), frame<Size>::stride, callback
+            };
+
+            queue_write++;
+
+            // start streaming if we are not busy
+            if (!streaming.exchange(true)) {
+                stream_callback<Usb>(
+                    usb::get_endpoint(VideoType::config.endpoint1.bEndpointAddress),
+                    usb::get_endpoint_mode(VideoType::config.endpoint1.bEndpointAddress),
+                    usb::error::no_error, 0
+                );
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Returns the amount of frames in the stream queue
+         *
+         * @tparam Usb
+         * @return uint32_t
+         */
+        template <typename Usb>
+        static uint32_t queued() {
+            return queue_write.load() - queue_read.load();
+        }
+
         /**
          * @brief Returns if the endpoint is busy
          * 
@@ -877,7 +1140,7 @@ namespace klib::usb::device {
         template <typename Usb>
         static bool is_busy() {
             // return if the endpoint is busy
-            return bytes_to_transfer || Usb::is_pending(
+            return bytes_to_transfer || streaming || Usb::is_pending(
                 usb::get_endpoint(VideoType::config.endpoint1.bEndpointAddress),
                 usb::get_endpoint_mode(VideoType::config.endpoint1.bEndpointAddress)
             );
@@ -897,16 +1160,8 @@ namespace klib::usb::device {
          */
         template <typename Usb>
         static void init() {
-            // make sure the endpoint supports interrupt endpoints
-            static_assert(Usb::template is_valid_endpoint<
-                VideoType::interrupt_endpoint,
-                klib::usb::descriptor::transfer_type::interrupt
-            >(), "invalid interrupt selected");
-
-            static_assert(Usb::template is_valid_endpoint<
-                VideoType::iso_endpoint,
-                klib::usb::descriptor::transfer_type::isochronous
-            >(), "invalid isochronous selected");
+            // make sure all the endpoints in the configuration are supported
+            static_assert(descriptor::valid_endpoints<Usb, VideoType::config>(), "invalid endpoint selected");
         }
 
         /**
@@ -930,6 +1185,9 @@ namespace klib::usb::device {
         static void disconnected() {
             // clear all the variables to default
             configuration = 0x00;
+
+            // return all the queued frames to the user
+            flush();
         }
 
         /**
@@ -941,6 +1199,9 @@ namespace klib::usb::device {
         static void bus_reset() {
             // clear all the variables to default
             configuration = 0x00;
+
+            // return all the queued frames to the user
+            flush();
         }
 
         /**
@@ -0,0 +1,731 @@
+#ifndef KLIB_USB_COMPOSITE_HPP
+#define KLIB_USB_COMPOSITE_HPP
+
+#include <array>
+#include <bit>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+
+#include <klib/usb/usb/device.hpp>
+#include <klib/usb/usb/descriptor.hpp>
+
+namespace klib::usb::device::detail {
+    /**
+     * @brief Get the first value of every function when all the counts
+     * are added after each other. The last entry has the total
+     *
+     * @tparam Start
+     * @tparam Counts
+     * @return std::array<uint8_t, sizeof...(Counts) + 1>
+     */
+    template <uint8_t Start, uint8_t... Counts>
+    consteval std::array<uint8_t, sizeof...(Counts) + 1> offsets() {
+        const std::array<uint8_t, sizeof...(Counts)> counts = {Counts...};
+        std::array<uint8_t, sizeof...(Counts) + 1> result = {Start};
+
+        for (uint32_t i = 0; i < counts.size(); i++) {
+            result[i + 1] = result[i] + counts[i];
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Convert a descriptor to the raw bytes
+     *
+     * @tparam T
+     * @param desc
+     * @return std::array<uint8_t, sizeof(T)>
+     */
+    template <typename T>
+    consteval std::array<uint8_t, sizeof(T)> to_bytes(const T& desc) {
+        return std::bit_cast<std::array<uint8_t, sizeof(T)>>(desc);
+    }
+
+    /**
+     * @brief Helper that binds all the functions to their interfaces
+     * and endpoints and creates the compile time tables to route the
+     * requests to the correct function
+     *
+     * @tparam Sequence
+     * @tparam Functions
+     */
+    template <typename Sequence, typename... Functions>
+    class composite_functions;
+
+    template <std::size_t... Is, typename... Functions>
+    class composite_functions<std::index_sequence<Is...>, Functions...> {
+    public:
+        // first interface of every function. Interfaces start at 0
+        constexpr static auto interface_offsets = offsets<0, Functions::interface_count...>();
+
+        // first endpoint of every function. Endpoint 0 is the control
+        // endpoint so we start at 1
+        constexpr static auto endpoint_offsets = offsets<1, Functions::endpoint_count...>();
+
+        /**
+         * @brief Function at Index bound to its interfaces and endpoints
+         *
+         * @tparam Index
+         */
+        template <std::size_t Index>
+        using function = typename std::tuple_element_t<Index, std::tuple<Functions...>>::template function<
+            interface_offsets[Index], endpoint_offsets[Index]
+        >;
+
+        // total size of the configuration descriptor
+        constexpr static uint32_t config_size = sizeof(descriptor::configuration) + (
+            (sizeof(descriptor::interface_association) + sizeof(function<Is>::interfaces)) + ...
+        );
+
+        // handler for a setup packet
+        using handler = usb::handshake (*)(const setup_packet &packet);
+
+        /**
+         * @brief Create the configuration descriptor with all the
+         * functions after each other. Every function gets a interface
+         * association descriptor
+         *
+         * @param configuration
+         * @return std::array<uint8_t, config_size>
+         */
+        consteval static std::array<uint8_t, config_size> create_config(const descriptor::configuration& configuration) {
+            std::array<uint8_t, config_size> result = {};
+            uint32_t offset = 0;
+
+            // helper to add a descriptor to the result
+            const auto append = [&](const auto& data) {
+                for (const auto d : data) {
+                    result[offset++] = d;
+                }
+            };
+
+            // add the configuration descriptor
+            append(to_bytes(configuration));
+
+            // add every function with its association
+            ((append(to_bytes(function<Is>::association)), append(to_bytes(function<Is>::interfaces))), ...);
+
+            return result;
+        }
+
+        /**
+         * @brief Create a table with a handler for every interface
+         *
+         * @tparam Handlers handler of every function
+         * @return std::array<handler, interface_offsets.back()>
+         */
+        template <handler... Handlers>
+        consteval static std::array<handler, interface_offsets.back()> create_interface_table() {
+            std::array<handler, interface_offsets.back()> result = {};
+
+            // set the handler for all the interfaces of every function
+            ((std::fill_n(&result[interface_offsets[Is]], Functions::interface_count, Handlers)), ...);
+
+            return result;
+        }
+
+        /**
+         * @brief Create a table with a handler for every endpoint
+         *
+         * @tparam Handlers handler of every function
+         * @return std::array<handler, endpoint_offsets.back()>
+         */
+        template <handler... Handlers>
+        consteval static std::array<handler, endpoint_offsets.back()> create_endpoint_table() {
+            std::array<handler, endpoint_offsets.back()> result = {};
+
+            // set the handler for all the endpoints of every function
+            ((std::fill_n(&result[endpoint_offsets[Is]], Functions::endpoint_count, Handlers)), ...);
+
+            return result;
+        }
+
+        /**
+         * @brief Configure all the functions
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void configure() {
+            (function<Is>::template configure<Usb>(), ...);
+        }
+
+        /**
+         * @brief Deconfigure all the functions
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void deconfigure() {
+            (function<Is>::template deconfigure<Usb>(), ...);
+        }
+
+        /**
+         * @brief Init all the functions
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void init() {
+            (function<Is>::template init<Usb>(), ...);
+        }
+
+        /**
+         * @brief Notify all the functions of a bus reset
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void bus_reset() {
+            ([]() {
+                if constexpr (requires { function<Is>::template bus_reset<Usb>(); }) {
+                    function<Is>::template bus_reset<Usb>();
+                }
+            }(), ...);
+        }
+
+        /**
+         * @brief Notify all the functions of a disconnect
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void disconnected() {
+            ([]() {
+                if constexpr (requires { function<Is>::template disconnected<Usb>(); }) {
+                    function<Is>::template disconnected<Usb>();
+                }
+            }(), ...);
+        }
+
+        /**
+         * @brief Get a string descriptor from the functions that
+         * provide their own strings
+         *
+         * @tparam Usb
+         * @param index
+         * @return usb::description
+         */
+        template <typename Usb>
+        static usb::description get_string(const uint8_t index) {
+            usb::description result = {nullptr, 0};
+
+            ([&]() {
+                if constexpr (requires { function<Is>::template get_string<Usb>(index); }) {
+                    if (!result.size) {
+                        result = function<Is>::template get_string<Usb>(index);
+                    }
+                }
+            }(), ...);
+
+            return result;
+        }
+    };
+}
+
+namespace klib::usb::device {
+    /**
+     * @brief Composite usb device. Combines multiple functions in a
+     * single device. The interfaces and endpoints of every function
+     * are numbered at compile time in the order the functions are
+     * provided. Every function gets a interface association descriptor.
+     *
+     * Class requests and get/set interface requests are routed to the
+     * function that owns the interface or endpoint using compile time
+     * tables. Endpoint callbacks do not need any routing as every
+     * transfer has its own callback.
+     *
+     * A function needs to provide the following:
+     *  - interface_count and endpoint_count
+     *  - template <uint8_t Interface, uint8_t Endpoint> using function
+     *
+     * The bound function needs to provide:
+     *  - association and interfaces descriptors
+     *  - init, configure, deconfigure and handle_class_packet
+     *  - optional: get_interface, set_interface, bus_reset, disconnected
+     *    and get_string (for string descriptors owned by the function)
+     *
+     * @warning endpoints are assigned in order starting at endpoint 1.
+     * Hardware that has fixed endpoint types might need a different
+     * function order
+     *
+     * @details usage:
+     *  using device = composite<serial<>, mass_storage<Memory>>;
+     *  using cdc = device::function<0>;
+     *
+     * @tparam Functions
+     */
+    template <typename... Functions>
+    class composite {
+    protected:
+        static_assert(sizeof...(Functions) > 0, "Composite device requires at least one function");
+
+        // helper with all the functions
+        using functions = detail::composite_functions<std::index_sequence_for<Functions...>, Functions...>;
+
+        // handler for a setup packet
+        using handler = typename functions::handler;
+
+    public:
+        // amount of interfaces in the device
+        constexpr static uint8_t interface_count = functions::interface_offsets.back();
+
+        // last endpoint used by the functions
+        constexpr static uint8_t endpoint_count = functions::endpoint_offsets.back() - 1;
+
+        /**
+         * @brief Function at Index bound to its interfaces and
+         * endpoints. Use this type to access the function
+         *
+         * @tparam Index
+         */
+        template <std::size_t Index>
+        using function = typename functions::template function<Index>;
+
+    protected:
+        static_assert(endpoint_count < 16, "Composite device uses too many endpoints");
+
+        /**
+         * @brief Enum with the string descriptor indexes
+         *
+         */
+        enum class string_index {
+            language = 0,
+            manufacturer = 1,
+            product = 2,
+            serial = 3
+        };
+
+        // device descriptor for the composite device. Uses the
+        // interface association class codes
+        const __attribute__((aligned(4))) static inline descriptor::device device = {
+            .bcdUSB = setup::usb_version::usb_v2_0,
+            .bDeviceClass = descriptor::class_type::miscellaneous,
+            .bDeviceSubClass = 0x02,
+            .bDeviceProtocol = 0x01,
+            .bMaxPacketSize = 0x40,
+            .idVendor = 0x6666,
+            .idProduct = 0xc0de,
+            .bcdDevice = 0x0100,
+            .iManufacturer = static_cast<uint8_t>(string_index::manufacturer),
+            .iProduct = static_cast<uint8_t>(string_index::product),
+            .iSerialNumber = static_cast<uint8_t>(string_index::serial),
+            .bNumConfigurations = 0x1
+        };
+
+        // configuration value of the composite device
+        constexpr static uint8_t configuration_value = 0x01;
+
+        // configuration descriptor with all the functions
+        constexpr __attribute__((aligned(4))) static inline auto config = descriptor::finalize(functions::create_config({
+            .bConfigurationValue = configuration_value,
+            .iConfiguration = 0x00,
+            .bmAttributes = 0x80,
+            .bMaxPower = 0x32,
+        }));
+
+        // language descriptor for the composite device
+        const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
+            .bString = {0x0409}
+        };
+
+        // manufacturer string descriptor
+        const __attribute__((aligned(4))) static inline auto manufacturer = string_descriptor("KLIB");
+
+        // product string descriptor
+        const __attribute__((aligned(4))) static inline auto product = string_descriptor("KLIB Composite");
+
+        // serial number string descriptor
+        const __attribute__((aligned(4))) static inline auto serial = string_descriptor("00001337");
+
+        // configuration value. Value is set in the set config function
+        static inline uint8_t configuration = 0x00;
+
+        /**
+         * @brief Default get interface for functions without alternate
+         * settings. Always sends alternate setting 0
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake default_get_interface(const klib::usb::setup_packet &packet) {
+            // always send back 0x00 as the interface
+            constexpr static uint8_t alternate = 0x00;
+
+            // send the interface back to the host
+            const auto result = Usb::write(
+                usb::status_callback<Usb>, usb::control_endpoint,
+                usb::endpoint_mode::in,
+                {&alternate, sizeof(alternate)}
+            );
+
+            // check if something went wrong already
+            if (!result) {
+                // something went wrong stall
+                return usb::handshake::stall;
+            }
+
+            // we do not ack here as the status callback
+            // will handle this for us
+            return usb::handshake::wait;
+        }
+
+        /**
+         * @brief Default set interface for functions without alternate
+         * settings. Only accepts alternate setting 0
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake default_set_interface(const klib::usb::setup_packet &packet) {
+            return packet.wValue ? usb::handshake::stall : usb::handshake::ack;
+        }
+
+        /**
+         * @brief Get the get interface handler of a function
+         *
+         * @tparam Usb
+         * @tparam Index
+         * @return handler
+         */
+        template <typename Usb, std::size_t Index>
+        consteval static handler get_interface_handler() {
+            if constexpr (requires(const setup_packet &packet) { function<Index>::template get_interface<Usb>(packet); }) {
+                return function<Index>::template get_interface<Usb>;
+            }
+            else {
+                return default_get_interface<Usb>;
+            }
+        }
+
+        /**
+         * @brief Get the set interface handler of a function
+         *
+         * @tparam Usb
+         * @tparam Index
+         * @return handler
+         */
+        template <typename Usb, std::size_t Index>
+        consteval static handler set_interface_handler() {
+            if constexpr (requires(const setup_packet &packet) { function<Index>::template set_interface<Usb>(packet); }) {
+                return function<Index>::template set_interface<Usb>;
+            }
+            else {
+                return default_set_interface<Usb>;
+            }
+        }
+
+        /**
+         * @brief Route a packet to the function that owns the interface
+         * in wIndex using the table
+         *
+         * @tparam Size
+         * @param table
+         * @param packet
+         * @return usb::handshake
+         */
+        template <std::size_t Size>
+        static usb::handshake route(const std::array<handler, Size>& table, const uint8_t index, const klib::usb::setup_packet &packet) {
+            // check if the index is valid
+            if (index >= table.size() || !table[index]) {
+                return usb::handshake::stall;
+            }
+
+            return table[index](packet);
+        }
+
+    public:
+        /**
+         * @brief Returns if the device is configured
+         *
+         * @tparam Usb
+         * @return true
+         * @return false
+         */
+        template <typename Usb>
+        static bool is_configured() {
+            return static_cast<volatile uint8_t>(configuration) != 0;
+        }
+
+    public:
+        /**
+         * @brief static functions needed for the usb stack. Should not
+         * be called manually
+         *
+         */
+
+        /**
+         * @brief Called when the host is disconnected
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void disconnected() {
+            configuration = 0x00;
+
+            // notify all the functions
+            functions::template disconnected<Usb>();
+        }
+
+        /**
+         * @brief Called when a bus reset has occured
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void bus_reset() {
+            configuration = 0x00;
+
+            // notify all the functions
+            functions::template bus_reset<Usb>();
+        }
+
+        /**
+         * @brief Called when get interface is received. Routed to the
+         * function that owns the interface
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake get_interface(const klib::usb::setup_packet &packet) {
+            // table with the get interface handler for every interface
+            constexpr static auto table = []<std::size_t... Is>(std::index_sequence<Is...>) {
+                return functions::template create_interface_table<get_interface_handler<Usb, Is>()...>();
+            }(std::index_sequence_for<Functions...>{});
+
+            return route(table, packet.wIndex & 0xff, packet);
+        }
+
+        /**
+         * @brief Called when set interface is received. Routed to the
+         * function that owns the interface
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake set_interface(const klib::usb::setup_packet &packet) {
+            // table with the set interface handler for every interface
+            constexpr static auto table = []<std::size_t... Is>(std::index_sequence<Is...>) {
+                return functions::template create_interface_table<set_interface_handler<Usb, Is>()...>();
+            }(std::index_sequence_for<Functions...>{});
+
+            return route(table, packet.wIndex & 0xff, packet);
+        }
+
+        /**
+         * @brief Called when a class specific packet is received. Routed
+         * to the function that owns the interface or endpoint
+         *
+         * @tparam Usb
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake handle_class_packet(const klib::usb::setup_packet &packet) {
+            // tables with the class handler for every interface and endpoint
+            constexpr static auto interfaces = []<std::size_t... Is>(std::index_sequence<Is...>) {
+                return functions::template create_interface_table<function<Is>::template handle_class_packet<Usb>...>();
+            }(std::index_sequence_for<Functions...>{});
+
+            constexpr static auto endpoints = []<std::size_t... Is>(std::index_sequence<Is...>) {
+                return functions::template create_endpoint_table<function<Is>::template handle_class_packet<Usb>...>();
+            }(std::index_sequence_for<Functions...>{});
+
+            // route the packet based on the recipient
+            switch (usb::get_recipient(packet)) {
+                case setup::recipient_code::interface:
+                    return route(interfaces, packet.wIndex & 0xff, packet);
+                case setup::recipient_code::endpoint:
+                    return route(endpoints, usb::get_endpoint(packet.wIndex & 0xff), packet);
+                default:
+                    // we do not know what function to send this to
+                    return usb::handshake::stall;
+            }
+        }
+
+        /**
+         * @brief Init function. Called when the usb stack is initalized
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void init() {
+            // init all the variables to default
+            configuration = 0x00;
+
+            // init all the functions
+            functions::template init<Usb>();
+        }
+
+        /**
+         * @brief Get the configuration of the config. Needed
+         * for some hardware
+         *
+         * @tparam Usb
+         * @return uint16_t
+         */
+        template <typename Usb>
+        static uint8_t get_configuration() {
+            return configuration_value;
+        }
+
+        /**
+         * @brief Clear a feature on the device
+         *
+         * @tparam Usb
+         * @param feature
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake clear_feature(const klib::usb::setup::feature feature, const klib::usb::setup_packet &packet) {
+            // no features are supported. Stall to notify this
+            return usb::handshake::stall;
+        }
+
+        /**
+         * @brief Set a feature on the device
+         *
+         * @tparam Usb
+         * @param feature
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake set_feature(const klib::usb::setup::feature feature, const klib::usb::setup_packet &packet) {
+            // no features are supported. Stall to notify this
+            return usb::handshake::stall;
+        }
+
+        /**
+         * @brief Get the descriptor for the descriptor type and index
+         *
+         * @tparam Usb
+         * @param packet
+         * @param type
+         * @param index
+         * @return usb::description
+         */
+        template <typename Usb>
+        static usb::description get_descriptor(const setup_packet &packet, descriptor::descriptor_type type, const uint8_t index) {
+            // check if we have a default usb descriptor
+            switch (type) {
+                case descriptor::descriptor_type::device:
+                    // return the device descriptor
+                    return to_description(device, device.bLength);
+                case descriptor::descriptor_type::configuration:
+                    // return the whole configuration descriptor
+                    return to_description(config.data(), config.size());
+                case descriptor::descriptor_type::string:
+                    // check what string descriptor to send
+                    switch (static_cast<string_index>(index)) {
+                        case string_index::language:
+                            return to_description(language, language.bLength);
+                        case string_index::manufacturer:
+                            return to_description(manufacturer, manufacturer.bLength);
+                        case string_index::product:
+                            return to_description(product, product.bLength);
+                        case string_index::serial:
+                            return to_description(serial, serial.bLength);
+                        default:
+                            // might be a string owned by a function
+                            return functions::template get_string<Usb>(index);
+                    }
+                default:
+                    // unkown default descriptor. Might be a class descriptor
+                    break;
+            }
+
+            // unkown get descriptor call. return a nullptr and 0 size
+            return {nullptr, 0};
+        }
+
+        /**
+         * @brief Get the configuration value set in the set config call
+         *
+         * @tparam Usb
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake get_config(const klib::usb::setup_packet &packet) {
+            // send the configuration back to the host
+            const auto result = Usb::write(
+                usb::status_callback<Usb>, usb::control_endpoint,
+                usb::endpoint_mode::in,
+                {&configuration, sizeof(configuration)}
+            );
+
+            // check if something went wrong already
+            if (!result) {
+                // something went wrong stall
+                return usb::handshake::stall;
+            }
+
+            // we do not ack here as the status callback
+            // will handle this for us
+            return usb::handshake::wait;
+        }
+
+        /**
+         * @brief Set a configuration value. Configures or deconfigures
+         * all the functions
+         *
+         * @tparam Usb
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake set_config(const klib::usb::setup_packet &packet) {
+            // check if the set is the same as the configuration we have stored
+            if (packet.wValue == configuration_value) {
+                // configure all the functions
+                functions::template configure<Usb>();
+
+                // store the configuration value
+                configuration = packet.wValue;
+
+                // notify the usb driver we are configured
+                Usb::configured(true);
+
+                // return everything is oke
+                return usb::handshake::ack;
+            }
+            else if (packet.wValue == 0) {
+                // notify the usb driver we are not configured anymore
+                Usb::configured(false);
+
+                // deconfigure all the functions
+                functions::template deconfigure<Usb>();
+
+                // clear the configuration value
+                configuration = 0x00;
+
+                // ack the packet
+                return usb::handshake::ack;
+            }
+            else {
+                // not sure what to do, stall
+                return usb::handshake::stall;
+            }
+        }
+
+        /**
+         * @brief Get the device status. Called when the status is requested
+         *
+         * @tparam Usb
+         * @return uint8_t
+         */
+        template <typename Usb>
+        static uint8_t get_device_status() {
+            return 0;
+        }
+    };
+}
+
+#endif
@@ -4,13 +4,37 @@
 #include <algorithm>
 #include <cstdint>
 
+#include <klib/math.hpp>
+#include <klib/crypt/crc.hpp>
+#include <klib/io/systick.hpp>
 #include <klib/usb/usb/usb.hpp>
 #include <klib/usb/usb/device.hpp>
 #include <klib/usb/usb/dfu/descriptor.hpp>
 #include <klib/usb/usb/dfu/request.hpp>
 
 namespace klib::usb::device {
-    template <typename Memory, uint32_t TransferSize = 64>
+    /**
+     * @brief Usb dfu device.
+     *
+     * @details when Background is enabled the device uses two
+     * buffers. A received block is programmed from thread context
+     * in the process function while the host sends the next block
+     * into the other buffer. The measured program time is reported
+     * to the host as poll timeout. Before manifestation a crc32 of
+     * the received image is compared against the memory (when the
+     * memory supports reading back).
+     *
+     * @tparam Memory
+     * @tparam TransferSize size of a single block. Reported to the
+     * host in wTransferSize
+     * @tparam Background program the memory from the process function
+     * instead of the usb interrupt
+     * @tparam Timer timer used to measure the program time
+     */
+    template <
+        typename Memory, uint32_t TransferSize = 64, bool Background = false,
+        typename Timer = klib::io::systick<>
+    >
     class dfu {
     protected:
         /**
@@ -25,13 +49,36 @@ namespace klib::usb::device {
             flash_information = 4
         };
 
-        // buffer for the firmware (data we are reading
+        // amount of buffers for the firmware. In background mode we
+        // receive the next block while programming the other buffer
+        constexpr static uint32_t buffer_count = Background ? 2 : 1;
+
+        // make sure the transfer size fits in the functional descriptor
+        static_assert(TransferSize > 0 && TransferSize <= 0xffff, "Invalid dfu transfer size");
+
+        // buffers for the firmware (data we are reading
         // should be 4 byte aligned as some devices requre
         // this).
-        static __attribute__((aligned(4))) inline uint8_t buffer[TransferSize] = {};
+        static __attribute__((aligned(4))) inline uint8_t buffer[buffer_count][TransferSize] = {};
+
+        // length of every buffer
+        static inline uint16_t length[buffer_count] = {};
+
+        // flags if a buffer has data that still needs to be programmed
+        // (only used in background mode)
+        static inline volatile bool pending[buffer_count] = {};
 
-        // length of the current buffer
-        static inline uint16_t length = 0;
+        // buffer we receive the next block in and the buffer we
+        // program next (only used in background mode)
+        static inline uint8_t receive_index = 0;
+        static inline uint8_t program_index = 0;
+
+        // crc32 over all the programmed data
+        static inline uint32_t crc = 0;
+
+        // time it takes to program a block in milliseconds. Updated
+        // with the measured time in background mode
+        static inline uint32_t program_time = 0;
 
         // flag if we are done with the manifestation stage
         static inline bool manifestation_complete = false;
@@ -79,10 +126,8 @@ namespace klib::usb::device {
         };
 
         // configuration descriptor
-        __attribute__((aligned(4))) const static inline config_descriptor config = {
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
             {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x01,
                 .bConfigurationValue = 0x01,
                 .iConfiguration = 0x00,
                 .bmAttributes = 0xA0,
@@ -91,7 +136,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x00,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x00,
                 .bInterfaceClass = 0xfe,
                 .bInterfaceSubClass = 0x01,
                 .bInterfaceProtocol = 0x02, // 0x01 = runtime, 0x02 = boot mode
@@ -103,7 +147,7 @@ namespace klib::usb::device {
                 .wTransferSize = TransferSize,
                 // .bcdDFUVersion = 0x011a, // 0x011a for STM
             }
-        };
+        });
 
         // language descriptor for the dfu device
         const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
@@ -132,6 +176,129 @@ namespace klib::usb::device {
         // offset in the current download
         static inline uint32_t offset = 0;
 
+        /**
+         * @brief Write a buffer to the memory and add it to the crc
+         *
+         * @param index
+         * @return true
+         * @return false
+         */
+        static bool program(const uint32_t index) {
+            // write to the memory
+            if (!Memory::write(offset, buffer[index], length[index])) {
+                return false;
+            }
+
+            // update the crc of the image
+            crc = klib::crypt::crc32::calculate({buffer[index], length[index]}, crc);
+
+            // add the length to the offset
+            offset += length[index];
+
+            return true;
+        }
+
+        /**
+         * @brief Verify the image in the memory against the crc of
+         * the received data
+         *
+         * @return true
+         * @return false
+         */
+        static bool verify() {
+            // check if we can read back the memory
+            if constexpr (requires { Memory::read(offset, buffer[0], length[0]); }) {
+                uint32_t result = 0;
+
+                // calculate the crc over the memory in blocks
+                for (uint32_t i = 0; i < offset; i += TransferSize) {
+                    const uint32_t size = klib::min(TransferSize, offset - i);
+
+                    if (!Memory::read(i, buffer[0], size)) {
+                        return false;
+                    }
+
+                    result = klib::crypt::crc32::calculate({buffer[0], size}, result);
+                }
+
+                // check if the memory matches the received data
+                if (result != crc) {
+                    return false;
+                }
+            }
+
+            // let the memory check the image if it supports it
+            if constexpr (requires { Memory::verify(crc, offset); }) {
+                return Memory::verify(crc, offset);
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Manifest the new firmware after it is verified
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void manifest() {
+            // check the image before we continue
+            if (!verify()) {
+                current_status = klib::usb::dfu::device_status::verify_error;
+                current_state = klib::usb::dfu::device_state::error;
+
+                return;
+            }
+
+            // mark we are oke
+            current_status = klib::usb::dfu::device_status::ok;
+
+            // mark the manifest state as done
+            manifestation_complete = true;
+
+            // check if we are manifestation tolerant
+            if (!(config.functional.bmAttributes & (0x1 << 2))) {
+                // change the state to the sync
+                current_state = klib::usb::dfu::device_state::manifest_sync;
+            }
+            else {
+                // change to wait reset
+                current_state = klib::usb::dfu::device_state::manifest_wait_reset;
+
+                // disconnect the device
+                Usb::disconnect();
+
+                // reset the device
+                Memory::reset();
+            }
+        }
+
+        /**
+         * @brief Callback handler for the firmware data in background
+         * mode. Marks the buffer as ready to be programmed
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         */
+        template <typename Usb>
+        static void download_callback(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            // check if we are done with the transfer
+            if (error_code != usb::error::no_error) {
+                // do nothing
+                return;
+            }
+
+            // ack the endpoint
+            Usb::ack(endpoint, mode);
+
+            // mark the buffer ready for the process function and
+            // receive the next block in the other buffer
+            pending[receive_index] = true;
+            receive_index = (receive_index + 1) % buffer_count;
+        }
+
         /**
          * @brief Callback handler
          *
@@ -151,42 +318,26 @@ namespace klib::usb::device {
             // ack the endpoint
             Usb::ack(endpoint, mode);
 
+            // in background mode the process function programs the
+            // memory and does the manifestation
+            if constexpr (Background) {
+                return;
+            }
+
             // check if we have the data and are waiting to write to the flash
             if (current_state == klib::usb::dfu::device_state::download_busy) {
                 // write to the memory
-                if (!Memory::write(offset, buffer, length)) {
+                if (!program(0)) {
                     current_status = klib::usb::dfu::device_status::verify_error;
                 }
                 else {
                     // change the state to idle
                     current_state = klib::usb::dfu::device_state::download_idle;
-
-                    // add the length to the offset
-                    offset += length;
                 }
             }
             else if (current_state == klib::usb::dfu::device_state::manifset) {
-                // mark we are oke
-                current_status = klib::usb::dfu::device_status::ok;
-
-                // mark the manifest state as done
-                manifestation_complete = true;
-
-                // check if we are manifestation tolerant
-                if (!(config.functional.bmAttributes & (0x1 << 2))) {
-                    // change the state to the sync
-                    current_state = klib::usb::dfu::device_state::manifest_sync;
-                }
-                else {
-                    // change to wait reset
-                    current_state = klib::usb::dfu::device_state::manifest_wait_reset;
-
-                    // disconnect the device
-                    Usb::disconnect();
-
-                    // reset the device
-                    Memory::reset();
-                }
+                // verify and manifest the new firmware
+                manifest<Usb>();
             }
         }
 
@@ -203,6 +354,44 @@ namespace klib::usb::device {
             return static_cast<volatile uint8_t>(configuration) != 0;
         }
 
+        /**
+         * @brief Program the received blocks and do the manifestation.
+         * Needs to be called periodically from thread context when
+         * background mode is enabled
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void process() requires Background {
+            // program all the blocks we have received
+            while (pending[program_index]) {
+                // get the time before we start programming
+                const auto start = Timer::get_runtime();
+
+                // write to the memory
+                if (!program(program_index)) {
+                    current_status = klib::usb::dfu::device_status::verify_error;
+                    current_state = klib::usb::dfu::device_state::error;
+                }
+
+                // update the program time we report to the host. Round
+                // up to make sure the host does not poll too early
+                program_time = klib::max(
+                    program_time, (Timer::get_runtime() - start).value + 1
+                );
+
+                // release the buffer for the next block
+                pending[program_index] = false;
+                program_index = (program_index + 1) % buffer_count;
+            }
+
+            // check if we need to do the manifestation
+            if (current_state == klib::usb::dfu::device_state::manifset && !manifestation_complete) {
+                // verify and manifest the new firmware
+                manifest<Usb>();
+            }
+        }
+
     public:
         /**
          * @brief static functions needed for the usb stack. Should not
@@ -222,6 +411,9 @@ namespace klib::usb::device {
 
             // mark the manifestation as complete for now
             manifestation_complete = true;
+
+            // start with the program time of the memory
+            program_time = Memory::get_write_timeout();
         }
 
         /**
@@ -283,10 +475,26 @@ namespace klib::usb::device {
                     // check what we should do
                     switch (current_state) {
                         case klib::usb::dfu::device_state::download_sync:
-                            current_state = klib::usb::dfu::device_state::download_busy;
+                        case klib::usb::dfu::device_state::download_busy:
+                            if constexpr (Background) {
+                                // the block is received. Check if we have
+                                // a free buffer for the next block
+                                if (pending[receive_index]) {
+                                    current_state = klib::usb::dfu::device_state::download_busy;
+
+                                    // let the host wait until a buffer is programmed
+                                    timeout = program_time;
+                                }
+                                else {
+                                    current_state = klib::usb::dfu::device_state::download_idle;
+                                }
+                            }
+                            else if (current_state == klib::usb::dfu::device_state::download_sync) {
+                                current_state = klib::usb::dfu::device_state::download_busy;
 
-                            // set the timeout to the memory timeout
-                            timeout = Memory::get_write_timeout();
+                                // set the timeout to the memory timeout
+                                timeout = program_time;
+                            }
                             break;
                         case klib::usb::dfu::device_state::manifest_sync:
                             // check if we should change to idle or stay in manifest
@@ -297,6 +505,10 @@ namespace klib::usb::device {
                             else {
                                 current_state = klib::usb::dfu::device_state::manifset;
                                 // poll should call manifestion now
+
+                                // let the host wait for the remaining blocks
+                                // and the verification
+                                timeout = program_time;
                             }
                             break;
                         default:
@@ -348,6 +560,11 @@ namespace klib::usb::device {
                     // abort and change to idle
                     current_state = klib::usb::dfu::device_state::dfu_idle;
 
+                    // drop all the blocks we have not programmed yet
+                    for (auto& p : pending) {
+                        p = false;
+                    }
+
                     return usb::handshake::ack;
 
                 case klib::usb::dfu::dfu_request::download:
@@ -363,8 +580,12 @@ namespace klib::usb::device {
                         return usb::handshake::stall;
                     }
 
-                    // set the packet length
-                    length = packet.wLength;
+                    // check if the block fits in the buffer
+                    if (packet.wLength > TransferSize) {
+                        current_status = klib::usb::dfu::device_status::stall_error;
+
+                        return usb::handshake::stall;
+                    }
 
                     // check if we got a 0 length packet
                     if (packet.wLength == 0) {
@@ -385,17 +606,38 @@ namespace klib::usb::device {
                         }
                     }
 
-                    // we have a non 0 length packet. Read the data
-                    Usb::read(callback_handler<Usb>, klib::usb::usb::control_endpoint,
-                        usb::endpoint_mode::in, {buffer, length}
-                    );
-
                     // check if this is a new download
                     if (current_state == klib::usb::dfu::device_state::dfu_idle) {
                         // new download. Clear the offset and clear the manifestion progress
                         offset = 0;
+                        crc = 0;
 
                         manifestation_complete = false;
+
+                        // start with the first buffer
+                        receive_index = 0;
+                        program_index = 0;
+                    }
+
+                    // check if the buffer is still being programmed. The host
+                    // should wait until we report we are idle
+                    if (pending[receive_index]) {
+                        return usb::handshake::stall;
+                    }
+
+                    // set the packet length
+                    length[receive_index] = packet.wLength;
+
+                    // we have a non 0 length packet. Read the data
+                    if constexpr (Background) {
+                        Usb::read(download_callback<Usb>, klib::usb::usb::control_endpoint,
+                            usb::endpoint_mode::in, {buffer[receive_index], length[receive_index]}
+                        );
+                    }
+                    else {
+                        Usb::read(callback_handler<Usb>, klib::usb::usb::control_endpoint,
+                            usb::endpoint_mode::in, {buffer[receive_index], length[receive_index]}
+                        );
                     }
 
                     // change the state to sync
@@ -0,0 +1,570 @@
+#ifndef KLIB_USB_INSTRUMENTED_HPP
+#define KLIB_USB_INSTRUMENTED_HPP
+
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+#include <klib/io/systick.hpp>
+#include <klib/usb/usb/usb.hpp>
+#include <klib/usb/usb/device.hpp>
+
+namespace klib::usb::device::detail::instrumented {
+    // Push the current pack to the stack and set the pack to 1
+    // as the statistics are send to the host as is
+    #pragma pack(push, 1)
+
+    /**
+     * @brief Statistics of a single endpoint direction. All the
+     * counters are based on the completion of the transfers started
+     * by the device
+     *
+     */
+    struct endpoint_statistics {
+        // amount of bytes transferred by successful transfers
+        uint32_t bytes;
+
+        // amount of successful transfers
+        uint32_t transfers;
+
+        // amount of transfers that ended with a nak, stall, reset
+        // or that were canceled
+        uint32_t naks;
+        uint32_t stalls;
+        uint32_t resets;
+        uint32_t cancels;
+
+        // amount of transfers started after the previous transfer
+        // on the endpoint failed
+        uint32_t retries;
+
+        // amount of transfers the controller did not accept
+        uint32_t rejected;
+
+        // completion latency of the successful transfers in microseconds.
+        // The minimum is 0xffffffff when no transfers are done
+        uint32_t latency_min;
+        uint32_t latency_max;
+        uint64_t latency_total;
+
+        /**
+         * @brief Returns the average completion latency in microseconds
+         *
+         * @return uint32_t
+         */
+        constexpr uint32_t latency_avg() const {
+            return transfers ? static_cast<uint32_t>(latency_total / transfers) : 0;
+        }
+    };
+
+    // release the old pack so the rest of the structs are not
+    // affected by the pack(1)
+    #pragma pack(pop)
+
+    /**
+     * @brief State of a endpoint direction while a transfer is pending
+     *
+     */
+    struct endpoint_state {
+        // callback of the device for the pending transfer
+        klib::usb::usb::usb_callback callback;
+
+        // time the transfer was started in microseconds
+        uint32_t start;
+
+        // flag if the previous transfer failed
+        bool failed;
+    };
+}
+
+namespace klib::usb::device {
+    /**
+     * @brief Device wrapper that records per endpoint statistics of the
+     * wrapped device. The wrapped device gets a controller that forwards
+     * everything to the usb hardware and records the completion of every
+     * read and write. The statistics can be read using get() or by the
+     * host using a vendor request.
+     *
+     * @details the vendor request (device to host) returns the statistics
+     * of the endpoint address in wIndex. The same request from host to
+     * device clears all the statistics. Other vendor requests are
+     * forwarded to the wrapped device. When Enabled is false the wrapped
+     * device gets the hardware controller directly and no statistics are
+     * recorded.
+     *
+     * @warning the statistics are updated from the usb interrupt without
+     * locking. Reading them from thread context can give a mix of old and
+     * new values.
+     *
+     * @tparam Device
+     * @tparam Enabled
+     * @tparam Timer timer used to measure the completion latency
+     * @tparam Request vendor request to read/clear the statistics
+     * @tparam EndpointCount amount of endpoints we store statistics for
+     */
+    template <
+        typename Device, bool Enabled = true, typename Timer = klib::io::systick<>,
+        uint8_t Request = 0xee, uint8_t EndpointCount = 16
+    >
+    class instrumented {
+    public:
+        // type with the statistics of a endpoint
+        using endpoint_statistics = detail::instrumented::endpoint_statistics;
+
+        // make sure we have a valid endpoint count
+        static_assert(EndpointCount > 0 && EndpointCount <= 16, "invalid endpoint count");
+
+    protected:
+        // statistics and state of every endpoint. The out endpoint
+        // is at index 0 and the in endpoint at index 1
+        static inline endpoint_statistics statistics[EndpointCount][2] = {};
+        static inline detail::instrumented::endpoint_state state[EndpointCount][2] = {};
+
+        /**
+         * @brief Get the index of the mode in the statistics
+         *
+         * @param mode
+         * @return uint8_t
+         */
+        constexpr static uint8_t get_index(const usb::endpoint_mode mode) {
+            return mode == usb::endpoint_mode::in;
+        }
+
+        /**
+         * @brief Get the current time in microseconds
+         *
+         * @return uint32_t
+         */
+        static uint32_t now() {
+            return Timer::template get_runtime<time::us>().value;
+        }
+
+        /**
+         * @brief Controller passed to the wrapped device. Forwards
+         * everything to the usb hardware and records the transfers
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        class controller: public Usb {
+        protected:
+            /**
+             * @brief Store the callback and the start time of a transfer
+             *
+             * @param callback
+             * @param endpoint
+             * @param mode
+             */
+            static void start(const usb::usb_callback callback, const uint8_t endpoint, const usb::endpoint_mode mode) {
+                // ignore endpoints we do not have statistics for
+                if (endpoint >= EndpointCount) {
+                    return;
+                }
+
+                auto& s = state[endpoint][get_index(mode)];
+
+                // check if this is a retry of a failed transfer
+                if (s.failed) {
+                    statistics[endpoint][get_index(mode)].retries++;
+                }
+
+                s.callback = callback;
+                s.start = now();
+            }
+
+            /**
+             * @brief Record a transfer the controller did not accept
+             *
+             * @param endpoint
+             * @param mode
+             */
+            static void rejected(const uint8_t endpoint, const usb::endpoint_mode mode) {
+                if (endpoint >= EndpointCount) {
+                    return;
+                }
+
+                statistics[endpoint][get_index(mode)].rejected++;
+                state[endpoint][get_index(mode)].failed = true;
+            }
+
+            /**
+             * @brief Callback of every transfer. Records the result and
+             * calls the callback of the device
+             *
+             * @param endpoint
+             * @param mode
+             * @param error_code
+             * @param transferred
+             */
+            static void complete(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+                auto& s = state[endpoint][get_index(mode)];
+                auto& stats = statistics[endpoint][get_index(mode)];
+
+                // get the callback before calling it. The device can
+                // start a new transfer in the callback
+                const auto callback = s.callback;
+                s.callback = nullptr;
+                s.failed = (error_code != usb::error::no_error);
+
+                switch (error_code) {
+                    case usb::error::no_error: {
+                        const uint32_t latency = now() - s.start;
+
+                        stats.bytes += transferred;
+                        stats.transfers++;
+                        stats.latency_min = klib::min(stats.latency_min, latency);
+                        stats.latency_max = klib::max(stats.latency_max, latency);
+                        stats.latency_total += latency;
+                        break;
+                    }
+                    case usb::error::nak:
+                        stats.naks++;
+                        break;
+                    case usb::error::stall:
+                        stats.stalls++;
+                        break;
+                    case usb::error::reset:
+                        stats.resets++;
+                        break;
+                    case usb::error::cancel:
+                        stats.cancels++;
+                        break;
+                    default:
+                        break;
+                }
+
+                if (callback) {
+                    callback(endpoint, mode, error_code, transferred);
+                }
+            }
+
+            /**
+             * @brief Get the callback to pass to the hardware. Endpoints
+             * we do not have statistics for use the callback directly
+             *
+             * @param callback
+             * @param endpoint
+             * @return usb::usb_callback
+             */
+            static usb::usb_callback get_callback(const usb::usb_callback callback, const uint8_t endpoint) {
+                return (endpoint < EndpointCount) ? complete : callback;
+            }
+
+        public:
+            // the wrapped device is the device of this controller
+            using device = Device;
+
+            /**
+             * @brief Write data to an endpoint. Records the transfer
+             *
+             * @param callback
+             * @param endpoint
+             * @param mode
+             * @param data
+             * @return true
+             * @return false
+             */
+            static bool write(const usb::usb_callback callback, const uint8_t endpoint,
+                              const usb::endpoint_mode mode, const std::span<const uint8_t>& data)
+            {
+                start(callback, endpoint, mode);
+
+                if (Usb::write(get_callback(callback, endpoint), endpoint, mode, data)) {
+                    return true;
+                }
+
+                rejected(endpoint, mode);
+
+                return false;
+            }
+
+            /**
+             * @brief Read data from a endpoint. Records the transfer
+             *
+             * @param callback
+             * @param endpoint
+             * @param mode
+             * @param data
+             * @return true
+             * @return false
+             */
+            static bool read(const usb::usb_callback callback, const uint8_t endpoint,
+                             const usb::endpoint_mode mode, const std::span<uint8_t>& data)
+            {
+                start(callback, endpoint, mode);
+
+                if (Usb::read(get_callback(callback, endpoint), endpoint, mode, data)) {
+                    return true;
+                }
+
+                rejected(endpoint, mode);
+
+                return false;
+            }
+
+            /**
+             * @brief Read data from a endpoint with a min and max size.
+             * Records the transfer
+             *
+             * @param callback
+             * @param endpoint
+             * @param mode
+             * @param data
+             * @param min_size
+             * @param max_size
+             * @return true
+             * @return false
+             */
+            static bool read(const usb::usb_callback callback, const uint8_t endpoint,
+                             const usb::endpoint_mode mode, uint8_t *const data,
+                             const uint32_t min_size, const uint32_t max_size)
+            {
+                start(callback, endpoint, mode);
+
+                if (Usb::read(get_callback(callback, endpoint), endpoint, mode, data, min_size, max_size)) {
+                    return true;
+                }
+
+                rejected(endpoint, mode);
+
+                return false;
+            }
+        };
+
+        /**
+         * @brief Handle the statistics vendor request
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake statistics_request(const klib::usb::setup_packet &packet) {
+            // only allow the request on the device
+            if (usb::get_recipient(packet) != setup::recipient_code::device) {
+                return usb::handshake::stall;
+            }
+
+            // clear the statistics when the host sends the request
+            if (usb::get_direction(packet) == setup::direction::host_to_device) {
+                clear();
+
+                return usb::handshake::ack;
+            }
+
+            const uint8_t endpoint = usb::get_endpoint(packet.wIndex);
+
+            // check if we have statistics for the endpoint
+            if (endpoint >= EndpointCount) {
+                return usb::handshake::stall;
+            }
+
+            // copy the statistics so we do not send a mix of old and new
+            // data. Data needs to be static to make sure it is still
+            // allocated when the dma is sending it.
+            alignas(4) static endpoint_statistics response;
+            response = statistics[endpoint][get_index(usb::get_endpoint_mode(packet.wIndex))];
+
+            const uint32_t size = klib::min(sizeof(response), static_cast<uint32_t>(packet.wLength));
+
+            // send the statistics to the host
+            if (Usb::write(usb::status_callback<Usb>, usb::control_endpoint, usb::endpoint_mode::in,
+                {reinterpret_cast<const uint8_t*>(&response), size}))
+            {
+                // no errors return we need to wait on the callback
+                return usb::handshake::wait;
+            }
+
+            return usb::handshake::stall;
+        }
+
+    public:
+        /**
+         * @brief Controller type the wrapped device is called with. Calls
+         * from the application to the wrapped device should use this type
+         * so the transfers are recorded
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        using controller_type = std::conditional_t<Enabled, controller<Usb>, Usb>;
+
+        /**
+         * @brief Get the statistics of a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         * @return const endpoint_statistics&
+         */
+        static const endpoint_statistics& get(const uint8_t endpoint, const usb::endpoint_mode mode) {
+            return statistics[endpoint % EndpointCount][get_index(mode)];
+        }
+
+        /**
+         * @brief Clear the statistics of all the endpoints
+         *
+         */
+        static void clear() {
+            for (auto& endpoint : statistics) {
+                for (auto& s : endpoint) {
+                    s = {};
+                    s.latency_min = 0xffffffff;
+                }
+            }
+        }
+
+    public:
+        /**
+         * @brief static functions needed for the usb stack. Should not
+         * be called manually. Everything is forwarded to the wrapped
+         * device
+         *
+         */
+
+        template <typename Usb>
+        static void init() {
+            // clear the statistics and the state of every endpoint
+            if constexpr (Enabled) {
+                clear();
+
+                for (auto& endpoint : state) {
+                    for (auto& s : endpoint) {
+                        s = {};
+                    }
+                }
+            }
+
+            Device::template init<controller_type<Usb>>();
+        }
+
+        template <typename Usb>
+        static uint8_t get_configuration() {
+            return Device::template get_configuration<controller_type<Usb>>();
+        }
+
+        template <typename Usb>
+        static void wakeup() {
+            if constexpr (requires { Device::template wakeup<controller_type<Usb>>(); }) {
+                Device::template wakeup<controller_type<Usb>>();
+            }
+        }
+
+        template <typename Usb>
+        static void sleep() {
+            if constexpr (requires { Device::template sleep<controller_type<Usb>>(); }) {
+                Device::template sleep<controller_type<Usb>>();
+            }
+        }
+
+        template <typename Usb>
+        static void connected() {
+            if constexpr (requires { Device::template connected<controller_type<Usb>>(); }) {
+                Device::template connected<controller_type<Usb>>();
+            }
+        }
+
+        template <typename Usb>
+        static void disconnected() {
+            if constexpr (requires { Device::template disconnected<controller_type<Usb>>(); }) {
+                Device::template disconnected<controller_type<Usb>>();
+            }
+        }
+
+        template <typename Usb>
+        static void activity() {
+            if constexpr (requires { Device::template activity<controller_type<Usb>>(); }) {
+                Device::template activity<controller_type<Usb>>();
+            }
+        }
+
+        template <typename Usb>
+        static void bus_reset() {
+            if constexpr (requires { Device::template bus_reset<controller_type<Usb>>(); }) {
+                Device::template bus_reset<controller_type<Usb>>();
+            }
+        }
+
+        template <typename Usb>
+        static usb::handshake clear_feature(const klib::usb::setup::feature feature, const klib::usb::setup_packet &packet) {
+            return Device::template clear_feature<controller_type<Usb>>(feature, packet);
+        }
+
+        template <typename Usb>
+        static usb::handshake set_feature(const klib::usb::setup::feature feature, const klib::usb::setup_packet &packet) {
+            return Device::template set_feature<controller_type<Usb>>(feature, packet);
+        }
+
+        template <typename Usb>
+        static usb::description get_descriptor(const setup_packet &packet, descriptor::descriptor_type type, const uint8_t index) {
+            return Device::template get_descriptor<controller_type<Usb>>(packet, type, index);
+        }
+
+        template <typename Usb>
+        static usb::handshake get_config(const klib::usb::setup_packet &packet) {
+            return Device::template get_config<controller_type<Usb>>(packet);
+        }
+
+        template <typename Usb>
+        static usb::handshake set_config(const klib::usb::setup_packet &packet) {
+            return Device::template set_config<controller_type<Usb>>(packet);
+        }
+
+        template <typename Usb>
+        static usb::handshake get_interface(const klib::usb::setup_packet &packet) {
+            if constexpr (requires { Device::template get_interface<controller_type<Usb>>(packet); }) {
+                return Device::template get_interface<controller_type<Usb>>(packet);
+            }
+            else {
+                // the device does not support get interface
+                return usb::handshake::stall;
+            }
+        }
+
+        template <typename Usb>
+        static usb::handshake set_interface(const klib::usb::setup_packet &packet) {
+            if constexpr (requires { Device::template set_interface<controller_type<Usb>>(packet); }) {
+                return Device::template set_interface<controller_type<Usb>>(packet);
+            }
+            else {
+                // the device does not support set interface
+                return usb::handshake::stall;
+            }
+        }
+
+        template <typename Usb>
+        static usb::handshake handle_class_packet(const klib::usb::setup_packet &packet) {
+            if constexpr (requires { Device::template handle_class_packet<controller_type<Usb>>(packet); }) {
+                return Device::template handle_class_packet<controller_type<Usb>>(packet);
+            }
+            else {
+                // the device does not support class requests
+                return usb::handshake::stall;
+            }
+        }
+
+        template <typename Usb>
+        static usb::handshake handle_vendor_packet(const klib::usb::setup_packet &packet) {
+            // check if the host requests the statistics
+            if constexpr (Enabled) {
+                if (packet.bRequest == Request) {
+                    return statistics_request<Usb>(packet);
+                }
+            }
+
+            if constexpr (requires { Device::template handle_vendor_packet<controller_type<Usb>>(packet); }) {
+                return Device::template handle_vendor_packet<controller_type<Usb>>(packet);
+            }
+            else {
+                // the device does not support vendor requests
+                return usb::handshake::stall;
+            }
+        }
+
+        template <typename Usb>
+        static uint8_t get_device_status() {
+            return Device::template get_device_status<controller_type<Usb>>();
+        }
+    };
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define KLIB_USB_KEYBOARD_HPP
 
 #include <algorithm>
+#include <atomic>
 
 #include <klib/string.hpp>
 #include <klib/usb/usb/device.hpp>
@@ -9,7 +10,13 @@
 #include <klib/usb/usb/hid/descriptor.hpp>
 
 namespace klib::usb::device {
-    template <uint32_t Endpoint = 6>
+    /**
+     * @brief Hid keyboard with a consumer control (media keys)
+     *
+     * @tparam Endpoint
+     * @tparam QueueSize amount of reports that can be queued
+     */
+    template <uint32_t Endpoint = 6, uint32_t QueueSize = 16>
     class keyboard_hid {
     public:
         /**
@@ -274,6 +281,10 @@ namespace klib::usb::device {
             .bNumConfigurations = 0x1
         };
 
+        // amount of bytes in the key bitmap. Every key up to key_exsel
+        // has its own bit in the keycode report
+        constexpr static uint32_t key_bitmap_size = 21;
+
         // report descriptor for the hid keyboard. We need 2 report ids
         // so windows recognizes both the keyboard and consumer control
         const __attribute__((aligned(4))) static inline uint8_t report_desc[] = {
@@ -291,12 +302,12 @@ namespace klib::usb::device {
                 0x95, 0x08,        // Report Count (8)
                 0x81, 0x02,        // Input (Data, Variable, Absolute) ; Modifier byte
                 0x19, 0x00,        // Usage Minimum (0)
-                0x29, 0x65,        // Usage Maximum (101)
+                0x29, 0xa7,        // Usage Maximum (167)
                 0x15, 0x00,        // Logical Minimum (0)
-                0x25, 0x65,        // Logical Maximum (101)
-                0x75, 0x08,        // Report Size (8)
-                0x95, 0x01,        // Report Count (1)
-                0x81, 0x00,        // Input (Data, Array) ; Keycode byte
+                0x25, 0x01,        // Logical Maximum (1)
+                0x75, 0x01,        // Report Size (1)
+                0x95, 0xa8,        // Report Count (168)
+                0x81, 0x02,        // Input (Data, Variable, Absolute) ; Key bitmap
             0xc0,              // End Collection
 
             // Consumer Control report (Report ID 2)
@@ -315,10 +326,8 @@ namespace klib::usb::device {
         };
 
         // configuration descriptor
-        const __attribute__((aligned(4))) static inline config_descriptor config = {
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
             {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x01,
                 .bConfigurationValue = 0x01,
                 .iConfiguration = 0x00,
                 .bmAttributes = 0xA0,
@@ -327,7 +336,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x00,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = 0x03,
                 .bInterfaceSubClass = 0x00,
                 .bInterfaceProtocol = 0x00,
@@ -347,7 +355,7 @@ namespace klib::usb::device {
                 .wMaxPacketSize = 0x0040,
                 .bInterval = 0x01
             }
-        };
+        });
 
         // language descriptor for the keyboard
         const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
@@ -374,31 +382,33 @@ namespace klib::usb::device {
         #pragma pack(push, 1)
 
         /**
-         * @brief Struct that represents the keycode report 
-         * we send to the host. This is defined in the report 
-         * descriptor (report_id::keycode)
-         * 
+         * @brief Struct that represents the keycode report
+         * we send to the host. This is defined in the report
+         * descriptor (report_id::keycode). Every key has its
+         * own bit so any amount of keys can be pressed at the
+         * same time (n-key rollover)
+         *
          */
         struct keycode_report_t {
             // fixed report id for the keycode
-            const report_id id = report_id::keycode;
+            report_id id = report_id::keycode;
 
             // key data
             uint8_t modifier;
-            key_t key;
+            uint8_t keys[key_bitmap_size];
         };
 
-        static_assert(sizeof(keycode_report_t) == 3, "invalid keycode report size");
+        static_assert(sizeof(keycode_report_t) == (2 + key_bitmap_size), "invalid keycode report size");
 
         /**
-         * @brief Struct that represents the consumer control 
-         * report we send to the host. This is defined in the 
+         * @brief Struct that represents the consumer control
+         * report we send to the host. This is defined in the
          * report descriptor (report_id::consumer)
-         * 
+         *
          */
         struct consumer_report_t {
             // fixed report id for the consumer control
-            const report_id id = report_id::consumer;
+            report_id id = report_id::consumer;
 
             // key data
             consumer_key_t key;
@@ -410,142 +420,141 @@ namespace klib::usb::device {
         // affected by the pack(1)
         #pragma pack(pop)
 
-        // storage for the reports when we are sending them
-        static inline keycode_report_t keycode_report = {};
-        static inline consumer_report_t consumer_report = {};
+        // current state of the keys changed with press and release
+        static inline keycode_report_t key_state = {};
 
-        // static parameters with data to write to the host
-        static inline const char *volatile irq_data = nullptr;
-        static inline volatile uint32_t irq_size = 0;
-        static inline bool repeated_key = false;
+        // queue with the reports to send to the host. The write index is
+        // only changed by the user and the read index only in the endpoint
+        // callback. The report at the read index is being transmitted
+        __attribute__((aligned(4))) static inline uint8_t report_queue[QueueSize][sizeof(keycode_report_t)] = {};
+        static inline uint8_t report_size[QueueSize] = {};
+        static inline std::atomic<uint32_t> queue_write = 0;
+        static inline std::atomic<uint32_t> queue_read = 0;
 
-        /**
-         * @brief Callbakc that will clear the consumer report after it has been sent
-         * 
-         * @tparam Usb 
-         * @param endpoint 
-         * @param mode 
-         * @param error_code 
-         * @param transferred 
-         */
-        template <typename Usb>
-        static void hid_callback_consumer(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
-            // only continue if we do not have any errors
-            if (error_code != usb::error::no_error) {
-                // we have a error
-                return;
-            }
+        // flag if we are transmitting reports from the queue
+        static inline std::atomic<bool> transmitting = false;
 
-            // check if we are configured
-            if (!configuration) {
-                return;
-            }
+        template <typename Usb>
+        static void transmit_next() {
+            while (true) {
+                // check if we have anything left in the queue
+                if (queue_read.load() == queue_write.load()) {
+                    transmitting = false;
+
+                    // make sure nothing was queued after the check above
+                    if (queue_read.load() == queue_write.load() || transmitting.exchange(true)) {
+                        return;
+                    }
+                }
 
-            // we have send a report. Send a new report that clears the key
-            consumer_report.key = consumer_key_t::key_none;
+                const uint32_t index = queue_read.load() % QueueSize;
 
-            // send the no key pressed to the host
-            Usb::write(
-                nullptr, usb::get_endpoint(config.endpoint.bEndpointAddress),
-                mode, {reinterpret_cast<const uint8_t*>(&consumer_report), sizeof(consumer_report)}
-            );
+                // send the report directly from the queue
+                if (Usb::write(
+                    hid_callback<Usb>, usb::get_endpoint(config.endpoint.bEndpointAddress),
+                    usb::get_endpoint_mode(config.endpoint.bEndpointAddress),
+                    {report_queue[index], report_size[index]}))
+                {
+                    return;
+                }
 
-            // we have nothing more to send. Clear the data to notify we are done with the string
-            irq_data = nullptr;
-            irq_size = 0;
+                // could not send the report, drop it
+                queue_read++;
+            }
         }
 
         /**
-         * @brief Callback that can send more keypresses or will send no keys
-         * 
-         * @tparam Usb 
-         * @param endpoint 
-         * @param mode 
-         * @param error_code 
-         * @param transferred 
+         * @brief Callback that sends the next report in the queue
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         * @param transferred
          */
         template <typename Usb>
-        static void hid_callback_keycode(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+        static void hid_callback(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
             // only continue if we do not have any errors
-            if (error_code != usb::error::no_error) {
-                // we have a error
-                return;
-            }
+            if (error_code != usb::error::no_error || !configuration) {
+                // we have a error. Drop everything in the queue
+                clear_queue();
 
-            // check if we are configured
-            if (!configuration) {
                 return;
             }
 
-            // check if we still have a valid pointer and no data left to send
-            if ((!irq_size) && (irq_data != nullptr)) {
-                // we have nothing more to send. Send a empty report
-                // with no keypresses
-                keycode_report.modifier = 0x00;
-                keycode_report.key = key_t::key_none;
-
-                // send the no key pressed to the host
-                Usb::write(
-                    hid_callback_keycode<Usb>, usb::get_endpoint(config.endpoint.bEndpointAddress),
-                    mode, {reinterpret_cast<const uint8_t*>(&keycode_report), sizeof(keycode_report)}
-                );
+            // the report at the read index is done
+            queue_read++;
 
-                // clear the data to notify we are done with the string
-                irq_data = nullptr;
+            // send the next report
+            transmit_next<Usb>();
+        }
 
-                // exit the callback
-                return;
-            }
+        static void clear_queue() {
+            queue_read = queue_write.load();
+            transmitting = false;
+        }
 
-            // do not continue if we do not have any valid data or
-            // if we do not have any size left to send
-            if ((irq_data == nullptr) || (!irq_size)) {
-                // exit as we do not have anything left to send
-                return;
+        /**
+         * @brief Returns the amount of free entries in the queue
+         *
+         * @return uint32_t
+         */
+        static uint32_t queue_free() {
+            return QueueSize - (queue_write.load() - queue_read.load());
+        }
+
+        template <typename Usb, typename T>
+        static bool push(const T& report) {
+            // check if we are configured and have space left
+            if (!configuration || !queue_free()) {
+                return false;
             }
 
-            // check if the next character is the same as the last send character
-            if (irq_size > 0 && irq_data[0] == irq_data[1] && repeated_key == false) {
-                // we have detected a double character. Send a no keys
-                // pressed in between
-                keycode_report.modifier = 0x00;
-                keycode_report.key = key_t::key_none;
-
-                // send the report to the host
-                Usb::write(
-                    hid_callback_keycode<Usb>, usb::get_endpoint(config.endpoint.bEndpointAddress),
-                    mode, {reinterpret_cast<const uint8_t*>(&keycode_report), sizeof(keycode_report)}
-                );
+            const uint32_t index = queue_write.load() % QueueSize;
 
-                // mark we have send a no keys between two repeated keys
-                repeated_key = true;
+            // copy the report into the queue
+            std::copy_n(reinterpret_cast<const uint8_t*>(&report), sizeof(report), report_queue[index]);
+            report_size[index] = sizeof(report);
 
-                // exit for now
-                return;
+            queue_write++;
+
+            // start transmitting if we are not busy
+            if (!transmitting.exchange(true)) {
+                transmit_next<Usb>();
             }
 
-            // we still have data to send. Decrease the size and move
-            // the pointer
-            irq_size--;
-            irq_data++;
+            return true;
+        }
 
-            // encode the next character
-            encode_report(irq_data[0], keycode_report);
+        template <typename Usb, bool Async>
+        static void wait_if_blocking() {
+            // wait until all the reports are sent when not in async mode
+            if constexpr (!Async) {
+                while (is_busy<Usb>()) {
+                    // do nothing
+                }
+            }
+        }
 
-            // clear we have transmitted a no keys in between two repeated keys
-            repeated_key = false;
+        static void set_key(keycode_report_t& report, const key_t key, const bool pressed) {
+            const uint8_t k = static_cast<uint8_t>(key);
 
-            // send the report to the host
-            Usb::write(
-                hid_callback_keycode<Usb>, usb::get_endpoint(config.endpoint.bEndpointAddress),
-                mode, {reinterpret_cast<const uint8_t*>(&keycode_report), sizeof(keycode_report)}
-            );
+            // get the byte and the bit mask for the key. Modifiers
+            // are stored in the modifier byte
+            uint8_t& data = (key >= key_t::key_control_left) ?
+                report.modifier : report.keys[k / 8];
+            const uint8_t mask = (key >= key_t::key_control_left) ?
+                (1 << (k - static_cast<uint8_t>(key_t::key_control_left))) : (1 << (k % 8));
 
-            // return we are done
-            return;
+            if (pressed) {
+                data |= mask;
+            }
+            else {
+                data &= ~mask;
+            }
         }
 
-        static void encode_report(const char ch, keycode_report_t& report) {
+        static void encode_report(const char ch, uint8_t& modifier, key_t& key) {
             // check what data we have
             if (klib::string::is_character(ch)) {
                 // offset between the character (in the ascii table) and in the
@@ -554,12 +563,12 @@ namespace klib::usb::device {
 
                 // we have a character. re-align to hid codes
                 if (klib::string::is_upper(ch)) {
-                    report.modifier = 0x02;
-                    report.key = static_cast<key_t>(ch - offset);
+                    modifier = 0x02;
+                    key = static_cast<key_t>(ch - offset);
                 }
                 else {
-                    report.modifier = 0x00;
-                    report.key = static_cast<key_t>(klib::string::to_upper(ch) - offset);
+                    modifier = 0x00;
+                    key = static_cast<key_t>(klib::string::to_upper(ch) - offset);
                 }
 
                 return;
@@ -567,14 +576,14 @@ namespace klib::usb::device {
 
             if (klib::string::is_digit(ch)) {
                 // set the first two bytes of the report
-                report.modifier = 0x00;
+                modifier = 0x00;
 
                 // we have a number
                 if (ch == '0') {
-                    report.key = key_t::key_0;
+                    key = key_t::key_0;
                 }
                 else {
-                    report.key = static_cast<key_t>(ch - (static_cast<uint8_t>(key_t::key_1) - '1'));
+                    key = static_cast<key_t>(ch - ('1' - static_cast<uint8_t>(key_t::key_1)));
                 }
 
                 return;
@@ -607,12 +616,14 @@ namespace klib::usb::device {
                     break;
                 case '.':
                     code = key_t::key_period;
+                    break;
                 case '!':
                     shift = 0x02;
 
                     // shift and key_1 == !, use a static cast
                     // to signal this is not key_1
                     code = static_cast<key_t>(0x1e);
+                    break;
                 default:
                     // all others are mapped to a question mark
                     shift = 0x02;
@@ -624,118 +635,151 @@ namespace klib::usb::device {
             }
 
             // set the code and the shift
-            report.modifier = shift;
-            report.key = code;
+            modifier = shift;
+            key = code;
         }
 
-        template <typename Usb>
-        static bool is_invalid_or_busy() {
-            // check if we are configured
-            if (!configuration) {
-                return true;
-            }
+    public:
+        /**
+         * @brief Type a string. The keys are queued and sent from the
+         * endpoint callback. Every character is sent in a single report,
+         * the release of the previous key is combined with the press of
+         * the next key. Only repeated characters need a release report
+         * in between
+         *
+         * @details the string is encoded into the queue so the data does
+         * not need to be valid after this call. Releases all the keys
+         * pressed with press()
+         *
+         * @tparam Usb
+         * @tparam Async when false waits until all the reports are sent
+         * @param data
+         * @param size
+         * @return uint32_t amount of characters queued. Can be less than
+         * size when the queue is full
+         */
+        template <typename Usb, bool Async = false>
+        static uint32_t write(const char *const data, const uint32_t size) {
+            uint32_t count = 0;
 
-            // check if a request is already pending
-            if (is_busy<Usb>()) {
-                // a other request is already pending exit
-                return true;
-            }
+            // encode the characters into the queue. Always keep space for
+            // a release report after the character
+            for (; count < size && queue_free() >= 2; count++) {
+                keycode_report_t report = {};
+                key_t key;
 
-            // return we are not busy and we do not have a 
-            // invalid configuration
-            return false;
-        }
+                encode_report(data[count], report.modifier, key);
+                set_key(report, key, true);
 
-        template <typename Usb, bool Async = false, bool Keycode = true, typename T = keycode_report_t>
-        static bool write_impl(const T& r) {
-            // write the first report to the endpoint
-            if (!Usb::write(Keycode ? hid_callback_keycode<Usb> : hid_callback_consumer<Usb>, usb::get_endpoint(config.endpoint.bEndpointAddress),
-                usb::get_endpoint_mode(config.endpoint.bEndpointAddress), {reinterpret_cast<const uint8_t*>(&r), sizeof(r)}))
-            {
-                return false;
-            }
+                if (!push<Usb>(report)) {
+                    break;
+                }
 
-            // check if we should exit
-            if constexpr (Async) {
-                return true;
+                // release the key when the next character is the same or
+                // when this is the last character we can send
+                if ((count + 1) >= size || data[count] == data[count + 1] || queue_free() < 3) {
+                    push<Usb>(keycode_report_t{});
+                }
             }
 
-            // wait until we are done transmitting all characters
-            while (is_busy<Usb>()) {
-                // do nothing
-            }
+            // the string released all the keys
+            key_state = {};
 
-            return true;
+            wait_if_blocking<Usb, Async>();
+
+            return count;
         }
 
-    public:
+        /**
+         * @brief Press and release a single key
+         *
+         * @tparam Usb
+         * @tparam Async when false waits until all the reports are sent
+         * @param key
+         * @return true when the key is queued
+         */
         template <typename Usb, bool Async = false>
-        static bool write(const char *const data, const uint32_t size) {
-            // check if we have a valid size
-            if (size == 0) {
-                // return we are done. Nothing to do here
-                return true;
-            }
-
-            // check if we are busy or not
-            if (is_invalid_or_busy<Usb>()) {
+        static bool write(const key_t key) {
+            // we need space for the press and the release
+            if (queue_free() < 2) {
                 return false;
             }
 
-            // encode the first report
-            encode_report(data[0], keycode_report);
+            // press the key on top of the current state
+            keycode_report_t report = key_state;
+            set_key(report, key, true);
 
-            // set the data in the interrupt
-            irq_size = size - 1;
-            irq_data = data;
+            push<Usb>(report);
+            push<Usb>(key_state);
 
-            // write the data
-            return write_impl<Usb, Async, true>(keycode_report);
+            wait_if_blocking<Usb, Async>();
+
+            return true;
         }
 
+        /**
+         * @brief Press and release a consumer control key
+         *
+         * @tparam Usb
+         * @tparam Async when false waits until all the reports are sent
+         * @param key
+         * @return true when the key is queued
+         */
         template <typename Usb, bool Async = false>
-        static bool write(const key_t key) {
-            // static dummy data for the interrupt handler
-            // to signal if we are still busy
-            static char dummy;
-
-            // check if we are busy or not
-            if (is_invalid_or_busy<Usb>()) {
+        static bool write(const consumer_key_t key) {
+            // we need space for the press and the release
+            if (queue_free() < 2) {
                 return false;
             }
 
-            // set the report
-            keycode_report.modifier = 0x00;
-            keycode_report.key = key;
+            push<Usb>(consumer_report_t{.key = key});
+            push<Usb>(consumer_report_t{.key = consumer_key_t::key_none});
 
-            // set the data in the interrupt
-            irq_size = 0;
-            irq_data = &dummy;
+            wait_if_blocking<Usb, Async>();
 
-            // write the data
-            return write_impl<Usb, Async, true>(keycode_report);
+            return true;
         }
 
-        template <typename Usb, bool Async = false>
-        static bool write(const consumer_key_t key) {
-            // static dummy data for the interrupt handler
-            // to signal if we are still busy
-            static char dummy;
+        /**
+         * @brief Press a key. The key stays pressed until it is released.
+         * Multiple keys can be pressed at the same time
+         *
+         * @tparam Usb
+         * @param key
+         * @return true when the new state is queued
+         */
+        template <typename Usb>
+        static bool press(const key_t key) {
+            keycode_report_t report = key_state;
+            set_key(report, key, true);
 
-            // check if we are busy or not
-            if (is_invalid_or_busy<Usb>()) {
-                return false;
-            }
+            return update<Usb>(report);
+        }
 
-            // set the report
-            consumer_report.key = key;
+        /**
+         * @brief Release a pressed key
+         *
+         * @tparam Usb
+         * @param key
+         * @return true when the new state is queued
+         */
+        template <typename Usb>
+        static bool release(const key_t key) {
+            keycode_report_t report = key_state;
+            set_key(report, key, false);
 
-            // set the data in the interrupt
-            irq_size = 0;
-            irq_data = &dummy;
+            return update<Usb>(report);
+        }
 
-            // write the data
-            return write_impl<Usb, Async, false>(consumer_report);
+        /**
+         * @brief Release all the pressed keys
+         *
+         * @tparam Usb
+         * @return true when the new state is queued
+         */
+        template <typename Usb>
+        static bool release_all() {
+            return update<Usb>(keycode_report_t{});
         }
 
         /**
@@ -747,13 +791,32 @@ namespace klib::usb::device {
          */
         template <typename Usb>
         static bool is_busy() {
-            // return if the endpoint is still pending
-            return irq_data != nullptr || Usb::is_pending(
-                usb::get_endpoint(config.endpoint.bEndpointAddress), 
-                usb::get_endpoint_mode(config.endpoint.bEndpointAddress)
-            );
+            // return if we still have reports to send
+            return transmitting || (queue_write.load() != queue_read.load());
         }
 
+    protected:
+        template <typename Usb>
+        static bool update(const keycode_report_t& report) {
+            // do not queue a report when nothing changed
+            if (std::equal(
+                reinterpret_cast<const uint8_t*>(&report), reinterpret_cast<const uint8_t*>(&report) + sizeof(report),
+                reinterpret_cast<const uint8_t*>(&key_state)))
+            {
+                return true;
+            }
+
+            // only update the state when the host will see it
+            if (!push<Usb>(report)) {
+                return false;
+            }
+
+            key_state = report;
+
+            return true;
+        }
+
+    public:
         /**
          * @brief Returns if the device is configured
          *
@@ -783,16 +846,11 @@ namespace klib::usb::device {
             // init all the variables to default
             remote_wakeup = false;
 
-            // clear the strings we are sending
-            irq_data = nullptr;
-            irq_size = 0;
+            // clear the reports we are sending
+            clear_queue();
 
-            // make sure the endpoint supports interrupt
-            // endpoints
-            static_assert(Usb::template is_valid_endpoint<
-                Endpoint,
-                klib::usb::descriptor::transfer_type::interrupt
-            >(), "invalid interrupt endpoint selected");
+            // make sure all the endpoints in the configuration are supported
+            static_assert(descriptor::valid_endpoints<Usb, config>(), "invalid endpoint selected");
         }
 
         /**
@@ -815,6 +873,9 @@ namespace klib::usb::device {
         template <typename Usb>
         static void disconnected() {
             configuration = 0x00;
+
+            // drop all the queued reports
+            clear_queue();
         }
 
         /**
@@ -826,6 +887,9 @@ namespace klib::usb::device {
         static void bus_reset() {
             // clear all the variables to default
             configuration = 0x00;
+
+            // drop all the queued reports
+            clear_queue();
         }
 
         /**
@@ -975,7 +1039,7 @@ namespace klib::usb::device {
                     usb::get_endpoint(config.endpoint.bEndpointAddress),
                     usb::get_endpoint_mode(config.endpoint.bEndpointAddress),
                     usb::get_transfer_type(config.endpoint.bmAttributes),
-                    klib::max(sizeof(keycode_report), sizeof(consumer_report))
+                    klib::max(sizeof(keycode_report_t), sizeof(consumer_report_t))
                 );
 
                 // store the configuration value
@@ -984,16 +1048,12 @@ namespace klib::usb::device {
                 // notify the usb driver we are configured
                 Usb::configured(true);
 
-                // prepare a inital report with no keys pressed
-                keycode_report.modifier = 0x00;
-                keycode_report.key = key_t::key_none;
+                // clear the queue and the key state
+                clear_queue();
+                key_state = {};
 
-                // write the inital report
-                if (Usb::write(
-                    hid_callback_keycode<Usb>, usb::get_endpoint(config.endpoint.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint.bEndpointAddress), 
-                    {reinterpret_cast<const uint8_t*>(&keycode_report), sizeof(keycode_report)}))
-                {
+                // write the inital report with no keys pressed
+                if (push<Usb>(key_state)) {
                     // no issue for now ack
                     return usb::handshake::ack;
                 }
@@ -1060,13 +1120,9 @@ namespace klib::usb::device {
             switch (request) {
                 case hid::class_request::get_report:
                     // the host should not use this as a substitute for the Interrupt EP
-                    // we simply send a "no keys" report to the host
-                    keycode_report.modifier = 0x00;
-                    keycode_report.key = key_t::key_none;
-
-                    // write the data to the control endpoint
+                    // we simply send the current key state to the host
                     if (Usb::write(nullptr, usb::control_endpoint,
-                        usb::endpoint_mode::in, {reinterpret_cast<const uint8_t*>(&keycode_report), sizeof(keycode_report)}))
+                        usb::endpoint_mode::in, {reinterpret_cast<const uint8_t*>(&key_state), sizeof(key_state)}))
                     {
                         // no issue for now ack
                         return usb::handshake::ack;
@@ -1081,7 +1137,7 @@ namespace klib::usb::device {
                         case report_id::keycode:
                             // write the data to the control endpoint
                             if (Usb::write(nullptr, usb::control_endpoint, usb::endpoint_mode::in,
-                                {reinterpret_cast<const uint8_t*>(&keycode_report), sizeof(keycode_report)}))
+                                {reinterpret_cast<const uint8_t*>(&key_state), sizeof(key_state)}))
                             {
                                 // no issue for now ack
                                 return usb::handshake::ack;
@@ -1091,7 +1147,10 @@ namespace klib::usb::device {
                                 return usb::handshake::stall;
                             }
                             break;
-                        case report_id::consumer:
+                        case report_id::consumer: {
+                            // consumer keys are always released after a press
+                            const static consumer_report_t consumer_report = {};
+
                             // write the data to the control endpoint
                             if (Usb::write(nullptr, usb::control_endpoint, usb::endpoint_mode::in,
                                 {reinterpret_cast<const uint8_t*>(&consumer_report), sizeof(consumer_report)}))
@@ -1104,6 +1163,7 @@ namespace klib::usb::device {
                                 return usb::handshake::stall;
                             }
                             break;
+                        }
                         default:
                             // not supported for now
                             return usb::handshake::stall;
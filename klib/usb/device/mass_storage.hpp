@@ -7,8 +7,24 @@
 #include <klib/usb/usb/msc/bulk_only_transfer.hpp>
 
 namespace klib::usb::device {
-    template <typename Memory, uint8_t InEndpoint = 0x02, uint8_t OutEndpoint = 0x05>
+    template <typename Memory, uint8_t InEndpoint = 0x02, uint8_t OutEndpoint = 0x05, uint8_t Interface = 0>
     class mass_storage {
+    public:
+        // amount of interfaces and endpoints used by the mass storage device
+        constexpr static uint8_t interface_count = 1;
+        constexpr static uint8_t endpoint_count = 2;
+
+        /**
+         * @brief Mass storage function for a composite device. Uses
+         * the endpoints starting at Endpoint for the in and out
+         * endpoint
+         *
+         * @tparam FirstInterface
+         * @tparam Endpoint
+         */
+        template <uint8_t FirstInterface, uint8_t Endpoint>
+        using function = mass_storage<Memory, Endpoint, Endpoint + 1, FirstInterface>;
+
     protected:
         // mass storage bot handler (set the in endpoint bit)
         using bot = msc::bot::handler<Memory, (0x80 | InEndpoint), OutEndpoint>;
@@ -29,16 +45,10 @@ namespace klib::usb::device {
         #pragma pack(push, 1)
 
         /**
-         * @brief Config descriptor for the mass storage device
-         *
-         * @details packed so we can write this whole descriptor
-         * to the usb hardware in one go.
+         * @brief Interface descriptors for the mass storage device
          *
          */
-        struct config_descriptor {
-            // configuration descriptor
-            descriptor::configuration configuration;
-
+        struct interface_descriptor {
             // interface descriptor
             descriptor::interface interface;
 
@@ -49,6 +59,21 @@ namespace klib::usb::device {
             descriptor::endpoint endpoint1;
         };
 
+        /**
+         * @brief Config descriptor for the mass storage device
+         *
+         * @details packed so we can write this whole descriptor
+         * to the usb hardware in one go.
+         *
+         */
+        struct config_descriptor {
+            // configuration descriptor
+            descriptor::configuration configuration;
+
+            // all the interfaces of the mass storage device
+            interface_descriptor interfaces;
+        };
+
         // release the old pack so the rest of the structs are not
         // affected by the pack(1)
         #pragma pack(pop)
@@ -69,20 +94,23 @@ namespace klib::usb::device {
             .bNumConfigurations = 0x1
         };
 
-        // configuration descriptor
-        const __attribute__((aligned(4))) static inline config_descriptor config = {
-            {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x01,
-                .bConfigurationValue = 0x01,
-                .iConfiguration = 0x04,
-                .bmAttributes = 0x80,
-                .bMaxPower = 0x32,
-            },
+    public:
+        // interface association for when the device is used in a
+        // composite device
+        constexpr static descriptor::interface_association association = {
+            .bFirstInterface = Interface,
+            .bInterfaceCount = interface_count,
+            .bFunctionClass = 0x08,
+            .bFunctionSubClass = 0x06,
+            .bFunctionProtocol = 0x50,
+            .iFunction = 0x00
+        };
+
+        // interface descriptors of the mass storage device
+        constexpr static interface_descriptor interfaces = {
             {
-                .bInterfaceNumber = 0x00,
+                .bInterfaceNumber = Interface,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x02,
                 .bInterfaceClass = 0x08,
                 .bInterfaceSubClass = 0x06,
                 .bInterfaceProtocol = 0x50,
@@ -102,6 +130,21 @@ namespace klib::usb::device {
             }
         };
 
+    protected:
+        // configuration value of the standalone device
+        constexpr static uint8_t configuration_value = 0x01;
+
+        // configuration descriptor
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
+            {
+                .bConfigurationValue = configuration_value,
+                .iConfiguration = 0x04,
+                .bmAttributes = 0x80,
+                .bMaxPower = 0x32,
+            },
+            interfaces
+        });
+
         // device qualifier
         const __attribute__((aligned(4))) static inline descriptor::qualifier qualifier = {
             .bcdUSB = setup::usb_version::usb_v2_0,
@@ -273,16 +316,8 @@ namespace klib::usb::device {
             // init all the variables to default
             configuration = 0x00;
 
-            // make sure the endpoints support the bulk endpoint type
-            static_assert(Usb::template is_valid_endpoint<
-                usb::get_endpoint(InEndpoint),
-                klib::usb::descriptor::transfer_type::bulk
-            >(), "invalid bulk endpoint selected");
-
-            static_assert(Usb::template is_valid_endpoint<
-                usb::get_endpoint(OutEndpoint),
-                klib::usb::descriptor::transfer_type::bulk
-            >(), "invalid bulk endpoint selected");
+            // make sure all the endpoints of the function are supported
+            static_assert(descriptor::valid_endpoints<Usb, interfaces>(), "invalid endpoint selected");
         }
 
         /**
@@ -405,29 +440,13 @@ namespace klib::usb::device {
         static usb::handshake set_config(const klib::usb::setup_packet &packet) {
             // check if the set is the same as the configuration we have stored
             if (packet.wValue == config.configuration.bConfigurationValue) {
-                // configure the endpoints
-                Usb::configure(
-                    usb::get_endpoint(config.endpoint0.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint0.bEndpointAddress),
-                    usb::get_transfer_type(config.endpoint0.bmAttributes),
-                    config.endpoint0.wMaxPacketSize
-                );
-                Usb::configure(
-                    usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint1.bEndpointAddress),
-                    usb::get_transfer_type(config.endpoint1.bmAttributes),
-                    config.endpoint1.wMaxPacketSize
-                );
-
-                // store the configuration value
-                configuration = packet.wValue;
+                // configure the endpoints and init the bulk only
+                // transfer driver
+                configure<Usb>();
 
                 // notify the usb driver we are configured
                 Usb::configured(true);
 
-                // init the bulk only transfer driver
-                bot::template init<Usb>();
-
                 // return everything is oke
                 return usb::handshake::ack;
             }
@@ -435,26 +454,8 @@ namespace klib::usb::device {
                 // notify the usb driver we are not configured anymore
                 Usb::configured(false);
 
-                // check if we were configured already
-                if (configuration) {
-                    // reset the endpoint
-                    Usb::reset(
-                        usb::get_endpoint(config.endpoint0.bEndpointAddress),
-                        usb::get_endpoint_mode(config.endpoint0.bEndpointAddress)
-                    );
-
-                    // reset the endpoint
-                    Usb::reset(
-                        usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                        usb::get_endpoint_mode(config.endpoint1.bEndpointAddress)
-                    );
-                }
-
-                // clear the configuration value
-                configuration = 0x00;
-
-                // de-init the bulk only transfer driver
-                bot::template de_init<Usb>();
+                // reset the endpoints and stop the bulk only transfer driver
+                deconfigure<Usb>();
 
                 // ack the packet
                 return usb::handshake::ack;
@@ -465,6 +466,66 @@ namespace klib::usb::device {
             }
         }
 
+        /**
+         * @brief Configure the endpoints and init the bulk only
+         * transfer driver. Called from set config or by a composite
+         * device
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void configure() {
+            // configure the endpoints
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint0.bmAttributes),
+                interfaces.endpoint0.wMaxPacketSize
+            );
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint1.bmAttributes),
+                interfaces.endpoint1.wMaxPacketSize
+            );
+
+            // store the configuration value
+            configuration = configuration_value;
+
+            // init the bulk only transfer driver
+            bot::template init<Usb>();
+        }
+
+        /**
+         * @brief Reset the endpoints and stop the bulk only transfer
+         * driver. Called from set config or by a composite device
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void deconfigure() {
+            // check if we were configured already
+            if (configuration) {
+                // reset the endpoint
+                Usb::reset(
+                    usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress)
+                );
+
+                // reset the endpoint
+                Usb::reset(
+                    usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress)
+                );
+            }
+
+            // clear the configuration value
+            configuration = 0x00;
+
+            // de-init the bulk only transfer driver
+            bot::template de_init<Usb>();
+        }
+
         /**
          * @brief Get the device status. Called when the status is requested
          *
@@ -2,6 +2,7 @@
 #define KLIB_USB_MOUSE_HPP
 
 #include <algorithm>
+#include <atomic>
 
 #include <klib/string.hpp>
 #include <klib/usb/usb/device.hpp>
@@ -9,7 +10,13 @@
 #include <klib/usb/usb/hid/descriptor.hpp>
 
 namespace klib::usb::device {
-    template <uint32_t Endpoint = 6>
+    /**
+     * @brief Hid mouse with 8 buttons and 2 axis
+     *
+     * @tparam Endpoint
+     * @tparam QueueSize amount of button changes that can be queued
+     */
+    template <uint32_t Endpoint = 6, uint32_t QueueSize = 8>
     class mouse_hid {
     protected:
         /**
@@ -96,10 +103,8 @@ namespace klib::usb::device {
         };
 
         // configuration descriptor
-        const __attribute__((aligned(4))) static inline config_descriptor config = {
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
             {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x01,
                 .bConfigurationValue = 0x01,
                 .iConfiguration = 0x00,
                 .bmAttributes = 0xA0,
@@ -108,7 +113,6 @@ namespace klib::usb::device {
             {
                 .bInterfaceNumber = 0x00,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = 0x03,
                 .bInterfaceSubClass = 0x00,
                 .bInterfaceProtocol = 0x00,
@@ -128,7 +132,7 @@ namespace klib::usb::device {
                 .wMaxPacketSize = 0x0040,
                 .bInterval = 0x01
             }
-        };
+        });
 
         // language descriptor for the mouse
         const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
@@ -147,6 +151,10 @@ namespace klib::usb::device {
         // configuration value. Value is set in the set config function
         static inline uint8_t configuration = 0x00;
 
+        // Push the current pack to the stack and set the pack to 1
+        // as the following structs have specific sizes
+        #pragma pack(push, 1)
+
         // mouse report structure
         struct mouse_report {
             uint8_t buttons;
@@ -154,59 +162,152 @@ namespace klib::usb::device {
             int8_t y;
         };
 
+        // release the old pack so the rest of the structs are not
+        // affected by the pack(1)
+        #pragma pack(pop)
+
         // storage for the mouse hid messages
         static inline mouse_report report_data = {};
 
-        // flag for if we have data updating
-        static inline volatile bool data_updating = false;
+        // movement that is not send to the host yet. Merged into
+        // a single report when the endpoint is free
+        static inline std::atomic<int32_t> pending_x = 0;
+        static inline std::atomic<int32_t> pending_y = 0;
+
+        // queue with button changes. Every change is send in its own
+        // report so a short click is never merged away
+        static inline uint8_t button_queue[QueueSize] = {};
+        static inline std::atomic<uint32_t> button_write = 0;
+        static inline std::atomic<uint32_t> button_read = 0;
+
+        // last button state written by the user
+        static inline uint8_t buttons = 0;
+
+        // flag if we are transmitting reports
+        static inline std::atomic<bool> transmitting = false;
+
+        /**
+         * @brief Take the pending movement limited to the range of a
+         * report. The remainder stays pending for the next report
+         *
+         * @param pending
+         * @return int8_t
+         */
+        static int8_t take(std::atomic<int32_t>& pending) {
+            const int32_t value = pending.exchange(0);
+            const int32_t result = klib::min(klib::max(value, -127), 127);
+
+            // put back what does not fit in the report
+            if (value != result) {
+                pending += (value - result);
+            }
+
+            return static_cast<int8_t>(result);
+        }
+
+        template <typename Usb>
+        static void transmit_next() {
+            while (true) {
+                // check if we have a button change
+                const bool button_change = button_read.load() != button_write.load();
+
+                if (button_change) {
+                    report_data.buttons = button_queue[button_read.load() % QueueSize];
+                    button_read++;
+                }
+
+                // merge all the pending movement into the report
+                report_data.x = take(pending_x);
+                report_data.y = take(pending_y);
+
+                if (button_change || report_data.x || report_data.y) {
+                    // send the report to the host
+                    Usb::write(hid_callback<Usb>,
+                        usb::get_endpoint(config.endpoint.bEndpointAddress),
+                        usb::get_endpoint_mode(config.endpoint.bEndpointAddress),
+                        {reinterpret_cast<const uint8_t*>(&report_data), sizeof(report_data)}
+                    );
+
+                    return;
+                }
+
+                transmitting = false;
+
+                // make sure nothing was added after the checks above
+                if ((button_read.load() == button_write.load() && !pending_x.load() && !pending_y.load()) ||
+                    transmitting.exchange(true))
+                {
+                    return;
+                }
+            }
+        }
 
         /**
-         * @brief Callback that can send more keypresses or will send no keys
+         * @brief Callback that sends the next report when we have
+         * pending data
          *
          * @tparam Usb
          * @param data
          */
         template <typename Usb>
         static void hid_callback(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
-            // only continue if we do not have any errors
-            if (error_code != usb::error::no_error) {
-                // we have a error
-                return;
-            }
+            // only continue if we do not have any errors and are configured
+            if (error_code != usb::error::no_error || !is_configured<Usb>()) {
+                // we have a error. Drop the pending data
+                clear();
 
-            // check if we are configured
-            if (!is_configured<Usb>) {
                 return;
             }
 
-            data_updating = false;
+            transmit_next<Usb>();
+        }
+
+        static void clear() {
+            pending_x = 0;
+            pending_y = 0;
+            button_read = button_write.load();
+            transmitting = false;
         }
 
     public:
+        /**
+         * @brief Write a mouse movement and the button state. Movement
+         * is merged with the movement that is not send yet. Button changes
+         * are queued so every change reaches the host
+         *
+         * @tparam Usb
+         * @tparam Async when false waits until all the data is send
+         * @param buttons
+         * @param x relative movement in the x direction
+         * @param y relative movement in the y direction
+         * @return true when the data is queued
+         */
         template <typename Usb, bool Async = true>
-        static bool write(uint8_t buttons, int8_t x, int8_t y) {
-            if (!is_configured<Usb>) {
+        static bool write(const uint8_t buttons, const int32_t x, const int32_t y) {
+            if (!is_configured<Usb>()) {
                 return false;
             }
 
-            if constexpr (Async) {
-                while (is_busy<Usb>()) {
-                    // wait until we are done processing
+            // queue the button change
+            if (buttons != mouse_hid::buttons) {
+                if ((button_write.load() - button_read.load()) >= QueueSize) {
+                    return false;
                 }
-            }
 
-            report_data.buttons = buttons;
-            report_data.x = x;
-            report_data.x = x;
+                button_queue[button_write.load() % QueueSize] = buttons;
+                button_write++;
 
-            data_updating = true;
+                mouse_hid::buttons = buttons;
+            }
 
-            // send the report to the host
-            Usb::write(hid_callback<Usb>, 
-                usb::get_endpoint(config.endpoint.bEndpointAddress),
-                usb::get_endpoint_mode(config.endpoint.bEndpointAddress),
-                {reinterpret_cast<const uint8_t*>(&report_data), sizeof(report_data)}
-            );
+            // add the movement to the pending movement
+            pending_x += x;
+            pending_y += y;
+
+            // start transmitting when we are not busy
+            if (!transmitting.exchange(true)) {
+                transmit_next<Usb>();
+            }
 
             if constexpr (!Async) {
                 while (is_busy<Usb>()) {
@@ -226,8 +327,8 @@ namespace klib::usb::device {
          */
         template <typename Usb>
         static bool is_busy() {
-            // return if the endpoint is still pending
-            return data_updating;
+            // return if we still have data to send
+            return transmitting;
         }
 
         /**
@@ -256,11 +357,8 @@ namespace klib::usb::device {
          */
         template <typename Usb>
         static void init() {
-            // make sure the endpoint supports interrupt endpoints
-            static_assert(Usb::template is_valid_endpoint<
-                Endpoint,
-                klib::usb::descriptor::transfer_type::interrupt
-            >(), "invalid interrupt endpoint selected");
+            // make sure all the endpoints in the configuration are supported
+            static_assert(descriptor::valid_endpoints<Usb, config>(), "invalid endpoint selected");
         }
 
         /**
@@ -284,6 +382,9 @@ namespace klib::usb::device {
         static void disconnected() {
             // clear all the variables to default
             configuration = 0x00;
+
+            // drop the pending data
+            clear();
         }
 
         /**
@@ -295,6 +396,9 @@ namespace klib::usb::device {
         static void bus_reset() {
             // clear all the variables to default
             configuration = 0x00;
+
+            // drop the pending data
+            clear();
         }
 
         /**
@@ -447,7 +551,10 @@ namespace klib::usb::device {
                 Usb::configured(true);
 
                 // prepare a inital report with no keys pressed and no mouse movement
+                clear();
                 report_data = {};
+                buttons = 0;
+                transmitting = true;
 
                 // write the inital report
                 if (Usb::write(hid_callback<Usb>, 
@@ -460,6 +567,8 @@ namespace klib::usb::device {
                 }
                 else {
                     // something went wrong stall for now
+                    transmitting = false;
+
                     return usb::handshake::stall;
                 }
             }
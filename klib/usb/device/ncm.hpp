@@ -0,0 +1,1288 @@
+#ifndef KLIB_USB_NCM_HPP
+#define KLIB_USB_NCM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <span>
+
+#include <klib/math.hpp>
+#include <klib/multispan.hpp>
+#include <klib/io/bus/ethernet.hpp>
+#include <klib/usb/usb/device.hpp>
+#include <klib/usb/usb/descriptor.hpp>
+#include <klib/usb/usb/cdc/descriptor.hpp>
+#include <klib/usb/usb/cdc/ncm.hpp>
+
+namespace klib::usb::device {
+    /**
+     * @brief Usb cdc ncm (network control model) device. Ethernet
+     * frames are send to and received from the host in ntb's (network
+     * transfer blocks) that contain multiple frames per bulk transfer.
+     *
+     * @details received ntb's are stored in two buffers. The next ntb
+     * is received in the other buffer while the frames of the current
+     * ntb are passed to the handler without a copy. Frames written by
+     * the application are added to the ntb that is being filled while
+     * the other ntb is transmitted. When the endpoint is idle a ntb is
+     * send directly so small amounts of traffic are not delayed.
+     *
+     * The handler needs to provide:
+     *  - static void receive(const std::span<const uint8_t>& frame)
+     *
+     * receive is called from the usb interrupt for every received
+     * frame. The frame is only valid during the call.
+     *
+     * @tparam Handler
+     * @tparam Mac mac address of the host side of the link
+     * @tparam CmdEndpoint
+     * @tparam OutEndpoint
+     * @tparam InEndpoint
+     * @tparam NtbSize size of a single ntb in both directions
+     * @tparam Interface first interface number. Only changed when used
+     * in a composite device
+     */
+    template <
+        typename Handler, klib::io::ethernet::mac_address Mac = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01},
+        uint8_t CmdEndpoint = 1, uint8_t OutEndpoint = 2, uint8_t InEndpoint = 3,
+        uint32_t NtbSize = 2048, uint8_t Interface = 0
+    >
+    class ncm {
+    public:
+        // amount of interfaces and endpoints used by the ncm device
+        constexpr static uint8_t interface_count = 2;
+        constexpr static uint8_t endpoint_count = 3;
+
+        /**
+         * @brief Ncm function for a composite device. Uses the
+         * endpoints starting at Endpoint for the command, out and in
+         * endpoint
+         *
+         * @tparam FirstInterface
+         * @tparam Endpoint
+         */
+        template <uint8_t FirstInterface, uint8_t Endpoint>
+        using function = ncm<Handler, Mac, Endpoint, Endpoint + 1, Endpoint + 2, NtbSize, FirstInterface>;
+
+        // maximum size of a ethernet frame (without the crc)
+        constexpr static uint32_t max_frame_size = 1514;
+
+    protected:
+        /**
+         * @brief Enum with the string descriptor indexes
+         *
+         */
+        enum class string_index {
+            language = 0,
+            manufacturer = 1,
+            product = 2,
+            serial = 3
+        };
+
+        // index of the mac address string. Uses the interface so every
+        // function in a composite device has its own string
+        constexpr static uint8_t mac_index = 0x10 + Interface;
+
+        // max packet size of the bulk endpoints
+        constexpr static uint32_t max_packet_size = 64;
+
+        // maximum amount of frames in a ntb we send
+        constexpr static uint32_t max_datagrams = 32;
+
+        // alignment of the frames and the ndp in a ntb
+        constexpr static uint32_t alignment = 4;
+
+        // the 16 bit ntb format is limited to 64k. Most hosts require
+        // at least 2048 bytes
+        static_assert(NtbSize >= 2048 && NtbSize <= 0xffff, "Invalid ntb size");
+
+        // Push the current pack to the stack and set the pack to 1
+        // as all these structs have specific sizes
+        #pragma pack(push, 1)
+
+        /**
+         * @brief Interface descriptors for the ncm device
+         *
+         */
+        struct interface_descriptor {
+            // communication interface descriptor
+            descriptor::interface interface0;
+
+            // cdc information
+            cdc::header header;
+            cdc::union_cdc<1> union_cdc;
+            cdc::ethernet_networking ethernet;
+            cdc::ncm ncm;
+
+            // notification endpoint descriptor
+            descriptor::endpoint endpoint0;
+
+            // data interface without endpoints. The host selects
+            // alternate setting 1 to start the network
+            descriptor::interface interface1;
+
+            // data interface with the bulk endpoints
+            descriptor::interface interface1_alt;
+
+            // endpoint descriptor
+            descriptor::endpoint endpoint1;
+
+            // endpoint descriptor
+            descriptor::endpoint endpoint2;
+        };
+
+        /**
+         * @brief Config descriptor for the ncm device
+         *
+         * @details packed so we can write this whole descriptor
+         * to the usb hardware in one go.
+         *
+         */
+        struct config_descriptor {
+            // configuration descriptor
+            descriptor::configuration configuration;
+
+            // all the interfaces of the ncm device
+            interface_descriptor interfaces;
+        };
+
+        // release the old pack so the rest of the structs are not
+        // affected by the pack(1)
+        #pragma pack(pop)
+
+        // device descriptor for the ncm device
+        const __attribute__((aligned(4))) static inline descriptor::device device = {
+            .bcdUSB = setup::usb_version::usb_v2_0,
+            .bDeviceClass = descriptor::class_type::communication_and_cdc,
+            .bDeviceSubClass = 0x00,
+            .bDeviceProtocol = 0x00,
+            .bMaxPacketSize = 0x40,
+            .idVendor = 0x6666,
+            .idProduct = 0xaaab,
+            .bcdDevice = static_cast<uint16_t>(setup::usb_version::usb_v2_0),
+            .iManufacturer = static_cast<uint8_t>(string_index::manufacturer),
+            .iProduct = static_cast<uint8_t>(string_index::product),
+            .iSerialNumber = static_cast<uint8_t>(string_index::serial),
+            .bNumConfigurations = 0x1
+        };
+
+    public:
+        // interface association for when the device is used in a
+        // composite device
+        constexpr static descriptor::interface_association association = {
+            .bFirstInterface = Interface,
+            .bInterfaceCount = interface_count,
+            .bFunctionClass = 0x02,
+            .bFunctionSubClass = 0x0d,
+            .bFunctionProtocol = 0x00,
+            .iFunction = 0x00
+        };
+
+        // interface descriptors of the ncm device
+        constexpr static interface_descriptor interfaces = {
+            {
+                .bInterfaceNumber = Interface,
+                .bAlternateSetting = 0x00,
+                .bInterfaceClass = 0x02,
+                .bInterfaceSubClass = 0x0d,
+                .bInterfaceProtocol = 0x00,
+                .iInterface = 0x00
+            },
+            {
+                .bcdCDC = setup::usb_version::usb_v1_1,
+            },
+            {
+                .bControlInterface = Interface,
+                .bSubordinateInterface = {
+                    Interface + 1
+                }
+            },
+            {
+                .iMACAddress = mac_index,
+                .bmEthernetStatistics = 0x00000000,
+                .wMaxSegmentSize = max_frame_size,
+                .wNumberMCFilters = 0x0000,
+                .bNumberPowerFilters = 0x00
+            },
+            {
+                .bcdNcmVersion = 0x0100,
+                .bmNetworkCapabilities = 0x00
+            },
+            {
+                .bEndpointAddress = 0x80 | CmdEndpoint,
+                .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::interrupt),
+                .wMaxPacketSize = sizeof(klib::usb::ncm::speed_change),
+                .bInterval = 0x0a
+            },
+            {
+                .bInterfaceNumber = Interface + 1,
+                .bAlternateSetting = 0x00,
+                .bInterfaceClass = 0x0a,
+                .bInterfaceSubClass = 0x00,
+                .bInterfaceProtocol = 0x01,
+                .iInterface = 0x00
+            },
+            {
+                .bInterfaceNumber = Interface + 1,
+                .bAlternateSetting = 0x01,
+                .bInterfaceClass = 0x0a,
+                .bInterfaceSubClass = 0x00,
+                .bInterfaceProtocol = 0x01,
+                .iInterface = 0x00
+            },
+            {
+                .bEndpointAddress = OutEndpoint,
+                .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::bulk),
+                .wMaxPacketSize = max_packet_size,
+                .bInterval = 0x00
+            },
+            {
+                .bEndpointAddress = 0x80 | InEndpoint,
+                .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::bulk),
+                .wMaxPacketSize = max_packet_size,
+                .bInterval = 0x00
+            }
+        };
+
+    protected:
+        // configuration value of the standalone device
+        constexpr static uint8_t configuration_value = 0x01;
+
+        // configuration descriptor
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
+            {
+                .bConfigurationValue = configuration_value,
+                .iConfiguration = 0x00,
+                .bmAttributes = 0x80,
+                .bMaxPower = 0x32,
+            },
+            interfaces
+        });
+
+        // language descriptor for the ncm device
+        const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
+            .bString = {0x0409}
+        };
+
+        // manufacturer string descriptor
+        const __attribute__((aligned(4))) static inline auto manufacturer = string_descriptor("KLIB");
+
+        // product string descriptor
+        const __attribute__((aligned(4))) static inline auto product = string_descriptor("KLIB Network");
+
+        // serial number string descriptor
+        const __attribute__((aligned(4))) static inline auto serial_nr = string_descriptor("00001337");
+
+        /**
+         * @brief Create the mac address string descriptor. The mac
+         * is stored as 12 hexadecimal characters
+         *
+         * @return descriptor::string<12>
+         */
+        consteval static descriptor::string<12> mac_descriptor() {
+            constexpr char hex[] = "0123456789ABCDEF";
+            descriptor::string<12> ret;
+
+            for (uint32_t i = 0; i < Mac.size(); i++) {
+                ret.bString[i * 2] = hex[Mac[i] >> 4];
+                ret.bString[(i * 2) + 1] = hex[Mac[i] & 0xf];
+            }
+
+            return ret;
+        }
+
+        // mac address string descriptor
+        const __attribute__((aligned(4))) static inline auto mac = mac_descriptor();
+
+        // ntb parameters we send to the host. We support the 16 bit
+        // ntb format with 4 byte aligned frames and ndp's
+        constexpr __attribute__((aligned(4))) static inline klib::usb::ncm::ntb_parameters parameters = {
+            .bmNtbFormatsSupported = 0x0001,
+            .dwNtbInMaxSize = NtbSize,
+            .wNdpInDivisor = alignment,
+            .wNdpInPayloadRemainder = 0x0000,
+            .wNdpInAlignment = alignment,
+            .wReserved = 0x0000,
+            .dwNtbOutMaxSize = NtbSize,
+            .wNdpOutDivisor = alignment,
+            .wNdpOutPayloadRemainder = 0x0000,
+            .wNdpOutAlignment = alignment,
+            .wNtbOutMaxDatagrams = 0x0000
+        };
+
+        // notifications send when the host enables the data interface.
+        // We report the full speed bitrate
+        constexpr __attribute__((aligned(4))) static inline klib::usb::ncm::speed_change speed_notification = {
+            {
+                .bNotificationCode = klib::usb::ncm::notification::connection_speed_change,
+                .wValue = 0x0000,
+                .wIndex = Interface,
+                .wLength = sizeof(klib::usb::ncm::speed_change) - sizeof(klib::usb::ncm::notification_header)
+            },
+            12'000'000,
+            12'000'000
+        };
+
+        constexpr __attribute__((aligned(4))) static inline klib::usb::ncm::notification_header connection_notification = {
+            .bNotificationCode = klib::usb::ncm::notification::network_connection,
+            .wValue = 0x0001,
+            .wIndex = Interface,
+            .wLength = 0x0000
+        };
+
+        // configuration value. Value is set in the set config function
+        static inline uint8_t configuration = 0x00;
+
+        // alternate setting of the data interface. The network is
+        // only active in alternate setting 1
+        static inline volatile uint8_t alternate = 0x00;
+
+        // maximum size of a ntb we send. Can be lowered by the host
+        static inline uint32_t ntb_in_max = NtbSize;
+
+        // buffer for the ntb input size (4 bytes, 8 bytes when the
+        // host also sends the max datagram count)
+        alignas(4) static inline uint8_t command_buffer[8] = {};
+
+        // receive buffers. The usb hardware writes directly in these
+        // buffers. The next ntb is received in the other buffer while
+        // the frames of a ntb are handled
+        alignas(4) static inline uint8_t rx_buffer[2][NtbSize] = {};
+
+        // index of the buffer we are receiving in
+        static inline uint8_t rx_index = 0;
+
+        // transmit buffers. One is transmitted while the application
+        // adds frames to the other one
+        alignas(4) static inline uint8_t tx_buffer[2][NtbSize] = {};
+
+        // index of the buffer the application adds frames to
+        static inline uint8_t tx_fill = 0;
+
+        // end of the last frame in the fill buffer
+        static inline uint32_t tx_offset = sizeof(klib::usb::ncm::nth16);
+
+        // frames in the fill buffer
+        static inline uint32_t tx_count = 0;
+        static inline klib::usb::ncm::datagram_pointer tx_pointers[max_datagrams] = {};
+
+        // sequence number of the next ntb we send
+        static inline uint16_t tx_sequence = 0;
+
+        // flag if the application is adding a frame to the fill buffer.
+        // The usb interrupt does not touch the fill buffer when set
+        static inline std::atomic<bool> tx_locked = false;
+
+        // flag if a ntb is being transmitted
+        static inline std::atomic<bool> transmitting = false;
+
+        /**
+         * @brief Align a offset in a ntb
+         *
+         * @param offset
+         * @return uint32_t
+         */
+        constexpr static uint32_t align(const uint32_t offset) {
+            return (offset + (alignment - 1)) & ~(alignment - 1);
+        }
+
+        /**
+         * @brief Read a little endian 16 bit value from a ntb
+         *
+         * @param data
+         * @param offset
+         * @return uint16_t
+         */
+        static uint16_t get_u16(const uint8_t *const data, const uint32_t offset) {
+            return data[offset] | (data[offset + 1] << 8);
+        }
+
+        /**
+         * @brief Read a little endian 32 bit value from a ntb
+         *
+         * @param data
+         * @param offset
+         * @return uint32_t
+         */
+        static uint32_t get_u32(const uint8_t *const data, const uint32_t offset) {
+            return get_u16(data, offset) | (get_u16(data, offset + 2) << 16);
+        }
+
+        /**
+         * @brief Pass all the frames in a received ntb to the handler
+         *
+         * @param ntb
+         * @param size
+         */
+        static void handle_ntb(const uint8_t *const ntb, const uint32_t size) {
+            // check the ntb header
+            if (size < sizeof(klib::usb::ncm::nth16) || get_u32(ntb, 0) != klib::usb::ncm::nth16{}.dwSignature ||
+                get_u16(ntb, 4) != sizeof(klib::usb::ncm::nth16))
+            {
+                return;
+            }
+
+            // only use the data that is part of the ntb
+            const uint32_t length = klib::min(size, static_cast<uint32_t>(get_u16(ntb, 8)));
+
+            // get the first ndp. Limit the amount of ndp's so a invalid
+            // ntb cannot keep us busy forever
+            uint32_t index = get_u16(ntb, 10);
+
+            for (uint32_t n = 0; n < 8 && index; n++) {
+                // check the ndp header
+                if ((index + sizeof(klib::usb::ncm::ndp16)) > length || (index % alignment) ||
+                    get_u32(ntb, index) != klib::usb::ncm::ndp16{}.dwSignature)
+                {
+                    return;
+                }
+
+                // get the end of the datagram pointers
+                const uint32_t end = klib::min(length, index + get_u16(ntb, index + 4));
+
+                // pass every frame to the handler
+                for (uint32_t p = index + sizeof(klib::usb::ncm::ndp16); (p + sizeof(klib::usb::ncm::datagram_pointer)) <= end;
+                     p += sizeof(klib::usb::ncm::datagram_pointer))
+                {
+                    const uint32_t offset = get_u16(ntb, p);
+                    const uint32_t frame = get_u16(ntb, p + 2);
+
+                    // a zero entry ends the table
+                    if (!offset || !frame) {
+                        break;
+                    }
+
+                    // skip frames outside the ntb
+                    if ((offset + frame) > length) {
+                        continue;
+                    }
+
+                    Handler::receive(std::span<const uint8_t>{ntb + offset, frame});
+                }
+
+                // move to the next ndp
+                index = get_u16(ntb, index + 6);
+            }
+        }
+
+        /**
+         * @brief Start a read into the next receive buffer
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void start_receive() {
+            Usb::read(receive_callback_handler<Usb>,
+                usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress),
+                {rx_buffer[rx_index], NtbSize}
+            );
+        }
+
+        /**
+         * @brief Callback that starts receiving the next ntb and
+         * passes the frames of the received ntb to the handler
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         * @param transferred
+         */
+        template <typename Usb>
+        static void receive_callback_handler(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            // only continue if we do not have any errors
+            if (error_code != usb::error::no_error || !configuration || !alternate) {
+                return;
+            }
+
+            const uint8_t *const ntb = rx_buffer[rx_index];
+
+            // receive the next ntb in the other buffer before handling
+            // the frames so the host can keep sending
+            rx_index ^= 1;
+            start_receive<Usb>();
+
+            handle_ntb(ntb, transferred);
+        }
+
+        /**
+         * @brief Finish the ntb in the fill buffer and transmit it. The
+         * other buffer becomes the fill buffer. Should only be called
+         * when the transmitting flag is set by the caller
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void start_transmit() {
+            // check if we have anything to send
+            if (!tx_count) {
+                transmitting = false;
+
+                return;
+            }
+
+            uint8_t *const ntb = tx_buffer[tx_fill];
+
+            // add the ndp after the last frame
+            const uint32_t index = align(tx_offset);
+            const uint32_t ndp_size = sizeof(klib::usb::ncm::ndp16) + ((tx_count + 1) * sizeof(klib::usb::ncm::datagram_pointer));
+
+            *reinterpret_cast<klib::usb::ncm::ndp16*>(&ntb[index]) = {
+                .wLength = static_cast<uint16_t>(ndp_size),
+                .wNextNdpIndex = 0x0000
+            };
+
+            // add the datagram pointers with the zero entry at the end
+            auto *const pointers = reinterpret_cast<klib::usb::ncm::datagram_pointer*>(&ntb[index + sizeof(klib::usb::ncm::ndp16)]);
+
+            std::copy_n(tx_pointers, tx_count, pointers);
+            pointers[tx_count] = {0x0000, 0x0000};
+
+            // end the transfer with a short packet by adding a byte of
+            // padding. A ntb of the maximum size does not need one
+            uint32_t length = index + ndp_size;
+
+            if ((length % max_packet_size) == 0 && length < ntb_in_max) {
+                ntb[length++] = 0x00;
+            }
+
+            *reinterpret_cast<klib::usb::ncm::nth16*>(ntb) = {
+                .wSequence = tx_sequence++,
+                .wBlockLength = static_cast<uint16_t>(length),
+                .wNdpIndex = static_cast<uint16_t>(index)
+            };
+
+            // the other buffer is free as we only transmit one ntb at a time
+            tx_fill ^= 1;
+            tx_offset = sizeof(klib::usb::ncm::nth16);
+            tx_count = 0;
+
+            if (!Usb::write(transmit_callback_handler<Usb>,
+                usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress),
+                {ntb, length}))
+            {
+                transmitting = false;
+            }
+        }
+
+        /**
+         * @brief Callback that transmits the next ntb when the
+         * application added frames
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         * @param transferred
+         */
+        template <typename Usb>
+        static void transmit_callback_handler(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            // only continue if we do not have any errors
+            if (error_code != usb::error::no_error || !configuration || !alternate) {
+                // we have a error. Mark we are not transmitting so we
+                // can start again when we are active
+                transmitting = false;
+
+                return;
+            }
+
+            // check if the application is adding a frame. The usb
+            // interrupt cannot be interrupted by the application so
+            // it will see the cleared flag and start the transfer
+            if (tx_locked) {
+                transmitting = false;
+
+                return;
+            }
+
+            start_transmit<Usb>();
+        }
+
+        /**
+         * @brief Callback of the notifications. Sends the connection
+         * notification after the speed notification
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         * @param transferred
+         */
+        template <typename Usb>
+        static void notification_callback_handler(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            // only continue if we do not have any errors
+            if (error_code != usb::error::no_error || !configuration || !alternate) {
+                return;
+            }
+
+            // check if the speed notification is done
+            if (transferred != sizeof(speed_notification)) {
+                return;
+            }
+
+            Usb::write(notification_callback_handler<Usb>,
+                usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress),
+                {reinterpret_cast<const uint8_t*>(&connection_notification), sizeof(connection_notification)}
+            );
+        }
+
+        /**
+         * @brief Add a frame to the fill buffer if it fits
+         *
+         * @tparam CopyN
+         * @tparam T
+         * @param frame
+         * @return true
+         * @return false
+         */
+        template <bool CopyN, typename T>
+        static bool add_frame(const T& frame) {
+            const uint32_t size = frame.size_bytes();
+            const uint32_t offset = align(tx_offset);
+
+            // check if the frame and the datagram pointer (with the
+            // zero entry at the end) fit in the ntb
+            const uint32_t end = align(offset + size) + sizeof(klib::usb::ncm::ndp16) +
+                ((tx_count + 2) * sizeof(klib::usb::ncm::datagram_pointer));
+
+            if (tx_count >= max_datagrams || end > ntb_in_max) {
+                return false;
+            }
+
+            uint8_t *const ntb = tx_buffer[tx_fill];
+
+            // check how we can copy the data to the ntb. For the
+            // multispan we need to fall back to a for loop as it can
+            // be non contiguous
+            if constexpr (CopyN) {
+                std::copy_n(frame.data(), size, &ntb[offset]);
+            }
+            else {
+                for (uint32_t i = 0; i < size; i++) {
+                    ntb[offset + i] = frame[i];
+                }
+            }
+
+            tx_pointers[tx_count++] = {static_cast<uint16_t>(offset), static_cast<uint16_t>(size)};
+            tx_offset = offset + size;
+
+            return true;
+        }
+
+        /**
+         * @brief Add a frame to the ntb and start transmitting when
+         * the endpoint is idle
+         *
+         * @tparam Usb
+         * @tparam CopyN
+         * @tparam T
+         * @param frame
+         * @return true
+         * @return false
+         */
+        template <typename Usb, bool CopyN, typename T>
+        static bool write_impl(const T& frame) {
+            // check if the host enabled the network
+            if (!is_connected<Usb>() || !frame.size_bytes() || frame.size_bytes() > max_frame_size) {
+                return false;
+            }
+
+            // try twice. When the ntb is full and the endpoint is idle
+            // we send it and add the frame to the other buffer
+            for (uint32_t i = 0; i < 2; i++) {
+                tx_locked = true;
+                const bool added = add_frame<CopyN>(frame);
+                tx_locked = false;
+
+                if (added) {
+                    // start a transfer if the endpoint is idle. Otherwise
+                    // the ntb is send from the callback
+                    if (!transmitting.exchange(true)) {
+                        start_transmit<Usb>();
+                    }
+
+                    return true;
+                }
+
+                // the ntb is full. If we are transmitting both buffers
+                // are in use
+                if (transmitting.exchange(true)) {
+                    return false;
+                }
+
+                start_transmit<Usb>();
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Enable the bulk endpoints and notify the host the
+         * network is connected
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void activate() {
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint1.bmAttributes),
+                interfaces.endpoint1.wMaxPacketSize
+            );
+
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint2.bmAttributes),
+                interfaces.endpoint2.wMaxPacketSize
+            );
+
+            // clear the ntb state
+            rx_index = 0;
+            tx_fill = 0;
+            tx_offset = sizeof(klib::usb::ncm::nth16);
+            tx_count = 0;
+            tx_sequence = 0;
+            transmitting = false;
+
+            alternate = 0x01;
+
+            // start receiving on the out endpoint
+            start_receive<Usb>();
+
+            // notify the host about the speed. The connection is send
+            // after the speed notification is done
+            Usb::write(notification_callback_handler<Usb>,
+                usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress),
+                {reinterpret_cast<const uint8_t*>(&speed_notification), sizeof(speed_notification)}
+            );
+        }
+
+        /**
+         * @brief Disable the bulk endpoints
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void deactivate() {
+            if (!alternate) {
+                return;
+            }
+
+            alternate = 0x00;
+
+            Usb::reset(
+                usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress)
+            );
+
+            Usb::reset(
+                usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress)
+            );
+
+            transmitting = false;
+        }
+
+        /**
+         * @brief Callback of the set ntb input size request
+         *
+         * @tparam Usb
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         * @param transferred
+         */
+        template <typename Usb>
+        static void input_size_callback_handler(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
+            // get the new size
+            const uint32_t size = get_u32(command_buffer, 0);
+
+            // only accept sizes we can store in our buffers
+            if (error_code != usb::error::no_error || transferred < sizeof(uint32_t) ||
+                size < 2048 || size > NtbSize)
+            {
+                Usb::stall(usb::control_endpoint, usb::endpoint_mode::in);
+
+                return;
+            }
+
+            ntb_in_max = size;
+
+            Usb::ack(usb::control_endpoint, usb::endpoint_mode::in);
+        }
+
+    public:
+        /**
+         * @brief Write a ethernet frame to the host. The frame is
+         * copied into the ntb
+         *
+         * @tparam Usb
+         * @param frame
+         * @return true when the frame is added
+         * @return false when the network is not active or both ntb's
+         * are in use
+         */
+        template <typename Usb>
+        static bool write(const std::span<const uint8_t>& frame) {
+            return write_impl<Usb, true>(frame);
+        }
+
+        /**
+         * @brief Write a ethernet frame stored in multiple buffers
+         * (e.g. a header and a payload) to the host. The parts are
+         * gathered into the ntb
+         *
+         * @tparam Usb
+         * @param frame
+         * @return true when the frame is added
+         * @return false when the network is not active or both ntb's
+         * are in use
+         */
+        template <typename Usb>
+        static bool write(const multispan<const uint8_t>& frame) {
+            return write_impl<Usb, false>(frame);
+        }
+
+        /**
+         * @brief Returns if a ntb is being transmitted
+         *
+         * @return true
+         * @return false
+         */
+        static bool is_busy() {
+            return transmitting;
+        }
+
+        /**
+         * @brief Returns if the host enabled the network interface
+         *
+         * @tparam Usb
+         * @return true
+         * @return false
+         */
+        template <typename Usb>
+        static bool is_connected() {
+            return configuration && alternate;
+        }
+
+        /**
+         * @brief Returns if the device is configured
+         *
+         * @tparam Usb
+         * @return true
+         * @return false
+         */
+        template <typename Usb>
+        static bool is_configured() {
+            return static_cast<volatile uint8_t>(configuration) != 0;
+        }
+
+    public:
+        /**
+         * @brief static functions needed for the usb stack. Should not
+         * be called manually
+         *
+         */
+
+        /**
+         * @brief Init function. Called when the usb stack is initalized
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void init() {
+            // init all the variables to default
+            configuration = 0x00;
+            alternate = 0x00;
+            ntb_in_max = NtbSize;
+            transmitting = false;
+
+            // make sure all the endpoints of the function are supported
+            static_assert(descriptor::valid_endpoints<Usb, interfaces>(), "invalid endpoint selected");
+        }
+
+        /**
+         * @brief Get the configuration of the config. Needed
+         * for some hardware
+         *
+         * @tparam Usb
+         * @return uint16_t
+         */
+        template <typename Usb>
+        static uint8_t get_configuration() {
+            return config.configuration.bConfigurationValue;
+        }
+
+        /**
+         * @brief Called when the host is disconnected
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void disconnected() {
+            // clear all the variables to default
+            configuration = 0x00;
+            alternate = 0x00;
+            transmitting = false;
+        }
+
+        /**
+         * @brief Called when a bus reset has occured
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void bus_reset() {
+            // clear all the variables to default
+            configuration = 0x00;
+            alternate = 0x00;
+            ntb_in_max = NtbSize;
+            transmitting = false;
+        }
+
+        /**
+         * @brief Clear a feature on the device
+         *
+         * @tparam Usb
+         * @param feature
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake clear_feature(const klib::usb::setup::feature feature, const klib::usb::setup_packet &packet) {
+            // we do not support any features
+            return usb::handshake::stall;
+        }
+
+        /**
+         * @brief Set a feature on the device
+         *
+         * @tparam Usb
+         * @param feature
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake set_feature(const klib::usb::setup::feature feature, const klib::usb::setup_packet &packet) {
+            // we do not support any features
+            return usb::handshake::stall;
+        }
+
+        /**
+         * @brief Get a string descriptor owned by the function. Used
+         * by a composite device
+         *
+         * @tparam Usb
+         * @param index
+         * @return usb::description
+         */
+        template <typename Usb>
+        static usb::description get_string(const uint8_t index) {
+            if (index == mac_index) {
+                return to_description(mac, mac.bLength);
+            }
+
+            return {nullptr, 0};
+        }
+
+        /**
+         * @brief Get the descriptor for the descriptor type and index
+         *
+         * @tparam Usb
+         * @param packet
+         * @param type
+         * @param index
+         * @return usb::description
+         */
+        template <typename Usb>
+        static usb::description get_descriptor(const setup_packet &packet, descriptor::descriptor_type type, const uint8_t index) {
+            // check if we have a default usb descriptor
+            switch (type) {
+                case descriptor::descriptor_type::device:
+                    // return the device descriptor
+                    return to_description(device, device.bLength);
+                case descriptor::descriptor_type::configuration:
+                    // return the whole configuration descriptor (total size is in
+                    // wTotalLength of the configuration)
+                    return to_description(config, config.configuration.wTotalLength);
+                case descriptor::descriptor_type::string:
+                    // check what string descriptor to send
+                    switch (static_cast<string_index>(index)) {
+                        case string_index::language:
+                            return to_description(language, language.bLength);
+                        case string_index::manufacturer:
+                            return to_description(manufacturer, manufacturer.bLength);
+                        case string_index::product:
+                            return to_description(product, product.bLength);
+                        case string_index::serial:
+                            return to_description(serial_nr, serial_nr.bLength);
+                        default:
+                            // might be the mac address
+                            return get_string<Usb>(index);
+                    }
+                default:
+                    // unkown default descriptor. Might be a class descriptor
+                    break;
+            }
+
+            // unkown get descriptor call. return a nullptr and 0 size
+            return {nullptr, 0};
+        }
+
+        /**
+         * @brief Get the configuration value set in the set config call
+         *
+         * @tparam Usb
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake get_config(const klib::usb::setup_packet &packet) {
+            // send the configuration back to the host
+            const auto result = Usb::write(
+                usb::status_callback<Usb>, usb::control_endpoint,
+                usb::endpoint_mode::in,
+                {&configuration, sizeof(configuration)}
+            );
+
+            // check if something went wrong already
+            if (!result) {
+                // something went wrong stall
+                return usb::handshake::stall;
+            }
+
+            // we do not ack here as the status callback
+            // will handle this for us
+            return usb::handshake::wait;
+        }
+
+        /**
+         * @brief Set a configuration value
+         *
+         * @tparam Usb
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake set_config(const klib::usb::setup_packet &packet) {
+            // check if the set is the same as the configuration we have stored
+            if (packet.wValue == config.configuration.bConfigurationValue) {
+                // configure the notification endpoint
+                configure<Usb>();
+
+                // notify the usb driver we are configured
+                Usb::configured(true);
+
+                // return everything is oke
+                return usb::handshake::ack;
+            }
+            else if (packet.wValue == 0) {
+                // notify the usb driver we are not configured anymore
+                Usb::configured(false);
+
+                // reset the endpoints and clear the configuration
+                deconfigure<Usb>();
+
+                // ack the packet
+                return usb::handshake::ack;
+            }
+            else {
+                // not sure what to do, stall
+                return usb::handshake::stall;
+            }
+        }
+
+        /**
+         * @brief Configure the notification endpoint. The bulk endpoints
+         * are configured when the host selects the alternate setting of
+         * the data interface. Called from set config or by a composite
+         * device
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void configure() {
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint0.bmAttributes),
+                interfaces.endpoint0.wMaxPacketSize
+            );
+
+            // the network is disabled until the host selects the
+            // alternate setting
+            alternate = 0x00;
+
+            // store the configuration value
+            configuration = configuration_value;
+        }
+
+        /**
+         * @brief Reset the endpoints and clear the configuration.
+         * Called from set config or by a composite device
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void deconfigure() {
+            // reset the used endpoint if we have one
+            if (configuration) {
+                deactivate<Usb>();
+
+                Usb::reset(
+                    usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress)
+                );
+            }
+
+            // clear the configuration value
+            configuration = 0x00;
+        }
+
+        /**
+         * @brief Get the device status. Called when the status is requested
+         *
+         * @tparam Usb
+         * @return uint8_t
+         */
+        template <typename Usb>
+        static uint8_t get_device_status() {
+            return 0;
+        }
+
+        /**
+         * @brief Called when a class specific packet is received
+         *
+         * @tparam Usb
+         * @param packet
+         */
+        template <typename Usb>
+        static usb::handshake handle_class_packet(const klib::usb::setup_packet &packet) {
+            // data we send to the host
+            const uint8_t* data = nullptr;
+            uint32_t size = 0;
+
+            // the current ntb format (16 bit) and input size
+            alignas(4) static uint16_t format = 0x0000;
+            alignas(4) static uint32_t input_size = 0;
+
+            switch (static_cast<klib::usb::ncm::request>(packet.bRequest)) {
+                case klib::usb::ncm::request::get_ntb_parameters:
+                    data = reinterpret_cast<const uint8_t*>(&parameters);
+                    size = sizeof(parameters);
+                    break;
+                case klib::usb::ncm::request::get_ntb_format:
+                    data = reinterpret_cast<const uint8_t*>(&format);
+                    size = sizeof(format);
+                    break;
+                case klib::usb::ncm::request::get_ntb_input_size:
+                    input_size = ntb_in_max;
+
+                    data = reinterpret_cast<const uint8_t*>(&input_size);
+                    size = sizeof(input_size);
+                    break;
+                case klib::usb::ncm::request::set_ntb_input_size:
+                    // check if the size fits in our buffer
+                    if (packet.wLength < sizeof(uint32_t) || packet.wLength > sizeof(command_buffer)) {
+                        return usb::handshake::stall;
+                    }
+
+                    // read the new size. The callback will ack or stall
+                    if (!Usb::read(input_size_callback_handler<Usb>, usb::control_endpoint,
+                        usb::endpoint_mode::in, {command_buffer, packet.wLength}))
+                    {
+                        return usb::handshake::stall;
+                    }
+
+                    return usb::handshake::wait;
+                case klib::usb::ncm::request::set_ntb_format:
+                    // we only support the 16 bit ntb format
+                    return (packet.wValue == 0x0000) ? usb::handshake::ack : usb::handshake::stall;
+                case klib::usb::ncm::request::set_ethernet_packet_filter:
+                    // we pass all the frames to the handler
+                    return usb::handshake::ack;
+                default:
+                    // unsupported request
+                    return usb::handshake::stall;
+            }
+
+            // send the data to the host
+            if (!Usb::write(usb::status_callback<Usb>, usb::control_endpoint, usb::endpoint_mode::in,
+                {data, klib::min(size, static_cast<uint32_t>(packet.wLength))}))
+            {
+                return usb::handshake::stall;
+            }
+
+            // we do not ack here as the status callback
+            // will handle this for us
+            return usb::handshake::wait;
+        }
+
+        /**
+         * @brief Called when get interface is received
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake get_interface(const klib::usb::setup_packet &packet) {
+            // response needs to be static as it is send after we return
+            alignas(4) static uint8_t response = 0x00;
+
+            // only the data interface has a alternate setting
+            response = ((packet.wIndex & 0xff) == (Interface + 1)) ? alternate : 0x00;
+
+            // send the interface back to the host
+            const auto result = Usb::write(
+                usb::status_callback<Usb>, usb::control_endpoint,
+                usb::endpoint_mode::in,
+                {&response, sizeof(response)}
+            );
+
+            // check if something went wrong already
+            if (!result) {
+                // something went wrong stall
+                return usb::handshake::stall;
+            }
+
+            // we do not ack here as the status callback
+            // will handle this for us
+            return usb::handshake::wait;
+        }
+
+        /**
+         * @brief Called when set interface is received. Alternate
+         * setting 1 of the data interface enables the network
+         *
+         * @tparam Usb
+         * @param packet
+         * @return usb::handshake
+         */
+        template <typename Usb>
+        static usb::handshake set_interface(const klib::usb::setup_packet &packet) {
+            // the communication interface only has a single setting
+            if ((packet.wIndex & 0xff) != (Interface + 1)) {
+                return (packet.wValue == 0) ? usb::handshake::ack : usb::handshake::stall;
+            }
+
+            switch (packet.wValue) {
+                case 0:
+                    deactivate<Usb>();
+                    break;
+                case 1:
+                    // reset the data interface when it was already active
+                    deactivate<Usb>();
+                    activate<Usb>();
+                    break;
+                default:
+                    return usb::handshake::stall;
+            }
+
+            return usb::handshake::ack;
+        }
+    };
+}
+
+#endif
@@ -4,15 +4,54 @@
 #include <algorithm>
 #include <span>
 
-#include <klib/ringbuffer.hpp>
+#include <klib/math.hpp>
 #include <klib/string.hpp>
 #include <klib/usb/usb/device.hpp>
 #include <klib/usb/usb/descriptor.hpp>
 #include <klib/usb/usb/cdc/descriptor.hpp>
 
 namespace klib::usb::device {
-    template <uint8_t CmdEndpoint = 1, uint8_t OutEndpoint = 2, uint8_t InEndpoint = 3, uint32_t RxSize = 128>
+    /**
+     * @brief Usb cdc serial device.
+     *
+     * @details received packets are stored directly in RxSize / 64
+     * packet buffers by the usb hardware. The application can read
+     * from these without a extra copy using peek and consume. Data
+     * that is written is stored in a TxSize transmit buffer. The
+     * buffer is transmitted in as big as possible transfers from the
+     * completion callback. This combines small writes into full
+     * packets and makes the write non-blocking.
+     *
+     * @tparam CmdEndpoint
+     * @tparam OutEndpoint
+     * @tparam InEndpoint
+     * @tparam RxSize size of the receive buffer. Needs to be a power of 2
+     * multiple of the max packet size
+     * @tparam TxSize size of the transmit buffer. Needs to be a power of 2
+     * @tparam Interface first interface number. Only changed when used
+     * in a composite device
+     */
+    template <
+        uint8_t CmdEndpoint = 1, uint8_t OutEndpoint = 2, uint8_t InEndpoint = 3,
+        uint32_t RxSize = 128, uint32_t TxSize = 256, uint8_t Interface = 0
+    >
     class serial {
+    public:
+        // amount of interfaces and endpoints used by the serial device
+        constexpr static uint8_t interface_count = 2;
+        constexpr static uint8_t endpoint_count = 3;
+
+        /**
+         * @brief Serial function for a composite device. Uses the
+         * endpoints starting at Endpoint for the command, out and in
+         * endpoint
+         *
+         * @tparam FirstInterface
+         * @tparam Endpoint
+         */
+        template <uint8_t FirstInterface, uint8_t Endpoint>
+        using function = serial<Endpoint, Endpoint + 1, Endpoint + 2, RxSize, TxSize, FirstInterface>;
+
     protected:
         /**
          * @brief Enum with the string descriptor indexes
@@ -38,24 +77,34 @@ namespace klib::usb::device {
         };
 
         // TODO: change these sizes to the max enpoint size
-        // rx buffer used for receiving
-        static inline uint8_t rx_buffer[64] = {};
+        // max packet size of the bulk endpoints
+        constexpr static uint32_t max_packet_size = 64;
+
+        // amount of packets we can store in the receive buffer
+        constexpr static uint32_t rx_packets = RxSize / max_packet_size;
+
+        // make sure the sizes are valid. The indexes are free running
+        // counters so the sizes need to be a power of 2
+        static_assert(rx_packets && ((rx_packets & (rx_packets - 1)) == 0),
+            "RxSize needs to be a power of 2 multiple of the max packet size"
+        );
+        static_assert(TxSize && ((TxSize & (TxSize - 1)) == 0),
+            "TxSize needs to be a power of 2"
+        );
+
+        // rx buffers used for receiving. The usb hardware writes
+        // directly in these buffers
+        static inline uint8_t rx_buffer[rx_packets][max_packet_size] = {};
 
         // Push the current pack to the stack and set the pack to 1
         // as all these structs have specific sizes
         #pragma pack(push, 1)
 
         /**
-         * @brief Config descriptor for the serial device
-         *
-         * @details packed so we can write this whole descriptor
-         * to the usb hardware in one go.
+         * @brief Interface descriptors for the serial device
          *
          */
-        struct config_descriptor {
-            // configuration descriptor
-            descriptor::configuration configuration;
-
+        struct interface_descriptor {
             // interface descriptor
             descriptor::interface interface0;
 
@@ -78,6 +127,21 @@ namespace klib::usb::device {
             descriptor::endpoint endpoint2;
         };
 
+        /**
+         * @brief Config descriptor for the serial device
+         *
+         * @details packed so we can write this whole descriptor
+         * to the usb hardware in one go.
+         *
+         */
+        struct config_descriptor {
+            // configuration descriptor
+            descriptor::configuration configuration;
+
+            // all the interfaces of the serial device
+            interface_descriptor interfaces;
+        };
+
         // release the old pack so the rest of the structs are not
         // affected by the pack(1)
         #pragma pack(pop)
@@ -98,20 +162,23 @@ namespace klib::usb::device {
             .bNumConfigurations = 0x1
         };
 
-        // configuration descriptor
-        const __attribute__((aligned(4))) static inline config_descriptor config = {
-            {
-                .wTotalLength = sizeof(config_descriptor),
-                .bNumInterfaces = 0x02,
-                .bConfigurationValue = 0x01,
-                .iConfiguration = 0x00,
-                .bmAttributes = 0x80,
-                .bMaxPower = 0x32,
-            },
+    public:
+        // interface association for when the device is used in a
+        // composite device
+        constexpr static descriptor::interface_association association = {
+            .bFirstInterface = Interface,
+            .bInterfaceCount = interface_count,
+            .bFunctionClass = 0x02,
+            .bFunctionSubClass = 0x02,
+            .bFunctionProtocol = 0x01,
+            .iFunction = 0x00
+        };
+
+        // interface descriptors of the serial device
+        constexpr static interface_descriptor interfaces = {
             {
-                .bInterfaceNumber = 0x00,
+                .bInterfaceNumber = Interface,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x01,
                 .bInterfaceClass = 0x02,
                 .bInterfaceSubClass = 0x02,
                 .bInterfaceProtocol = 0x01,
@@ -122,15 +189,15 @@ namespace klib::usb::device {
             },
             {
                 .bmCapabilities = 0x00,
-                .bDataInterface = 0x01,
+                .bDataInterface = Interface + 1,
             },
             {
                 .bmCapabilities = 0x02,
             },
             {
-                .bControlInterface = 0x00,
+                .bControlInterface = Interface,
                 .bSubordinateInterface = {
-                    0x01
+                    Interface + 1
                 }
             },
             {
@@ -140,9 +207,8 @@ namespace klib::usb::device {
                 .bInterval = 0x0a
             },
             {
-                .bInterfaceNumber = 0x01,
+                .bInterfaceNumber = Interface + 1,
                 .bAlternateSetting = 0x00,
-                .bNumEndpoints = 0x02,
                 .bInterfaceClass = 0x0a,
                 .bInterfaceSubClass = 0x00,
                 .bInterfaceProtocol = 0x00,
@@ -151,17 +217,32 @@ namespace klib::usb::device {
             {
                 .bEndpointAddress = OutEndpoint,
                 .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::bulk),
-                .wMaxPacketSize = sizeof(rx_buffer),
+                .wMaxPacketSize = max_packet_size,
                 .bInterval = 0x00
             },
             {
                 .bEndpointAddress = 0x80 | InEndpoint,
                 .bmAttributes = static_cast<uint8_t>(klib::usb::descriptor::transfer_type::bulk),
-                .wMaxPacketSize = 0x40,
+                .wMaxPacketSize = max_packet_size,
                 .bInterval = 0x00
             }
         };
 
+    protected:
+        // configuration value of the standalone device
+        constexpr static uint8_t configuration_value = 0x01;
+
+        // configuration descriptor
+        constexpr __attribute__((aligned(4))) static inline config_descriptor config = descriptor::finalize(config_descriptor{
+            {
+                .bConfigurationValue = configuration_value,
+                .iConfiguration = 0x00,
+                .bmAttributes = 0x80,
+                .bMaxPower = 0x32,
+            },
+            interfaces
+        });
+
         // language descriptor for the serial device
         const __attribute__((aligned(4))) static inline descriptor::string<1> language = {
             .bString = {0x0409}
@@ -179,18 +260,37 @@ namespace klib::usb::device {
         // configuration value. Value is set in the set config function
         static inline uint8_t configuration = 0x00;
 
-        // temporary storage
-        static inline klib::ringbuffer<uint8_t, RxSize> receive = {};
+        // amount of bytes received in every rx buffer
+        static inline volatile uint32_t rx_length[rx_packets] = {};
+
+        // amount of packets received. Only changed in the usb interrupt
+        static inline volatile uint32_t rx_write = 0;
+
+        // amount of packets consumed by the application
+        static inline volatile uint32_t rx_read = 0;
+
+        // amount of bytes consumed in the current packet
+        static inline uint32_t rx_offset = 0;
+
+        // function to restart the receive after the application made
+        // space in the receive buffers. Set when we are configured
+        static inline void (*restart_receive)() = nullptr;
+
+        // transmit buffer
+        static inline uint8_t tx_buffer[TxSize] = {};
+
+        // amount of bytes written into the transmit buffer. Only
+        // changed by the application
+        static inline volatile uint32_t tx_head = 0;
+
+        // amount of bytes transmitted. Only changed in the usb interrupt
+        static inline volatile uint32_t tx_tail = 0;
 
         // buffer to receive commands
         static inline uint8_t command_buffer[64] = {};
 
-        // flag if we need to send a zlp after the data
-        static inline volatile bool send_zlp = false;
-
-        // flags if we are currently transmitting and or have received data
+        // flag if we are currently transmitting
         static inline volatile bool is_transmitting = false;
-        static inline volatile bool has_received_data = false;
 
         // the current command we are processing
         static inline command opt_code = {0xff, 0x00};
@@ -221,7 +321,38 @@ namespace klib::usb::device {
         }
 
         /**
-         * @brief Callback that can send more keypresses or will send no keys
+         * @brief Start a transfer with as much data from the transmit
+         * buffer as possible
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void start_transmit() {
+            // get the amount of data in the buffer
+            const uint32_t used = tx_head - tx_tail;
+
+            // check if we have anything to send
+            if (!used) {
+                // mark we are not transmitting anymore
+                is_transmitting = false;
+
+                return;
+            }
+
+            // transmit everything up to the end of the buffer in one
+            // transfer. The rest is send in the next transfer
+            const uint32_t index = tx_tail & (TxSize - 1);
+
+            Usb::write(transmit_callback_handler<Usb>,
+                usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress),
+                {&tx_buffer[index], klib::min(used, TxSize - index)}
+            );
+        }
+
+        /**
+         * @brief Callback that starts the next transfer if we have
+         * more data in the transmit buffer
          *
          * @tparam Usb
          * @param data
@@ -229,31 +360,32 @@ namespace klib::usb::device {
         template <typename Usb>
         static void transmit_callback_handler(const uint8_t endpoint, const usb::endpoint_mode mode, const usb::error error_code, const uint32_t transferred) {
             // only continue if we do not have any errors
-            if (error_code != usb::error::no_error) {
-                // we have a error
-                return;
-            }
+            if (error_code != usb::error::no_error || !configuration) {
+                // we have a error. Mark we are not transmitting so we
+                // can start again when we are configured
+                is_transmitting = false;
 
-            // check if we are configured
-            if (!configuration) {
                 return;
             }
 
-            // check if we need to send a zero length packet before we are
-            // done sending the current request
-            if (send_zlp) {
-                // clear the flag we need to send a zero length packet
-                send_zlp = false;
+            // remove the data from the transmit buffer
+            tx_tail = tx_tail + transferred;
 
+            // check if we have more data we need to send
+            if (tx_head != tx_tail) {
+                return start_transmit<Usb>();
+            }
+
+            // check if we need to send a zero length packet to
+            // tell the host the transfer is done
+            if (transferred && (transferred % max_packet_size) == 0) {
                 // send a zero length packet
                 Usb::write(transmit_callback_handler<Usb>,
-                    usb::get_endpoint(config.endpoint2.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint2.bEndpointAddress),
+                    usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress),
                     {}
                 );
 
-                // wait until we have called this callback again before
-                // we clear the is_transmitting flag
                 return;
             }
 
@@ -262,7 +394,22 @@ namespace klib::usb::device {
         }
 
         /**
-         * @brief Callback that can send more keypresses or will send no keys
+         * @brief Start a read into the next free receive buffer
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void start_receive() {
+            Usb::read(receive_callback_handler<Usb>,
+                usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress),
+                rx_buffer[rx_write & (rx_packets - 1)], 1, max_packet_size
+            );
+        }
+
+        /**
+         * @brief Callback that marks the received buffer as valid and
+         * starts receiving the next packet if we have space
          *
          * @tparam Usb
          * @param data
@@ -280,20 +427,16 @@ namespace klib::usb::device {
                 return;
             }
 
-            // add the received bytes to the ringbuffer
-            for (uint32_t i = 0; i < transferred; i++) {
-                receive.push(rx_buffer[i]);
-            }
-
-            // mark we have received data
-            has_received_data = true;
+            // mark the buffer as received
+            rx_length[rx_write & (rx_packets - 1)] = transferred;
+            rx_write = rx_write + 1;
 
-            // start receiving a new packet
-            Usb::read(receive_callback_handler<Usb>,
-                usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                usb::get_endpoint_mode(config.endpoint1.bEndpointAddress),
-                rx_buffer, 1, sizeof(rx_buffer)
-            );
+            // start receiving a new packet if we have space. If we
+            // do not have space the receive is restarted when the
+            // application consumes a packet
+            if ((rx_write - rx_read) < rx_packets) {
+                start_receive<Usb>();
+            }
         }
 
     public:
@@ -305,29 +448,107 @@ namespace klib::usb::device {
          */
         static bool has_data() {
             // return if we have data in the buffer
-            return has_received_data;
+            return rx_write != rx_read;
+        }
+
+        /**
+         * @brief Returns the received data in the current packet
+         * without removing it. Use consume to remove the data. Data
+         * is valid until it is consumed
+         *
+         * @return std::span<const uint8_t> empty when no data is available
+         */
+        static std::span<const uint8_t> peek() {
+            // check if we have any data
+            if (!has_data()) {
+                return {};
+            }
+
+            // get the current packet
+            const uint32_t index = rx_read & (rx_packets - 1);
+
+            return {&rx_buffer[index][rx_offset], rx_length[index] - rx_offset};
+        }
+
+        /**
+         * @brief Remove size amount of bytes from the received data
+         *
+         * @param size
+         */
+        static void consume(uint32_t size) {
+            while (size && has_data()) {
+                // get the current packet
+                const uint32_t index = rx_read & (rx_packets - 1);
+
+                // get the amount we can remove from the current packet
+                const uint32_t count = klib::min(size, rx_length[index] - rx_offset);
+
+                rx_offset += count;
+                size -= count;
+
+                // check if we are done with the current packet
+                if (rx_offset < rx_length[index]) {
+                    continue;
+                }
+
+                // check if the usb stopped receiving as we were full.
+                // When we are full no read is pending so the usb
+                // interrupt cannot change the state
+                const bool full = (rx_write - rx_read) >= rx_packets;
+
+                // free the packet
+                rx_offset = 0;
+                rx_read = rx_read + 1;
+
+                // restart the receive if we stopped because we were full
+                if (full && restart_receive) {
+                    restart_receive();
+                }
+            }
+        }
+
+        /**
+         * @brief Read received data into a buffer
+         *
+         * @param data
+         * @return uint32_t amount of bytes read
+         */
+        static uint32_t read(const std::span<uint8_t> data) {
+            uint32_t count = 0;
+
+            // copy packet by packet until we are out of data or space
+            while (count < data.size()) {
+                const auto received = peek();
+
+                if (received.empty()) {
+                    break;
+                }
+
+                // copy as much as we can from the current packet
+                const uint32_t size = klib::min(received.size(), data.size() - count);
+                std::copy_n(received.data(), size, &data[count]);
+
+                consume(size);
+                count += size;
+            }
+
+            return count;
         }
 
         /**
          * @brief Returns data read into the receive buffer
          *
-         * @warning the USB interrupt should be suppressed while
-         * this function called. Undefined behaviour when no data
-         * in ringbuffer and this function is called
+         * @warning Undefined behaviour when no data in buffer and
+         * this function is called
          *
          * @return uint8_t
          */
         static uint8_t read() {
-            // get the first item in the buffer
-            const auto r = receive.copy_and_pop();
+            uint8_t r = 0x00;
 
-            // check if the buffer is empty and update the
-            // flag if it is
-            if (receive.empty()) {
-                has_received_data = false;
-            }
+            // read a single byte
+            read({&r, sizeof(r)});
 
-            // return the data in the receive buffer
             return r;
         }
 
@@ -343,47 +564,48 @@ namespace klib::usb::device {
         }
 
         /**
-         * @brief Write data to the serial buffer. Waits until data
-         * can be written using the USB driver. Buffer needs to be
-         * available until transfer is done (can be checked using
-         * 'is_busy()')
+         * @brief Write data to the serial buffer. The data is copied
+         * into the transmit buffer and send in the background.
          *
-         * @tparam Async
+         * @tparam Usb
+         * @tparam Blocking wait until all the data fits in the
+         * transmit buffer
          * @param data
+         * @return uint32_t amount of bytes written into the buffer
          */
-        template <typename Usb, bool Async = false>
-        static void write(const std::span<const uint8_t> data) {
+        template <typename Usb, bool Blocking = false>
+        static uint32_t write(const std::span<const uint8_t> data) {
             // the current index in the data
             uint32_t index = 0;
 
-            // wait until we are not busy anymore
-            while (is_busy()) {
-                // do nothing
-            }
+            do {
+                // get the amount of data we can add to the buffer
+                const uint32_t count = klib::min(
+                    TxSize - (tx_head - tx_tail), data.size() - index
+                );
 
-            // set the flag we are transmitting
-            is_transmitting = true;
+                // copy the data into the buffer. Can wrap around
+                const uint32_t head = tx_head & (TxSize - 1);
+                const uint32_t first = klib::min(count, TxSize - head);
 
-            // check if we need to send a zlp
-            if ((data.size() % 0x40) == 0) {
-                // mark we need to send a zlp
-                send_zlp = true;
-            }
+                std::copy_n(&data[index], first, &tx_buffer[head]);
+                std::copy_n(&data[index + first], count - first, tx_buffer);
 
-            // write the data
-            Usb::write(transmit_callback_handler<Usb>,
-                usb::get_endpoint(config.endpoint2.bEndpointAddress),
-                usb::get_endpoint_mode(config.endpoint2.bEndpointAddress),
-                data
-            );
+                // mark the data as valid. Needs to be done before
+                // checking the transmitting flag
+                tx_head = tx_head + count;
+                index += count;
 
-            // check if we should wait until the full transfer is done
-            if constexpr (Async) {
-                // wait until we are done writing
-                while (is_busy()) {
-                    // do nothing
+                // start a transfer if we are not transmitting. When
+                // we are transmitting the callback will send the data
+                if (count && !is_transmitting && configuration) {
+                    is_transmitting = true;
+
+                    start_transmit<Usb>();
                 }
-            }
+            } while (Blocking && (index < data.size()) && configuration);
+
+            return index;
         }
 
         /**
@@ -412,21 +634,8 @@ namespace klib::usb::device {
          */
         template <typename Usb>
         static void init() {
-            // make sure the endpoints support the transfer types
-            static_assert(Usb::template is_valid_endpoint<
-                CmdEndpoint,
-                klib::usb::descriptor::transfer_type::interrupt
-            >(), "invalid interrupt endpoint selected");
-
-            static_assert(Usb::template is_valid_endpoint<
-                InEndpoint,
-                klib::usb::descriptor::transfer_type::bulk
-            >(), "invalid bulk endpoint selected");
-
-            static_assert(Usb::template is_valid_endpoint<
-                OutEndpoint,
-                klib::usb::descriptor::transfer_type::bulk
-            >(), "invalid bulk endpoint selected");
+            // make sure all the endpoints of the function are supported
+            static_assert(descriptor::valid_endpoints<Usb, interfaces>(), "invalid endpoint selected");
         }
 
         /**
@@ -450,6 +659,7 @@ namespace klib::usb::device {
         static void disconnected() {
             // clear all the variables to default
             configuration = 0x00;
+            is_transmitting = false;
         }
 
         /**
@@ -461,6 +671,7 @@ namespace klib::usb::device {
         static void bus_reset() {
             // clear all the variables to default
             configuration = 0x00;
+            is_transmitting = false;
         }
 
         /**
@@ -573,38 +784,8 @@ namespace klib::usb::device {
         static usb::handshake set_config(const klib::usb::setup_packet &packet) {
             // check if the set is the same as the configuration we have stored
             if (packet.wValue == config.configuration.bConfigurationValue) {
-                // configure the endpoint for our report data
-                Usb::configure(
-                    usb::get_endpoint(config.endpoint0.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint0.bEndpointAddress),
-                    usb::get_transfer_type(config.endpoint0.bmAttributes),
-                    config.endpoint0.wMaxPacketSize
-                );
-
-                Usb::configure(
-                    usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint1.bEndpointAddress),
-                    usb::get_transfer_type(config.endpoint1.bmAttributes),
-                    config.endpoint1.wMaxPacketSize
-                );
-
-                Usb::configure(
-                    usb::get_endpoint(config.endpoint2.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint2.bEndpointAddress),
-                    usb::get_transfer_type(config.endpoint2.bmAttributes),
-                    config.endpoint2.wMaxPacketSize
-                );
-
-                // start receiving on the out endpoint
-                Usb::read(
-                    receive_callback_handler<Usb>,
-                    usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                    usb::get_endpoint_mode(config.endpoint1.bEndpointAddress),
-                    rx_buffer, 1, sizeof(rx_buffer)
-                );
-
-                // store the configuration value
-                configuration = packet.wValue;
+                // configure the endpoints and start receiving
+                configure<Usb>();
 
                 // notify the usb driver we are configured
                 Usb::configured(true);
@@ -616,27 +797,8 @@ namespace klib::usb::device {
                 // notify the usb driver we are not configured anymore
                 Usb::configured(false);
 
-                // reset the used endpoint if we have one
-                if (configuration) {
-                    // reset the endpoints
-                    Usb::reset(
-                        usb::get_endpoint(config.endpoint0.bEndpointAddress),
-                        usb::get_endpoint_mode(config.endpoint0.bEndpointAddress)
-                    );
-
-                    Usb::reset(
-                        usb::get_endpoint(config.endpoint1.bEndpointAddress),
-                        usb::get_endpoint_mode(config.endpoint1.bEndpointAddress)
-                    );
-
-                    Usb::reset(
-                        usb::get_endpoint(config.endpoint2.bEndpointAddress),
-                        usb::get_endpoint_mode(config.endpoint2.bEndpointAddress)
-                    );
-                }
-
-                // clear the configuration value
-                configuration = 0x00;
+                // reset the endpoints and clear the configuration
+                deconfigure<Usb>();
 
                 // ack the packet
                 return usb::handshake::ack;
@@ -647,6 +809,90 @@ namespace klib::usb::device {
             }
         }
 
+        /**
+         * @brief Configure the endpoints and start receiving. Called
+         * from set config or by a composite device
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void configure() {
+            // configure the endpoint for our report data
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint0.bmAttributes),
+                interfaces.endpoint0.wMaxPacketSize
+            );
+
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint1.bmAttributes),
+                interfaces.endpoint1.wMaxPacketSize
+            );
+
+            Usb::configure(
+                usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress),
+                usb::get_transfer_type(interfaces.endpoint2.bmAttributes),
+                interfaces.endpoint2.wMaxPacketSize
+            );
+
+            // clear all the received data
+            rx_write = 0;
+            rx_read = 0;
+            rx_offset = 0;
+
+            // set the function to restart the receive
+            restart_receive = start_receive<Usb>;
+
+            // start receiving on the out endpoint
+            start_receive<Usb>();
+
+            // store the configuration value
+            configuration = configuration_value;
+
+            // start transmitting data that was written while
+            // we were not configured
+            if (!is_transmitting && (tx_head != tx_tail)) {
+                is_transmitting = true;
+
+                start_transmit<Usb>();
+            }
+        }
+
+        /**
+         * @brief Reset the endpoints and clear the configuration.
+         * Called from set config or by a composite device
+         *
+         * @tparam Usb
+         */
+        template <typename Usb>
+        static void deconfigure() {
+            // reset the used endpoint if we have one
+            if (configuration) {
+                // reset the endpoints
+                Usb::reset(
+                    usb::get_endpoint(interfaces.endpoint0.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint0.bEndpointAddress)
+                );
+
+                Usb::reset(
+                    usb::get_endpoint(interfaces.endpoint1.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint1.bEndpointAddress)
+                );
+
+                Usb::reset(
+                    usb::get_endpoint(interfaces.endpoint2.bEndpointAddress),
+                    usb::get_endpoint_mode(interfaces.endpoint2.bEndpointAddress)
+                );
+            }
+
+            // clear the configuration value
+            configuration = 0x00;
+        }
+
         /**
          * @brief Get the device status. Called when the status is requested
          *
@@ -249,12 +249,31 @@ namespace klib::usb::cdc {
     //     // TODO: add the data of the subtype
     // };
 
-    // struct ethernet_networking {
-    //     // header of the descriptor
-    //     const detail::functional<ethernet_networking, detail::subtype::ethernet_networking> header;
+    struct ethernet_networking {
+        // header of the descriptor
+        const detail::functional<ethernet_networking, detail::subtype::ethernet_networking> header;
 
-    //     // TODO: add the data of the subtype
-    // };
+        // index of the string descriptor with the 48 bit mac address.
+        // The mac address is stored as 12 hexadecimal characters
+        uint8_t iMACAddress;
+
+        // ethernet statistics the device collects. Every bit is a
+        // statistic (xmit_ok, rcv_ok, xmit_error, ...)
+        uint32_t bmEthernetStatistics;
+
+        // maximum segment size the device can support. Typically 1514
+        uint16_t wMaxSegmentSize;
+
+        // b[0..14] = amount of multicast filters the device supports
+        // b[15] = filters are not perfect (hashing is used)
+        uint16_t wNumberMCFilters;
+
+        // amount of pattern filters available for causing wake-up of
+        // the host
+        uint8_t bNumberPowerFilters;
+    };
+
+    static_assert(sizeof(ethernet_networking) == 0x0d, "Cdc ethernet networking descriptor size is wrong");
 
     // struct atm_networking {
     //     // header of the descriptor
@@ -326,12 +345,24 @@ namespace klib::usb::cdc {
     //     // TODO: add the data of the subtype
     // };
 
-    // struct ncm {
-    //     // header of the descriptor
-    //     const detail::functional<ncm, detail::subtype::ncm> header;
+    struct ncm {
+        // header of the descriptor
+        const detail::functional<ncm, detail::subtype::ncm> header;
+
+        // release number of the ncm specification
+        uint16_t bcdNcmVersion;
+
+        // b[0] = device supports set_ethernet_packet_filter
+        // b[1] = device supports get/set_net_address
+        // b[2] = device supports encapsulated commands
+        // b[3] = device supports get/set_max_datagram_size
+        // b[4] = device supports get/set_crc_mode
+        // b[5] = device supports 8 byte ntb input sizes
+        // b[6..7] = reserved
+        uint8_t bmNetworkCapabilities;
+    };
 
-    //     // TODO: add the data of the subtype
-    // };
+    static_assert(sizeof(ncm) == 0x06, "Cdc ncm descriptor size is wrong");
 }
 
 
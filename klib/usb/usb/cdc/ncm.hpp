@@ -0,0 +1,202 @@
+#ifndef KLIB_USB_CDC_NCM_HPP
+#define KLIB_USB_CDC_NCM_HPP
+
+#include <cstdint>
+
+// Push the current pack to the stack and set the pack to 1
+// as all these structs have specific sizes
+#pragma pack(push, 1)
+
+namespace klib::usb::ncm {
+    /**
+     * @brief Ncm class requests
+     *
+     */
+    enum class request {
+        // wValue = packet filter bitmap
+        // wIndex = interface
+        // wLength = zero
+        // data = none
+        set_ethernet_packet_filter = 0x43,
+
+        // wValue = zero
+        // wIndex = interface
+        // wLength = number of bytes to read
+        // data = ntb parameter structure
+        get_ntb_parameters = 0x80,
+
+        // wValue = zero
+        // wIndex = interface
+        // wLength = 2
+        // data = ntb format
+        get_ntb_format = 0x83,
+
+        // wValue = ntb format
+        // wIndex = interface
+        // wLength = zero
+        // data = none
+        set_ntb_format = 0x84,
+
+        // wValue = zero
+        // wIndex = interface
+        // wLength = 4 or 8
+        // data = ntb input size
+        get_ntb_input_size = 0x85,
+
+        // wValue = zero
+        // wIndex = interface
+        // wLength = 4 or 8
+        // data = ntb input size
+        set_ntb_input_size = 0x86,
+    };
+
+    /**
+     * @brief Ncm notifications send on the interrupt endpoint
+     *
+     */
+    enum class notification: uint8_t {
+        network_connection = 0x00,
+        connection_speed_change = 0x2a,
+    };
+
+    /**
+     * @brief Header of a notification
+     *
+     */
+    struct notification_header {
+        // request type of the notification (class, interface)
+        uint8_t bmRequestType = 0xa1;
+
+        // the notification
+        notification bNotificationCode;
+
+        // notification specific value
+        uint16_t wValue;
+
+        // interface the notification is for
+        uint16_t wIndex;
+
+        // amount of data after the header
+        uint16_t wLength;
+    };
+
+    static_assert(sizeof(notification_header) == 8, "Invalid ncm notification header size");
+
+    /**
+     * @brief Connection speed change notification
+     *
+     */
+    struct speed_change {
+        // header of the notification
+        notification_header header;
+
+        // downstream and upstream bitrate in bits per second
+        uint32_t DLBitRate;
+        uint32_t ULBitRate;
+    };
+
+    static_assert(sizeof(speed_change) == 16, "Invalid ncm speed change notification size");
+
+    /**
+     * @brief Ntb parameter structure. Send to the host in the
+     * get ntb parameters request
+     *
+     */
+    struct ntb_parameters {
+        // size of this structure
+        const uint16_t wLength = 0x1c;
+
+        // b[0] = 16 bit ntb format supported
+        // b[1] = 32 bit ntb format supported
+        uint16_t bmNtbFormatsSupported;
+
+        // maximum size of a ntb the device sends to the host
+        uint32_t dwNtbInMaxSize;
+
+        // alignment of the datagrams the device sends
+        uint16_t wNdpInDivisor;
+        uint16_t wNdpInPayloadRemainder;
+
+        // alignment of the ndp the device sends
+        uint16_t wNdpInAlignment;
+
+        // reserved
+        uint16_t wReserved;
+
+        // maximum size of a ntb the host can send to the device
+        uint32_t dwNtbOutMaxSize;
+
+        // alignment of the datagrams the host sends
+        uint16_t wNdpOutDivisor;
+        uint16_t wNdpOutPayloadRemainder;
+
+        // alignment of the ndp the host sends
+        uint16_t wNdpOutAlignment;
+
+        // maximum amount of datagrams in a ntb the host sends. 0
+        // means no limit
+        uint16_t wNtbOutMaxDatagrams;
+    };
+
+    static_assert(sizeof(ntb_parameters) == 0x1c, "Invalid ncm ntb parameters size");
+
+    /**
+     * @brief 16 bit ntb header (nth16). Every ntb starts with
+     * this header
+     *
+     */
+    struct nth16 {
+        // signature "NCMH"
+        uint32_t dwSignature = 0x484d434e;
+
+        // size of this header
+        uint16_t wHeaderLength = 0x0c;
+
+        // sequence number of the ntb
+        uint16_t wSequence;
+
+        // size of the whole ntb
+        uint16_t wBlockLength;
+
+        // offset of the first ndp in the ntb
+        uint16_t wNdpIndex;
+    };
+
+    static_assert(sizeof(nth16) == 12, "Invalid ncm nth16 size");
+
+    /**
+     * @brief Datagram pointer in a ndp16
+     *
+     */
+    struct datagram_pointer {
+        // offset of the datagram in the ntb
+        uint16_t wDatagramIndex;
+
+        // size of the datagram
+        uint16_t wDatagramLength;
+    };
+
+    /**
+     * @brief 16 bit datagram pointer table (ndp16) without the
+     * datagram pointers. The table is terminated with a zero entry
+     *
+     */
+    struct ndp16 {
+        // signature "NCM0" (no crc)
+        uint32_t dwSignature = 0x304d434e;
+
+        // size of the ndp including all the datagram pointers
+        uint16_t wLength;
+
+        // offset of the next ndp in the ntb
+        uint16_t wNextNdpIndex;
+    };
+
+    static_assert(sizeof(ndp16) == 8, "Invalid ncm ndp16 size");
+}
+
+// release the old pack so the rest of the structs are not
+// affected by the pack(1)
+#pragma pack(pop)
+
+#endif
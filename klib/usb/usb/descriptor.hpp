@@ -2,6 +2,9 @@
 #define KLIB_USB_PROTOCOL_HPP
 
 #include <cstdint>
+#include <array>
+#include <bit>
+#include <utility>
 
 #include "setup.hpp"
 
@@ -482,4 +485,250 @@ namespace klib::usb::descriptor {
 // affected by the pack(1)
 #pragma pack(pop)
 
-#endif
\ No newline at end of file
+namespace klib::usb::descriptor::detail {
+    /**
+     * @brief Called when a descriptor is invalid. This function is not
+     * constexpr so calling it while building a descriptor at compile time
+     * fails the build with the reason in the error
+     *
+     * @param reason
+     */
+    inline void invalid_descriptor(const char *const reason) {}
+
+    /**
+     * @brief List with all the endpoints in a configuration
+     *
+     */
+    struct endpoint_list {
+        // amount of valid entries
+        uint32_t count = 0;
+
+        // endpoint address and attributes
+        std::array<uint8_t, 32> address = {};
+        std::array<uint8_t, 32> attributes = {};
+    };
+
+    /**
+     * @brief Get all the endpoints in a configuration
+     *
+     * @tparam Size
+     * @param data
+     * @return endpoint_list
+     */
+    template <std::size_t Size>
+    consteval endpoint_list get_endpoints(const std::array<uint8_t, Size>& data) {
+        endpoint_list result = {};
+
+        for (uint32_t offset = 0; offset < Size && data[offset]; offset += data[offset]) {
+            if (static_cast<descriptor_type>(data[offset + 1]) != descriptor_type::endpoint) {
+                continue;
+            }
+
+            // skip endpoints we already have (alternate settings)
+            bool found = false;
+
+            for (uint32_t i = 0; i < result.count; i++) {
+                found |= (result.address[i] == data[offset + 2]);
+            }
+
+            if (!found && result.count < result.address.size()) {
+                result.address[result.count] = data[offset + 2];
+                result.attributes[result.count] = data[offset + 3];
+                result.count++;
+            }
+        }
+
+        return result;
+    }
+
+    template <const auto& Config>
+    constexpr endpoint_list config_endpoints = get_endpoints(
+        std::bit_cast<std::array<uint8_t, sizeof(Config)>>(Config)
+    );
+
+    template <typename Usb, const auto& Config, std::size_t... I>
+    consteval bool valid_endpoints(std::index_sequence<I...>) {
+        constexpr auto& list = config_endpoints<Config>;
+
+        return ((I >= list.count || Usb::template is_valid_endpoint<
+            static_cast<uint8_t>(list.address[I % list.address.size()] & 0x0f),
+            static_cast<transfer_type>(list.attributes[I % list.address.size()] & 0x03)
+        >()) && ...);
+    }
+}
+
+namespace klib::usb::descriptor {
+    /**
+     * @brief Finalize a configuration descriptor at compile time. Walks
+     * all the descriptors after the configuration descriptor and derives
+     * wTotalLength, bNumInterfaces and the bNumEndpoints of every
+     * interface. Fails the build when the descriptor is inconsistent
+     *
+     * @tparam Size
+     * @param data raw configuration descriptor
+     * @return std::array<uint8_t, Size>
+     */
+    template <std::size_t Size>
+    consteval std::array<uint8_t, Size> finalize(std::array<uint8_t, Size> data) {
+        // amount of interfaces (alternate setting 0)
+        uint32_t interfaces = 0;
+
+        // offset of the current interface and the amount of endpoints in it
+        uint32_t current = Size;
+        uint8_t endpoints = 0;
+
+        // interface number + 1 that owns a endpoint address and the
+        // alternate setting it was last used in
+        std::array<uint8_t, 32> owner = {};
+        std::array<uint8_t, 32> alternate = {};
+
+        if (Size < sizeof(configuration) || static_cast<descriptor_type>(data[1]) != descriptor_type::configuration) {
+            detail::invalid_descriptor("configuration descriptor should be the first descriptor");
+        }
+
+        for (uint32_t offset = 0; offset < Size; offset += data[offset]) {
+            const uint8_t length = data[offset];
+
+            if (length < 2 || (offset + length) > Size) {
+                detail::invalid_descriptor("descriptor length does not fit in the configuration");
+            }
+
+            switch (static_cast<descriptor_type>(data[offset + 1])) {
+                case descriptor_type::configuration:
+                    if (offset != 0 || length != sizeof(configuration)) {
+                        detail::invalid_descriptor("invalid configuration descriptor");
+                    }
+                    break;
+                case descriptor_type::interface:
+                    if (length != sizeof(interface)) {
+                        detail::invalid_descriptor("invalid interface descriptor length");
+                    }
+
+                    // store the endpoint count of the previous interface
+                    if (current < Size) {
+                        data[current + 4] = endpoints;
+                    }
+
+                    current = offset;
+                    endpoints = 0;
+
+                    if (data[offset + 3] == 0) {
+                        // interfaces need to be numbered from 0 without gaps
+                        if (data[offset + 2] != interfaces) {
+                            detail::invalid_descriptor("interface numbers are not sequential");
+                        }
+
+                        interfaces++;
+                    }
+                    else if (data[offset + 2] >= interfaces) {
+                        detail::invalid_descriptor("alternate setting without a interface");
+                    }
+                    break;
+                case descriptor_type::endpoint: {
+                    if (length != sizeof(endpoint)) {
+                        detail::invalid_descriptor("invalid endpoint descriptor length");
+                    }
+
+                    if (current >= Size) {
+                        detail::invalid_descriptor("endpoint without a interface");
+                    }
+
+                    const uint8_t address = data[offset + 2];
+                    const uint8_t index = (address & 0x0f) | ((address & 0x80) >> 3);
+                    const uint16_t size = data[offset + 4] | (data[offset + 5] << 8);
+                    const auto type = static_cast<transfer_type>(data[offset + 3] & 0x03);
+
+                    if ((address & 0x0f) == 0 || (address & 0x70)) {
+                        detail::invalid_descriptor("invalid endpoint address");
+                    }
+
+                    if (type == transfer_type::control || (size & 0x7ff) == 0 || (size & 0x7ff) > 1024) {
+                        detail::invalid_descriptor("invalid endpoint type or max packet size");
+                    }
+
+                    if ((type == transfer_type::interrupt && data[offset + 6] == 0) ||
+                        (type == transfer_type::isochronous && (data[offset + 6] == 0 || data[offset + 6] > 16)))
+                    {
+                        detail::invalid_descriptor("invalid endpoint interval");
+                    }
+
+                    // a endpoint can only be used by a single interface and
+                    // only once in every alternate setting
+                    if (owner[index] && (owner[index] != (data[current + 2] + 1) || alternate[index] == data[current + 3])) {
+                        detail::invalid_descriptor("endpoint address is used multiple times");
+                    }
+
+                    owner[index] = data[current + 2] + 1;
+                    alternate[index] = data[current + 3];
+
+                    endpoints++;
+                    break;
+                }
+                case descriptor_type::interface_association:
+                    if (length != sizeof(interface_association) || !data[offset + 3]) {
+                        detail::invalid_descriptor("invalid interface association descriptor");
+                    }
+
+                    // the association should be placed before the interfaces
+                    if (data[offset + 2] != interfaces) {
+                        detail::invalid_descriptor("interface association is not placed before its first interface");
+                    }
+                    break;
+                default:
+                    // class specific descriptors are not checked
+                    break;
+            }
+        }
+
+        // store the endpoint count of the last interface
+        if (current < Size) {
+            data[current + 4] = endpoints;
+        }
+
+        // check if all the associations point to valid interfaces
+        for (uint32_t offset = 0; offset < Size; offset += data[offset]) {
+            if (static_cast<descriptor_type>(data[offset + 1]) == descriptor_type::interface_association &&
+                (data[offset + 2] + data[offset + 3]) > interfaces)
+            {
+                detail::invalid_descriptor("interface association has more interfaces than the configuration");
+            }
+        }
+
+        // set the derived fields of the configuration
+        data[2] = Size & 0xff;
+        data[3] = (Size >> 8) & 0xff;
+        data[4] = interfaces;
+
+        return data;
+    }
+
+    /**
+     * @brief Finalize a configuration descriptor struct at compile time.
+     * See finalize for the raw configuration
+     *
+     * @tparam T packed configuration struct starting with the configuration
+     * descriptor
+     * @param config
+     * @return T
+     */
+    template <typename T>
+    consteval T finalize(const T& config) {
+        return std::bit_cast<T>(finalize(std::bit_cast<std::array<uint8_t, sizeof(T)>>(config)));
+    }
+
+    /**
+     * @brief Returns if all the endpoints in a configuration are supported
+     * by the usb hardware
+     *
+     * @tparam Usb
+     * @tparam Config
+     * @return true
+     * @return false
+     */
+    template <typename Usb, const auto& Config>
+    consteval bool valid_endpoints() {
+        return detail::valid_endpoints<Usb, Config>(std::make_index_sequence<32>{});
+    }
+}
+
+#endif
@@ -97,6 +97,7 @@ namespace klib::usb::msc::scsi {
         read_capacity10 = 0x25,
         read10 = 0x28,
         write10 = 0x2a,
+        synchronize_cache10 = 0x35,
         mode_sense10 = 0x5a,
         read_capacity16 = 0x9e,
     };
@@ -265,6 +265,19 @@ namespace klib::usb::msc::bot {
                         static_cast<uint8_t>(status::command::failed)
                     );
 
+                    // send the status response directly
+                    send_csw<Usb>();
+                    break;
+                case msc::scsi::command::synchronize_cache10:
+                    // write any cached data to the memory. Not all memory
+                    // types cache data, only flush when it is supported
+                    if constexpr (requires { Memory::flush(); }) {
+                        csw.bCSWStatus = (Memory::flush() ?
+                            static_cast<uint8_t>(status::command::passed) :
+                            static_cast<uint8_t>(status::command::failed)
+                        );
+                    }
+
                     // send the status response directly
                     send_csw<Usb>();
                     break;
@@ -576,80 +589,135 @@ namespace klib::usb::msc::bot {
     /**
      * @brief Helper class that alows a memory device to be accessed by the bulk only transfer driver
      *
+     * @details keeps a least recently used cache of CacheSize erase sectors.
+     * Dirty sectors are only written back when they get evicted or when
+     * flush is called (e.g. on a scsi synchronize cache or from the idle
+     * loop of the application).
+     *
      * @tparam Memory
      * @tparam Size
      * @tparam SectorSize
      * @tparam PageSize
+     * @tparam CacheSize amount of sectors to keep in ram
      */
-    template <typename Memory, uint32_t Size, uint32_t SectorSize, uint32_t PageSize>
+    template <typename Memory, uint32_t Size, uint32_t SectorSize, uint32_t PageSize, uint32_t CacheSize = 1>
     class helper {
     protected:
+        // make sure we have at least a single sector to work with
+        static_assert(CacheSize >= 1, "Helper requires at least a single sector cache");
+
         constexpr static uint32_t invalid_sector = 0xffffffff;
 
-        // current sector
-        static inline uint32_t current_sector = invalid_sector;
+        /**
+         * @brief Information about a cached sector
+         *
+         */
+        struct entry {
+            // sector stored in the buffer
+            uint32_t sector;
 
-        // buffer to store a whole sector for writing to the memory
-        static inline uint8_t buffer[SectorSize] = {};
+            // value of the access counter when this entry was last used
+            uint32_t last_used;
 
-        // flag if we wrote something to the sector buffer
-        static inline bool dirty = false;
+            // flag if we wrote something to the sector buffer
+            bool dirty;
+        };
+
+        // all the cache entries
+        static inline entry entries[CacheSize] = {};
+
+        // buffers to store whole sectors for writing to the memory
+        static inline uint8_t buffer[CacheSize][SectorSize] = {};
+
+        // counter that is incremented on every access. Used to
+        // determine the least recently used entry
+        static inline uint32_t access_counter = 0;
 
         /**
-         * @brief Write or read from the sector
+         * @brief Erase the sector and write the buffer of a entry to the memory
          *
-         * @param sector
-         * @return true
-         * @return false
+         * @param index
          */
-        static bool get_sector(const uint32_t sector) {
-            // check if a new sector requested
-            if (current_sector == sector) {
-                return true;
-            }
+        static void write_sector(const uint32_t index) {
+            // get the starting address of the sector
+            const uint32_t address = (entries[index].sector * SectorSize);
 
-            // check if we should flush data
-            if (current_sector != invalid_sector && dirty) {
-                // get the starting address of the sector
-                const uint32_t address = (current_sector * SectorSize);
+            // do a sector erase
+            Memory::erase(Memory::erase_mode::sector, address);
+
+            // wait until the device is not busy
+            while (Memory::is_busy()) {
+                // do nothing until the memory is not busy anymore
+            }
 
-                // do a sector erase
-                Memory::erase(Memory::erase_mode::sector, address);
+            // write the data in pagesize chunks (some memories do not
+            // support writing big chunks at once)
+            for (uint32_t i = 0; i < SectorSize; i += PageSize) {
+                // write the buffer
+                Memory::write(address + i, &buffer[index][i], PageSize);
 
                 // wait until the device is not busy
                 while (Memory::is_busy()) {
                     // do nothing until the memory is not busy anymore
                 }
+            }
 
-                // write the data in pagesize chunks (some memories do not
-                // support writing big chunks at once)
-                for (uint32_t i = 0; i < sizeof(buffer); i += PageSize) {
-                    // write the buffer
-                    Memory::write(address + i, &buffer[i], PageSize);
+            entries[index].dirty = false;
+        }
 
-                    // wait until the device is not busy
-                    while (Memory::is_busy()) {
-                        // do nothing until the memory is not busy anymore
-                    }
+        /**
+         * @brief Get the cache entry of a sector. Reads the sector from
+         * memory if it is not in the cache
+         *
+         * @param sector
+         * @return uint32_t index of the entry
+         */
+        static uint32_t get_sector(const uint32_t sector) {
+            // update the access counter
+            access_counter++;
+
+            // index of the entry we are going to replace if we
+            // do not have the sector in the cache
+            uint32_t victim = 0;
+
+            for (uint32_t i = 0; i < CacheSize; i++) {
+                // check if we have the sector in the cache already
+                if (entries[i].sector == sector) {
+                    entries[i].last_used = access_counter;
+
+                    return i;
+                }
+
+                // check if the current victim is already a free entry
+                if (entries[victim].sector == invalid_sector) {
+                    continue;
                 }
 
-                dirty = false;
+                // prefer free entries. Otherwise take the least recently
+                // used (the subtraction keeps this valid when the counter
+                // wraps around)
+                if ((entries[i].sector == invalid_sector) ||
+                    ((access_counter - entries[i].last_used) >
+                     (access_counter - entries[victim].last_used)))
+                {
+                    victim = i;
+                }
             }
 
-            // check if we should read a new sector
-            if (sector != invalid_sector) {
-                // get the start address of the next sector
-                const uint32_t address = (sector * SectorSize);
+            // check if we should write back the entry we are replacing
+            if (entries[victim].sector != invalid_sector && entries[victim].dirty) {
+                write_sector(victim);
+            }
 
-                // read the data from the sector
-                Memory::read(address, buffer, sizeof(buffer));
+            // read the data from the sector
+            Memory::read(sector * SectorSize, buffer[victim], SectorSize);
 
-                // update the current sector and clear the dirty flag
-                current_sector = sector;
-                dirty = false;
-            }
+            // update the entry
+            entries[victim].sector = sector;
+            entries[victim].last_used = access_counter;
+            entries[victim].dirty = false;
 
-            return true;
+            return victim;
         }
 
     public:
@@ -658,11 +726,12 @@ namespace klib::usb::msc::bot {
          *
          */
         static void init() {
-            // mark the current sector as invalid
-            current_sector = invalid_sector;
-
-            // clear the dirty flag as we did not do anything yet
-            dirty = false;
+            // mark all the cached sectors as invalid
+            for (auto &e : entries) {
+                e.sector = invalid_sector;
+                e.last_used = 0;
+                e.dirty = false;
+            }
 
             // initialize the memory
             Memory::init();
@@ -683,11 +752,61 @@ namespace klib::usb::msc::bot {
          * @return false
          */
         static bool stop() {
-            // stop any pending transactions and make sure to write the
-            // last sector we wrote to if it is dirty
-            get_sector(invalid_sector);
+            // stop any pending transactions and make sure to write
+            // all the sectors we wrote to
+            return flush();
+        }
 
-            return true;
+        /**
+         * @brief Write all the dirty sectors in the cache to the memory.
+         * Sectors are written in address order. Can be called from the
+         * idle loop to write back data while the host is not doing
+         * anything
+         *
+         * @return true
+         * @return false
+         */
+        static bool flush() {
+            // write the dirty entries from the lowest to the highest
+            // sector. The amount of entries is small so a selection
+            // of the lowest sector every iteration is fine
+            while (true) {
+                uint32_t index = invalid_sector;
+
+                for (uint32_t i = 0; i < CacheSize; i++) {
+                    if (!entries[i].dirty || entries[i].sector == invalid_sector) {
+                        continue;
+                    }
+
+                    if (index == invalid_sector || entries[i].sector < entries[index].sector) {
+                        index = i;
+                    }
+                }
+
+                // check if we are done
+                if (index == invalid_sector) {
+                    return true;
+                }
+
+                write_sector(index);
+            }
+        }
+
+        /**
+         * @brief Returns if there is data in the cache that is
+         * not written to the memory yet
+         *
+         * @return true
+         * @return false
+         */
+        static bool is_dirty() {
+            for (const auto &e : entries) {
+                if (e.dirty) {
+                    return true;
+                }
+            }
+
+            return false;
         }
 
         /**
@@ -743,12 +862,10 @@ namespace klib::usb::msc::bot {
          */
         static bool read(uint8_t *const data, const uint32_t address, const uint16_t size) {
             // get the sector from memory
-            if (!get_sector(address / SectorSize)) {
-                return false;
-            }
+            const uint32_t index = get_sector(address / SectorSize);
 
             // copy the data from the buffer to the destination
-            std::copy_n(&buffer[address & (SectorSize - 1)], size, data);
+            std::copy_n(&buffer[index][address & (SectorSize - 1)], size, data);
 
             // return we are good
             return true;
@@ -766,16 +883,14 @@ namespace klib::usb::msc::bot {
          */
         static bool write(uint8_t *const data, const uint32_t address, const uint16_t size) {
             // get the sector
-            if (!get_sector(address / SectorSize)) {
-                return false;
-            }
+            const uint32_t index = get_sector(address / SectorSize);
 
             // copy the data from the buffer to the destination
-            std::copy_n(data, size, &buffer[address & (SectorSize - 1)]);
+            std::copy_n(data, size, &buffer[index][address & (SectorSize - 1)]);
 
             // mark the sector as dirty so we will write it when
-            // we change sectors
-            dirty = true;
+            // it gets evicted or when the cache is flushed
+            entries[index].dirty = true;
 
             // return we are good
             return true;
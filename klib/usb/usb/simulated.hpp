@@ -0,0 +1,708 @@
+#ifndef KLIB_USB_SIMULATED_HPP
+#define KLIB_USB_SIMULATED_HPP
+
+#include <span>
+#include <algorithm>
+
+#include <klib/math.hpp>
+
+#include "usb.hpp"
+#include "size.hpp"
+
+namespace klib::usb::detail::simulated {
+    /**
+     * @brief Struct to store the state of a simulated endpoint
+     *
+     */
+    struct state {
+        // flag if the endpoint is busy
+        bool is_busy;
+
+        // flag if the endpoint is stalled
+        bool is_stalled;
+
+        // max size of the endpoint
+        uint16_t max_size;
+
+        // pointer to the data
+        uint8_t *data;
+
+        // requested size of the current endpoint
+        uint32_t requested_size;
+
+        // maximum requested size. (only used on out endpoints)
+        uint32_t max_requested_size;
+
+        // transmitted/received amount of data.
+        uint32_t transferred_size;
+
+        // callback function
+        klib::usb::usb::usb_callback callback;
+    };
+}
+
+namespace klib::usb {
+    /**
+     * @brief Simulated usb device controller. Implements the same
+     * interface as the hardware usb drivers so every device in
+     * klib/usb/device can run without hardware. The host side is
+     * scripted using the control, in and out functions. These
+     * functions call the device callbacks directly (the same way
+     * the usb interrupt would on hardware).
+     *
+     * @details every packet that is transferred increments a
+     * simulated bus time using the per packet latency and the bus
+     * bandwidth. This can be used to measure the throughput and
+     * latency of a device implementation.
+     *
+     * @tparam Device
+     * @tparam EndpointCount
+     */
+    template <typename Device, uint8_t EndpointCount = 16>
+    class simulated {
+    public:
+        // amount of endpoints supported by the simulated controller
+        constexpr static uint8_t endpoint_count = EndpointCount;
+
+        // maximum endpoint sizes (full speed)
+        constexpr static klib::usb::endpoint_size_type<64, 1023, 64, 64> max_endpoint_size = {};
+
+        // type to use in device functions
+        using usb_type = simulated<Device, EndpointCount>;
+
+        // type so the klib usb driver can comunicate to the device
+        using device = Device;
+
+        /**
+         * @brief Result of a host transaction
+         *
+         */
+        enum class result {
+            ack,
+            nak,
+            stall
+        };
+
+        /**
+         * @brief Result and the amount of data of a host transaction
+         *
+         */
+        struct transaction {
+            // the handshake of the transaction
+            result handshake;
+
+            // the amount of data transferred
+            uint32_t size;
+        };
+
+        // overhead of every packet on the bus in nanoseconds
+        static inline uint32_t packet_latency = 1'000;
+
+        // bandwidth of the bus in bytes per second (12 mbit)
+        static inline uint32_t bandwidth = 1'500'000;
+
+    protected:
+        // check if the device has the usb bus reset callback
+        constexpr static bool has_bus_reset_callback = requires() {
+            device::template bus_reset<usb_type>();
+        };
+
+        // check if the device has the usb disconnected callback
+        constexpr static bool has_disconnected_callback = requires() {
+            device::template disconnected<usb_type>();
+        };
+
+        // check if the device has the usb connected callback
+        constexpr static bool has_connected_callback = requires() {
+            device::template connected<usb_type>();
+        };
+
+        // state of every endpoint. The out endpoint is at index 0
+        // and the in endpoint at index 1
+        static inline detail::simulated::state state[endpoint_count][2] = {};
+
+        // simulated bus time in nanoseconds
+        static inline uint64_t time = 0;
+
+        // device address set by the host
+        static inline uint8_t address = 0;
+
+        // flags if the device is connected and configured
+        static inline bool is_connected = false;
+        static inline bool is_configured = false;
+
+        // handshake of the status stage of the current control
+        // transfer. Set when the device acks or stalls endpoint 0
+        static inline result control_status = result::nak;
+
+        /**
+         * @brief Get the state of a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         * @return detail::simulated::state&
+         */
+        static detail::simulated::state& get_state(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            return state[endpoint][mode == klib::usb::usb::endpoint_mode::in];
+        }
+
+        /**
+         * @brief Add the time of a packet with size to the bus time
+         *
+         * @param size
+         */
+        static void add_packet_time(const uint32_t size) {
+            time += packet_latency + ((static_cast<uint64_t>(size) * 1'000'000'000) / bandwidth);
+        }
+
+        static void clear_endpoint_state(detail::simulated::state& s) {
+            s.is_busy = false;
+            s.requested_size = 0;
+            s.transferred_size = 0;
+            s.callback = nullptr;
+            s.data = nullptr;
+        }
+
+        /**
+         * @brief Clear the endpoint and call the callback with the
+         * error code
+         *
+         * @param endpoint
+         * @param mode
+         * @param error_code
+         */
+        static void finish(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode, const klib::usb::usb::error error_code) {
+            auto& s = get_state(endpoint, mode);
+
+            // get the callback
+            const auto callback = s.callback;
+
+            // get the amount of data we have transferred
+            const auto transferred = s.transferred_size;
+
+            // clear the state of the endpoint
+            clear_endpoint_state(s);
+
+            // check for any callbacks
+            if (callback) {
+                callback(endpoint, mode, error_code, transferred);
+            }
+        }
+
+    public:
+        /**
+         * @brief Initialize the simulated usb controller. Resets the
+         * simulated bus and initializes the device.
+         *
+         * @tparam UsbConnect
+         */
+        template <bool UsbConnect = true>
+        static void init() {
+            // reset all the info stored about the endpoints
+            for (uint32_t i = 0; i < endpoint_count; i++) {
+                for (auto& s : state[i]) {
+                    clear_endpoint_state(s);
+
+                    s.is_stalled = false;
+                    s.max_size = (i == 0) ? max_endpoint_size.size(
+                        0, klib::usb::descriptor::transfer_type::control
+                    ) : 0;
+                }
+            }
+
+            // reset the bus
+            time = 0;
+            address = 0;
+            is_configured = false;
+
+            // init the device
+            device::template init<usb_type>();
+
+            // check if we should connect directly
+            if constexpr (UsbConnect) {
+                connect();
+            }
+        }
+
+        /**
+         * @brief Function to check if a endpoint with type is supported at compile time
+         *
+         * @tparam endpoint
+         * @tparam type
+         */
+        template <uint8_t endpoint, klib::usb::descriptor::transfer_type type>
+        constexpr static bool is_valid_endpoint() {
+            // make sure the endpoint is valid
+            if (endpoint >= endpoint_count) {
+                return false;
+            }
+
+            // only the first endpoint supports control transfers
+            return (endpoint == 0) == (type == klib::usb::descriptor::transfer_type::control);
+        }
+
+        /**
+         * @brief Function that gets called to notify the driver
+         * the devices is configured
+         *
+         * @param cfg
+         */
+        static void configured(const bool cfg) {
+            is_configured = cfg;
+        }
+
+        /**
+         * @brief Configure a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         * @param type
+         * @param size
+         */
+        static void configure(
+            const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode,
+            const klib::usb::descriptor::transfer_type type, const uint32_t size)
+        {
+            // set the new endpoint size
+            get_state(endpoint, mode).max_size = klib::min(size, max_endpoint_size.size(endpoint, type));
+
+            // reset the endpoint
+            reset(endpoint, mode);
+        }
+
+        /**
+         * @brief Set the device address
+         *
+         * @param address
+         */
+        static klib::usb::usb::handshake set_device_address(const uint8_t address) {
+            usb_type::address = address;
+
+            // ack the set device address
+            return klib::usb::usb::handshake::ack;
+        }
+
+        /**
+         * @brief Reset a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         */
+        static void reset(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            // clear the stall
+            get_state(endpoint, mode).is_stalled = false;
+
+            // send a error to the callback
+            finish(endpoint, mode, klib::usb::usb::error::reset);
+        }
+
+        /**
+         * @brief Connect the device to the simulated host
+         *
+         */
+        static void connect() {
+            is_connected = true;
+
+            // notify the device
+            if constexpr (has_connected_callback) {
+                device::template connected<usb_type>();
+            }
+        }
+
+        /**
+         * @brief Disconnect the device from the simulated host
+         *
+         */
+        static void disconnect() {
+            is_connected = false;
+
+            // notify the device
+            if constexpr (has_disconnected_callback) {
+                device::template disconnected<usb_type>();
+            }
+        }
+
+        /**
+         * @brief Ack a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         */
+        static void ack(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            // a ack is a zero length packet on the bus
+            add_packet_time(0);
+
+            // check if this is the status stage of a control transfer
+            if (endpoint == klib::usb::usb::control_endpoint) {
+                control_status = result::ack;
+            }
+        }
+
+        /**
+         * @brief Stall a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         */
+        static void stall(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            get_state(endpoint, mode).is_stalled = true;
+
+            // check if this is the status stage of a control transfer
+            if (endpoint == klib::usb::usb::control_endpoint) {
+                control_status = result::stall;
+            }
+
+            // send a error to the callback
+            finish(endpoint, mode, klib::usb::usb::error::stall);
+        }
+
+        /**
+         * @brief Unstall a endpoint
+         *
+         * @param endpoint
+         * @param mode
+         */
+        static void un_stall(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            // check if we are stalled
+            if (!is_stalled(endpoint, mode)) {
+                // we are not stalled return
+                return;
+            }
+
+            get_state(endpoint, mode).is_stalled = false;
+
+            // send a error to the callback
+            finish(endpoint, mode, klib::usb::usb::error::un_stall);
+        }
+
+        /**
+         * @brief returns if a endpoint is stalled
+         *
+         * @param endpoint
+         * @param mode
+         * @return true
+         * @return false
+         */
+        static bool is_stalled(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            return get_state(endpoint, mode).is_stalled;
+        }
+
+        /**
+         * @brief Write data to an endpoint. The data is transferred
+         * when the host reads the endpoint.
+         *
+         * @warning Buffers should be valid until the callback function is called
+         *
+         * @param callback
+         * @param endpoint
+         * @param mode
+         * @param data
+         * @return true
+         * @return false
+         */
+        static bool write(const klib::usb::usb::usb_callback callback, const uint8_t endpoint,
+                          const klib::usb::usb::endpoint_mode mode, const std::span<const uint8_t>& data)
+        {
+            auto& s = get_state(endpoint, klib::usb::usb::endpoint_mode::in);
+
+            // set the endpoint callback and mark the endpoint as busy
+            s.is_busy = true;
+            s.callback = callback;
+
+            // we remove the const here as we know we dont write to it
+            s.data = const_cast<uint8_t*>(data.data());
+
+            // set the endpoint data
+            s.requested_size = data.size();
+            s.transferred_size = 0;
+
+            // notify everything is correct
+            return true;
+        }
+
+        /**
+         * @brief Read data from a endpoint. Data is only valid when the callback is called.
+         *
+         * @warning Buffers should be valid until the callback function is called
+         *
+         * @param callback
+         * @param endpoint
+         * @param mode
+         * @param data
+         * @return true
+         * @return false
+         */
+        static bool read(const klib::usb::usb::usb_callback callback, const uint8_t endpoint,
+                         const klib::usb::usb::endpoint_mode mode, const std::span<uint8_t>& data)
+        {
+            // call read with a fixed size
+            return read(callback, endpoint, mode, data.data(), data.size(), data.size());
+        }
+
+        /**
+         * @brief Read data from a endpoint. Data is only valid when the callback is called. Has a
+         * min size and max size for dynamic data length.
+         *
+         * @warning Buffers should be valid until the callback function is called
+         *
+         * @param callback
+         * @param endpoint
+         * @param mode
+         * @param data
+         * @param min_size
+         * @param max_size
+         * @return true
+         * @return false
+         */
+        static bool read(const klib::usb::usb::usb_callback callback, const uint8_t endpoint,
+                         const klib::usb::usb::endpoint_mode mode, uint8_t *const data,
+                         const uint32_t min_size, const uint32_t max_size)
+        {
+            auto& s = get_state(endpoint, klib::usb::usb::endpoint_mode::out);
+
+            // set the endpoint callback
+            s.callback = callback;
+            s.data = data;
+
+            // set the endpoint data
+            s.requested_size = min_size;
+            s.max_requested_size = max_size;
+            s.transferred_size = 0;
+
+            // mark the endpoint as busy
+            s.is_busy = true;
+
+            // notify everything is correct
+            return true;
+        }
+
+        /**
+         * @brief Returns if a endpoint has a pending transmission
+         *
+         * @param endpoint
+         * @param mode
+         * @return true
+         * @return false
+         */
+        static bool is_pending(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            return get_state(endpoint, mode).is_busy;
+        }
+
+        /**
+         * @brief Cancel a pending transaction
+         *
+         * @param endpoint
+         * @param mode
+         */
+        static void cancel(const uint8_t endpoint, const klib::usb::usb::endpoint_mode mode) {
+            finish(endpoint, mode, klib::usb::usb::error::cancel);
+        }
+
+    public:
+        /**
+         * @brief Simulated host functions. Should not be called
+         * by the device
+         *
+         */
+
+        /**
+         * @brief Reset the bus. Cancels all the pending transfers and
+         * notifies the device
+         *
+         */
+        static void bus_reset() {
+            // reset all the endpoints
+            for (uint32_t i = 0; i < endpoint_count; i++) {
+                reset(i, klib::usb::usb::endpoint_mode::out);
+                reset(i, klib::usb::usb::endpoint_mode::in);
+            }
+
+            address = 0;
+            is_configured = false;
+
+            // notify the device
+            if constexpr (has_bus_reset_callback) {
+                device::template bus_reset<usb_type>();
+            }
+        }
+
+        /**
+         * @brief Send a in token to a endpoint. Receives a single
+         * packet from the device.
+         *
+         * @param endpoint
+         * @param data
+         * @return transaction
+         */
+        static transaction in(const uint8_t endpoint, const std::span<uint8_t> data) {
+            auto& s = get_state(endpoint, klib::usb::usb::endpoint_mode::in);
+
+            // check if the endpoint is stalled
+            if (s.is_stalled) {
+                return {result::stall, 0};
+            }
+
+            // check if the device has data for us
+            if (!is_connected || !s.is_busy) {
+                // a nak still uses the bus
+                add_packet_time(0);
+
+                return {result::nak, 0};
+            }
+
+            // get the size of the packet
+            const uint32_t size = klib::min(klib::min(
+                s.requested_size - s.transferred_size,
+                static_cast<uint32_t>(s.max_size)), data.size()
+            );
+
+            // copy the data to the host
+            std::copy_n(s.data + s.transferred_size, size, data.data());
+            s.transferred_size += size;
+
+            add_packet_time(size);
+
+            // check if we are done
+            if (s.transferred_size >= s.requested_size) {
+                finish(endpoint, klib::usb::usb::endpoint_mode::in, klib::usb::usb::error::no_error);
+            }
+
+            return {result::ack, size};
+        }
+
+        /**
+         * @brief Send a single packet to a out endpoint
+         *
+         * @param endpoint
+         * @param data
+         * @return transaction
+         */
+        static transaction out(const uint8_t endpoint, const std::span<const uint8_t> data) {
+            auto& s = get_state(endpoint, klib::usb::usb::endpoint_mode::out);
+
+            // check if the endpoint is stalled
+            if (s.is_stalled) {
+                return {result::stall, 0};
+            }
+
+            // get the size of the packet
+            const uint32_t packet = klib::min(data.size(), static_cast<uint32_t>(s.max_size));
+
+            // the packet is always send over the bus
+            add_packet_time(packet);
+
+            // check if the device can receive data
+            if (!is_connected || !s.is_busy) {
+                return {result::nak, 0};
+            }
+
+            // copy the data to the device. Data that does not fit is
+            // discarded the same way as on hardware
+            const uint32_t size = klib::min(packet, s.max_requested_size - s.transferred_size);
+
+            std::copy_n(data.data(), size, s.data + s.transferred_size);
+            s.transferred_size += size;
+
+            // check if we are done. A short packet ends the transfer the
+            // same way as on hardware
+            if (s.transferred_size >= s.requested_size || packet < s.max_size) {
+                finish(endpoint, klib::usb::usb::endpoint_mode::out, klib::usb::usb::error::no_error);
+            }
+
+            return {result::ack, size};
+        }
+
+        /**
+         * @brief Execute a control transfer on the control endpoint.
+         * Sends the setup packet, executes the data stage using the
+         * data buffer and returns the status of the status stage
+         *
+         * @param packet
+         * @param data
+         * @return transaction
+         */
+        static transaction control(const setup_packet &packet, const std::span<uint8_t> data = {}) {
+            // a setup packet clears a stall on the control endpoint
+            for (auto& s : state[klib::usb::usb::control_endpoint]) {
+                s.is_stalled = false;
+            }
+
+            // reset the status of the status stage
+            control_status = result::nak;
+
+            // send the setup packet to the device
+            add_packet_time(sizeof(packet));
+            klib::usb::usb::handle_setup_packet<usb_type>(packet);
+
+            // get the size of the data stage
+            const uint32_t length = klib::min(static_cast<uint32_t>(packet.wLength), data.size());
+            uint32_t transferred = 0;
+
+            // execute the data stage until the device stops or is done. Some
+            // devices ack the status before the data stage is done
+            while (transferred < length && control_status != result::stall) {
+                transaction r;
+
+                if (klib::usb::usb::get_direction(packet) == setup::direction::device_to_host) {
+                    r = in(klib::usb::usb::control_endpoint, data.subspan(transferred));
+                }
+                else {
+                    r = out(klib::usb::usb::control_endpoint, data.subspan(transferred));
+                }
+
+                // stop when the device naks or stalls the data stage
+                if (r.handshake != result::ack) {
+                    return {(control_status == result::stall) ? result::stall : r.handshake, transferred};
+                }
+
+                transferred += r.size;
+
+                // a short packet ends the data stage
+                if (r.size < state[klib::usb::usb::control_endpoint][0].max_size) {
+                    break;
+                }
+            }
+
+            return {control_status, transferred};
+        }
+
+        /**
+         * @brief Returns the address set by the host
+         *
+         * @return uint8_t
+         */
+        static uint8_t get_address() {
+            return address;
+        }
+
+        /**
+         * @brief Returns if the device has marked itself as
+         * configured
+         *
+         * @return true
+         * @return false
+         */
+        static bool get_configured() {
+            return is_configured;
+        }
+
+        /**
+         * @brief Returns the simulated bus time in nanoseconds
+         *
+         * @return uint64_t
+         */
+        static uint64_t elapsed() {
+            return time;
+        }
+
+        /**
+         * @brief Clear the simulated bus time
+         *
+         */
+        static void clear_elapsed() {
+            time = 0;
+        }
+    };
+}
+
+#endif
@@ -1,18 +1,34 @@
 #ifndef KLIB_RTOS_BASE_TASK_HPP
 #define KLIB_RTOS_BASE_TASK_HPP
 
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 
 #include <klib/units.hpp>
 
-#include "waitable.hpp"
+#include "intrusive_list.hpp"
+
+namespace klib::rtos {
+    // forward declaration of the waitable
+    class waitable;
+}
 
 namespace klib::rtos::detail {
+    // amount of priorities supported by the scheduler. Every priority
+    // has a bit in the ready bitmap
+    constexpr static uint32_t max_priority = 32;
+
+    // forward declaration of the task list
+    class task_list;
+
+    // forward declaration of the event group wait request
+    struct event_wait;
+
     /**
      * @brief Task to run in the RTOS
-     * 
-     * @tparam StackSize 
+     *
+     * @tparam StackSize
      */
     class base_task {
     public:
@@ -22,6 +38,10 @@ namespace klib::rtos::detail {
         // flag indicating if the task is sleeping
         bool is_sleeping;
 
+        // flag if the task was woken up while it was not sleeping. The
+        // next sleep of the task returns directly
+        bool wakeup_pending;
+
         // wakeup time for the task
         klib::time::ms wakup_time;
 
@@ -34,20 +54,68 @@ namespace klib::rtos::detail {
         // the base priority of the task
         const uint8_t priority;
 
+        // links for the list the task is in (ready, sleeping or the
+        // wait queue of a waitable). A task is always in at most one
+        // list
+        base_task* next;
+        base_task* previous;
+
+        // the list the task is in. nullptr when the task is not
+        // added to the scheduler
+        task_list* list;
+
+        // first object in the list of objects with a owner the task
+        // holds. Used to restore the priority of the task
+        klib::rtos::waitable* held;
+
+        // notification word of the task. Can be changed from
+        // interrupts without a syscall
+        std::atomic<uint32_t> notification;
+
+        // flag if the task is blocked until it gets a notification
+        std::atomic<bool> notify_waiting;
+
+        // link for the list of tasks that need to be made ready by
+        // the scheduler
+        base_task* deferred_next;
+
+        // request of the event group the task is waiting on
+        event_wait* events;
+
         /**
          * @brief Construct a new base task
-         * 
-         * @param priority 
+         *
+         * @param priority
          */
-        base_task(uint8_t priority = 0): 
+        base_task(uint8_t priority = 0):
             waitable(nullptr),
             is_sleeping(false),
+            wakeup_pending(false),
             wakup_time(0),
             stack_pointer(nullptr),
             current_priority(priority),
-            priority(priority)
+            priority(priority),
+            next(nullptr),
+            previous(nullptr),
+            list(nullptr),
+            held(nullptr),
+            notification(0),
+            notify_waiting(false),
+            deferred_next(nullptr),
+            events(nullptr)
         {}
     };
+
+    // the task that is running at the moment. Updated by the
+    // scheduler on every context switch
+    inline base_task* current_task = nullptr;
+
+    /**
+     * @brief Intrusive doubly linked list of tasks. Uses the links
+     * in the task so no memory is allocated
+     *
+     */
+    class task_list: public intrusive_list<base_task, task_list> {};
 }
 
 #endif
\ No newline at end of file
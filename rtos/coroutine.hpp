@@ -0,0 +1,588 @@
+#ifndef KLIB_RTOS_COROUTINE_HPP
+#define KLIB_RTOS_COROUTINE_HPP
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+#include <klib/math.hpp>
+#include <klib/units.hpp>
+
+#include "intrusive_list.hpp"
+#include "mutex.hpp"
+#include "syscall.hpp"
+#include "task.hpp"
+
+// size of a single coroutine frame in bytes. Every coroutine uses a
+// block of this size
+#ifndef KLIB_RTOS_COROUTINE_FRAME_SIZE
+    #define KLIB_RTOS_COROUTINE_FRAME_SIZE 256
+#endif
+
+// amount of coroutine frames that can be allocated at the same time
+#ifndef KLIB_RTOS_COROUTINE_FRAMES
+    #define KLIB_RTOS_COROUTINE_FRAMES 16
+#endif
+
+namespace klib::rtos::co {
+    // forward declaration of the coroutine task
+    class task;
+}
+
+namespace klib::rtos::co::detail {
+    // forward declarations for the promise
+    class executor_base;
+    class coroutine_list;
+
+    /**
+     * @brief Pool with fixed size blocks for the coroutine frames. Uses
+     * a atomic bitmap so frames can be allocated from any task
+     *
+     */
+    class frame_pool {
+    public:
+        // size of a frame and the amount of frames in the pool
+        constexpr static uint32_t frame_size = KLIB_RTOS_COROUTINE_FRAME_SIZE;
+        constexpr static uint32_t frame_count = KLIB_RTOS_COROUTINE_FRAMES;
+
+    protected:
+        // make sure every frame has a bit in the bitmap
+        static_assert(frame_count > 0 && frame_count <= 32, "Coroutine frame count needs to be between 1 and 32");
+
+        // make sure every frame is aligned
+        static_assert((frame_size % alignof(std::max_align_t)) == 0, "Coroutine frame size needs to be a multiple of the max alignment");
+
+        // mask with a bit for every frame
+        constexpr static uint32_t mask = (frame_count == 32) ? 0xffffffff : ((0x1 << frame_count) - 1);
+
+        // the memory of the frames
+        alignas(std::max_align_t) static inline uint8_t frames[frame_count][frame_size] = {};
+
+        // bitmap with the frames that are used
+        static inline std::atomic<uint32_t> used = 0;
+
+        // largest frame that was requested
+        static inline std::atomic<uint32_t> largest = 0;
+
+    public:
+        /**
+         * @brief Allocate a frame
+         *
+         * @param size
+         * @return void* nullptr when the frame does not fit or no
+         * frame is available
+         */
+        static void* allocate(const size_t size) {
+            // store the largest frame size so it can be checked
+            // against the frame size
+            uint32_t current = largest.load();
+
+            while (size > current && !largest.compare_exchange_weak(current, size)) {
+                // retry until the value is updated
+            }
+
+            // check if the frame fits
+            if (size > frame_size) {
+                return nullptr;
+            }
+
+            uint32_t bitmap = used.load();
+
+            while (true) {
+                const uint32_t available = ~bitmap & mask;
+
+                // check if we have any frame available
+                if (!available) {
+                    return nullptr;
+                }
+
+                // try to claim the first available frame
+                const uint32_t index = klib::ctz(available);
+
+                if (used.compare_exchange_weak(bitmap, bitmap | (0x1 << index))) {
+                    return frames[index];
+                }
+            }
+        }
+
+        /**
+         * @brief Free a frame
+         *
+         * @param ptr
+         */
+        static void deallocate(void* ptr) {
+            const uint32_t index = (static_cast<uint8_t*>(ptr) - &frames[0][0]) / frame_size;
+
+            used.fetch_and(~(0x1 << index));
+        }
+
+        /**
+         * @brief Get the size of the largest frame that was requested.
+         * Coroutines with a frame larger than frame_size cannot be
+         * created
+         *
+         * @return uint32_t
+         */
+        static uint32_t largest_frame() {
+            return largest.load();
+        }
+
+        /**
+         * @brief Get the amount of frames that are used
+         *
+         * @return uint32_t
+         */
+        static uint32_t used_frames() {
+            return klib::popcount(used.load());
+        }
+    };
+
+    /**
+     * @brief Promise of a coroutine task
+     *
+     */
+    class promise {
+    public:
+        // links for the list the coroutine is in (ready, delayed or the
+        // waiters of a object)
+        promise* next = nullptr;
+        promise* previous = nullptr;
+        coroutine_list* list = nullptr;
+
+        // executor that runs the coroutine
+        executor_base* executor = nullptr;
+
+        // coroutine that awaits this coroutine. nullptr for coroutines
+        // that are spawned on a executor
+        std::coroutine_handle<> continuation = nullptr;
+
+        // time the coroutine is resumed when it is delayed
+        klib::time::ms wakeup = 0;
+
+        /**
+         * @brief Awaiter for the end of the coroutine. Resumes the
+         * coroutine that awaits this coroutine
+         *
+         */
+        struct final_awaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise> handle) noexcept;
+
+            void await_resume() noexcept {}
+        };
+
+        /**
+         * @brief Allocate the frame of the coroutine from the frame pool
+         *
+         * @param size
+         * @return void*
+         */
+        static void* operator new(const size_t size) noexcept {
+            return frame_pool::allocate(size);
+        }
+
+        /**
+         * @brief Free the frame of the coroutine
+         *
+         * @param ptr
+         */
+        static void operator delete(void* ptr) noexcept {
+            frame_pool::deallocate(ptr);
+        }
+
+        // functions for the coroutine
+        static co::task get_return_object_on_allocation_failure() noexcept;
+        co::task get_return_object() noexcept;
+
+        std::suspend_always initial_suspend() noexcept {
+            // coroutines only run on the executor
+            return {};
+        }
+
+        final_awaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {}
+    };
+
+    /**
+     * @brief Intrusive doubly linked list of coroutines
+     *
+     */
+    class coroutine_list: public rtos::detail::intrusive_list<promise, coroutine_list> {};
+}
+
+namespace klib::rtos::co {
+    /**
+     * @brief Coroutine task. A coroutine that returns this type can be
+     * spawned on a executor or awaited by another coroutine. The frame
+     * of the coroutine is allocated from a pool with blocks of
+     * KLIB_RTOS_COROUTINE_FRAME_SIZE bytes.
+     *
+     */
+    class task {
+    public:
+        // using for the coroutine
+        using promise_type = detail::promise;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+    protected:
+        // handle to the coroutine we own
+        handle_type handle;
+
+    public:
+        /**
+         * @brief Construct a new task
+         *
+         * @param handle
+         */
+        explicit task(const handle_type handle = nullptr):
+            handle(handle)
+        {}
+
+        // tasks can only be moved
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+
+        task(task&& other) noexcept:
+            handle(other.release())
+        {}
+
+        task& operator=(task&& other) noexcept {
+            if (this != &other) {
+                if (handle) {
+                    handle.destroy();
+                }
+
+                handle = other.release();
+            }
+
+            return *this;
+        }
+
+        /**
+         * @brief Destroy the task. Destroys the coroutine if we still
+         * own it
+         *
+         */
+        ~task() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        /**
+         * @brief Returns if the coroutine was created. Returns false
+         * when no frame was available
+         *
+         * @return true
+         * @return false
+         */
+        bool valid() const {
+            return static_cast<bool>(handle);
+        }
+
+        /**
+         * @brief Release the ownership of the coroutine
+         *
+         * @return handle_type
+         */
+        handle_type release() {
+            const handle_type h = handle;
+            handle = nullptr;
+
+            return h;
+        }
+
+        /**
+         * @brief Await the coroutine from another coroutine. Runs the
+         * coroutine on the executor of the caller and resumes the
+         * caller when the coroutine is done
+         *
+         * @return auto
+         */
+        auto operator co_await() && noexcept {
+            struct awaiter {
+                handle_type child;
+
+                bool await_ready() noexcept {
+                    // nothing to run when the coroutine was not created
+                    return !child;
+                }
+
+                std::coroutine_handle<> await_suspend(const handle_type parent) noexcept {
+                    child.promise().continuation = parent;
+                    child.promise().executor = parent.promise().executor;
+
+                    // start the coroutine directly
+                    return child;
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            return awaiter{handle};
+        }
+    };
+}
+
+namespace klib::rtos::co::detail {
+    /**
+     * @brief Executor that runs coroutines in a single rtos task
+     *
+     * @details coroutines are resumed from the ready list. Coroutines
+     * that are made ready by other tasks are posted and moved to the
+     * ready list by the executor. When nothing is ready the task
+     * sleeps until the first delayed coroutine. Posting a coroutine
+     * wakes the task up.
+     *
+     */
+    class executor_base {
+    protected:
+        // coroutines that can be resumed
+        coroutine_list ready = {};
+
+        // delayed coroutines sorted on wakeup time
+        coroutine_list delayed = {};
+
+        // coroutines that were made ready by other tasks
+        coroutine_list posted = {};
+
+        // mutex to protect the posted list
+        rtos::mutex lock;
+
+        // amount of spawned coroutines that have not finished
+        std::atomic<uint32_t> active = 0;
+
+        // the task that runs the coroutines
+        rtos::detail::base_task* runner = nullptr;
+
+        /**
+         * @brief Resume the ready coroutines. Sleeps when no coroutine
+         * is ready
+         *
+         */
+        void run_once() {
+            // move the coroutines that were posted by other tasks
+            lock.lock();
+
+            while (!posted.empty()) {
+                ready.push_back(posted.pop_front());
+            }
+
+            lock.unlock();
+
+            // move the delayed coroutines that need to run
+            const klib::time::ms now = syscall::get_time();
+
+            while (!delayed.empty() && delayed.front()->wakeup <= now) {
+                ready.push_back(delayed.pop_front());
+            }
+
+            // check if we have anything to run
+            if (ready.empty()) {
+                // sleep until the first delayed coroutine. Posting a
+                // coroutine wakes us up
+                syscall::sleep(
+                    delayed.empty() ? klib::time::ms(0x7fffffff) : (delayed.front()->wakeup - now)
+                );
+
+                return;
+            }
+
+            // resume all the ready coroutines. Coroutines that are made
+            // ready while running are posted or delayed, so this ends
+            while (!ready.empty()) {
+                promise *const p = ready.pop_front();
+
+                std::coroutine_handle<promise>::from_promise(*p).resume();
+            }
+        }
+
+    public:
+        /**
+         * @brief Spawn a coroutine on the executor. The executor owns
+         * the coroutine after this and destroys it when it is done
+         *
+         * @param task
+         * @return true
+         * @return false when the coroutine was not created
+         */
+        bool spawn(co::task&& task) {
+            if (!task.valid()) {
+                return false;
+            }
+
+            const co::task::handle_type handle = task.release();
+
+            handle.promise().executor = this;
+            active++;
+
+            post(&handle.promise());
+
+            return true;
+        }
+
+        /**
+         * @brief Resume a coroutine on the executor. Can be called
+         * from any task
+         *
+         * @param p
+         */
+        void post(promise* p) {
+            lock.lock();
+            posted.push_back(p);
+            lock.unlock();
+
+            // wake the executor if it is sleeping
+            syscall::wakeup(runner);
+        }
+
+        /**
+         * @brief Resume a coroutine after a amount of time. Should
+         * only be called from the executor
+         *
+         * @param p
+         * @param time
+         */
+        void delay(promise* p, const klib::time::ms time) {
+            p->wakeup = syscall::get_time() + time;
+
+            // search the first coroutine that wakes up after this one
+            promise* position = delayed.front();
+
+            while (position != nullptr && position->wakeup <= p->wakeup) {
+                position = position->next;
+            }
+
+            delayed.insert(position, p);
+        }
+
+        /**
+         * @brief Called when a spawned coroutine is done
+         *
+         */
+        void done() {
+            active--;
+        }
+
+        /**
+         * @brief Get the amount of spawned coroutines that have not
+         * finished
+         *
+         * @return uint32_t
+         */
+        uint32_t size() const {
+            return active.load();
+        }
+
+        /**
+         * @brief Get the task that runs the coroutines. Should be added
+         * to the scheduler
+         *
+         * @return rtos::detail::base_task*
+         */
+        rtos::detail::base_task* get_task() const {
+            return runner;
+        }
+    };
+
+    inline std::coroutine_handle<> promise::final_awaiter::await_suspend(std::coroutine_handle<promise> handle) noexcept {
+        promise& p = handle.promise();
+
+        // resume the coroutine that awaits us. It owns our frame
+        if (p.continuation) {
+            return p.continuation;
+        }
+
+        // we were spawned on the executor. Nobody owns our frame so
+        // we destroy it here
+        executor_base *const executor = p.executor;
+
+        handle.destroy();
+        executor->done();
+
+        return std::noop_coroutine();
+    }
+
+    inline co::task promise::get_return_object_on_allocation_failure() noexcept {
+        return co::task();
+    }
+
+    inline co::task promise::get_return_object() noexcept {
+        return co::task(std::coroutine_handle<promise>::from_promise(*this));
+    }
+}
+
+namespace klib::rtos::co {
+    /**
+     * @brief Executor that runs coroutines in a single rtos task. The
+     * task returned by get_task should be added to the scheduler
+     *
+     * @tparam Priority priority of the task
+     * @tparam StackSize stack size of the task. The coroutines do not
+     * use this stack while they are suspended
+     */
+    template <uint8_t Priority = 0, uint32_t StackSize = 128>
+    class executor: public detail::executor_base {
+    protected:
+        // the task that runs the coroutines
+        rtos::task<Priority, StackSize> worker;
+
+        /**
+         * @brief Function of the task
+         *
+         * @param self
+         */
+        static void run(executor* self) {
+            while (true) {
+                self->run_once();
+            }
+        }
+
+    public:
+        /**
+         * @brief Construct a new executor
+         *
+         */
+        executor():
+            detail::executor_base(),
+            worker(run, this)
+        {
+            runner = &worker;
+        }
+    };
+
+    /**
+     * @brief Suspend the coroutine for a amount of time
+     *
+     * @param time
+     * @return auto
+     */
+    inline auto delay(const klib::time::ms time) {
+        struct awaiter {
+            klib::time::ms time;
+
+            bool await_ready() noexcept {
+                return time.value == 0;
+            }
+
+            void await_suspend(const task::handle_type handle) noexcept {
+                handle.promise().executor->delay(&handle.promise(), time);
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        return awaiter{time};
+    }
+}
+
+#endif
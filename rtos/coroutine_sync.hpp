@@ -0,0 +1,396 @@
+#ifndef KLIB_RTOS_COROUTINE_SYNC_HPP
+#define KLIB_RTOS_COROUTINE_SYNC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <klib/ringbuffer.hpp>
+
+#include "coroutine.hpp"
+#include "mutex.hpp"
+
+namespace klib::rtos::co {
+    /**
+     * @brief Semaphore that can be awaited by coroutines. Can be
+     * released from any task or coroutine
+     *
+     */
+    class semaphore {
+    protected:
+        // mutex to protect the count and the waiters
+        rtos::mutex lock;
+
+        // amount of available resources
+        uint32_t count;
+
+        // coroutines waiting on the semaphore
+        detail::coroutine_list waiters = {};
+
+    public:
+        /**
+         * @brief Awaiter for the semaphore
+         *
+         */
+        struct awaiter {
+            semaphore& sem;
+
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            bool await_suspend(const task::handle_type handle) noexcept {
+                sem.lock.lock();
+
+                // check if we can take a resource without waiting
+                if (sem.count) {
+                    sem.count--;
+                    sem.lock.unlock();
+
+                    // resume the coroutine directly
+                    return false;
+                }
+
+                // wait until a release hands a resource to us
+                sem.waiters.push_back(&handle.promise());
+                sem.lock.unlock();
+
+                return true;
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        /**
+         * @brief Construct a new semaphore
+         *
+         * @param initial_count
+         */
+        semaphore(const uint32_t initial_count = 0):
+            count(initial_count)
+        {}
+
+        /**
+         * @brief Take a resource. Suspends the coroutine until a
+         * resource is available
+         *
+         * @return awaiter
+         */
+        awaiter acquire() {
+            return awaiter{*this};
+        }
+
+        /**
+         * @brief Try to take a resource without waiting
+         *
+         * @return true
+         * @return false
+         */
+        bool try_acquire() {
+            lock.lock();
+
+            const bool available = count > 0;
+
+            if (available) {
+                count--;
+            }
+
+            lock.unlock();
+
+            return available;
+        }
+
+        /**
+         * @brief Release a resource. Hands the resource to the first
+         * waiting coroutine
+         *
+         */
+        void release() {
+            lock.lock();
+
+            detail::promise *const p = waiters.pop_front();
+
+            // increment the count when nobody is waiting
+            if (p == nullptr) {
+                count++;
+            }
+
+            lock.unlock();
+
+            // resume the waiter on its executor
+            if (p != nullptr) {
+                p->executor->post(p);
+            }
+        }
+    };
+
+    /**
+     * @brief Event that can be awaited by coroutines. Used to signal
+     * the completion of a operation (e.g. a I/O transfer). Stays set
+     * until it is reset
+     *
+     */
+    class event {
+    protected:
+        // mutex to protect the flag and the waiters
+        rtos::mutex lock;
+
+        // flag if the event is set
+        bool flag;
+
+        // coroutines waiting on the event
+        detail::coroutine_list waiters = {};
+
+    public:
+        /**
+         * @brief Awaiter for the event
+         *
+         */
+        struct awaiter {
+            event& ev;
+
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            bool await_suspend(const task::handle_type handle) noexcept {
+                ev.lock.lock();
+
+                // check if the event is already set
+                if (ev.flag) {
+                    ev.lock.unlock();
+
+                    return false;
+                }
+
+                ev.waiters.push_back(&handle.promise());
+                ev.lock.unlock();
+
+                return true;
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        /**
+         * @brief Construct a new event
+         *
+         */
+        event():
+            flag(false)
+        {}
+
+        /**
+         * @brief Wait until the event is set
+         *
+         * @return awaiter
+         */
+        awaiter wait() {
+            return awaiter{*this};
+        }
+
+        /**
+         * @brief Set the event. Resumes all the waiting coroutines
+         *
+         */
+        void set() {
+            lock.lock();
+
+            flag = true;
+
+            // resume all the waiters on their executor
+            while (!waiters.empty()) {
+                detail::promise *const p = waiters.pop_front();
+
+                p->executor->post(p);
+            }
+
+            lock.unlock();
+        }
+
+        /**
+         * @brief Clear the event
+         *
+         */
+        void reset() {
+            lock.lock();
+            flag = false;
+            lock.unlock();
+        }
+
+        /**
+         * @brief Returns if the event is set
+         *
+         * @return true
+         * @return false
+         */
+        bool is_set() const {
+            return flag;
+        }
+    };
+
+    /**
+     * @brief Queue that can be awaited by coroutines
+     *
+     * @tparam T
+     * @tparam MaxSize
+     */
+    template <typename T, size_t MaxSize>
+    class queue {
+    protected:
+        // mutex to protect access to the queue
+        rtos::mutex mutex;
+
+        // semaphores to count available data and available space
+        co::semaphore data_available;
+        co::semaphore space_available;
+
+        // ringbuffer to store the data
+        klib::ringbuffer<T, MaxSize> buffer;
+
+        /**
+         * @brief Add a item to the buffer. Space needs to be available
+         *
+         * @param val
+         */
+        void store(const T& val) {
+            mutex.lock();
+            buffer.push(val);
+            mutex.unlock();
+
+            // signal that data is available
+            data_available.release();
+        }
+
+        /**
+         * @brief Copy and pop a item from the buffer. Data needs to
+         * be available
+         *
+         * @return T
+         */
+        T load() {
+            mutex.lock();
+            T item = buffer.copy_and_pop();
+            mutex.unlock();
+
+            // signal that space is available
+            space_available.release();
+
+            return item;
+        }
+
+    public:
+        /**
+         * @brief Construct a new queue
+         *
+         */
+        queue():
+            mutex(),
+            data_available(0),
+            space_available(MaxSize),
+            buffer()
+        {}
+
+        /**
+         * @brief Add a item to the queue. Suspends the coroutine until
+         * space is available
+         *
+         * @param val
+         * @return auto
+         */
+        auto push(const T& val) {
+            struct awaiter {
+                queue& q;
+                const T& val;
+                typename co::semaphore::awaiter space;
+
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                bool await_suspend(const task::handle_type handle) noexcept {
+                    return space.await_suspend(handle);
+                }
+
+                void await_resume() noexcept {
+                    q.store(val);
+                }
+            };
+
+            return awaiter{*this, val, space_available.acquire()};
+        }
+
+        /**
+         * @brief Copy and pop a item from the queue. Suspends the
+         * coroutine until data is available
+         *
+         * @return auto
+         */
+        auto pop() {
+            struct awaiter {
+                queue& q;
+                typename co::semaphore::awaiter data;
+
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                bool await_suspend(const task::handle_type handle) noexcept {
+                    return data.await_suspend(handle);
+                }
+
+                T await_resume() noexcept {
+                    return q.load();
+                }
+            };
+
+            return awaiter{*this, data_available.acquire()};
+        }
+
+        /**
+         * @brief Try to add a item without waiting. Can be used from
+         * a normal task
+         *
+         * @param val
+         * @return true
+         * @return false
+         */
+        bool try_push(const T& val) {
+            if (!space_available.try_acquire()) {
+                return false;
+            }
+
+            store(val);
+
+            return true;
+        }
+
+        /**
+         * @brief Try to copy and pop a item without waiting. Can be
+         * used from a normal task
+         *
+         * @param val
+         * @return true
+         * @return false
+         */
+        bool try_pop(T& val) {
+            if (!data_available.try_acquire()) {
+                return false;
+            }
+
+            val = load();
+
+            return true;
+        }
+
+        /**
+         * @brief Get the maximum size of the queue
+         *
+         * @return size_t
+         */
+        constexpr size_t max_size() const {
+            return MaxSize;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef KLIB_RTOS_DEFERRED_HPP
+#define KLIB_RTOS_DEFERRED_HPP
+
+#include <atomic>
+
+namespace klib::rtos::detail {
+    /**
+     * @brief Lock free list of items that need to be handled by the
+     * scheduler. Items can be added from interrupts and tasks. Uses
+     * the deferred_next member of the items so no memory is allocated
+     *
+     * @tparam T
+     */
+    template <typename T>
+    class deferred_list {
+    protected:
+        // last item that was added
+        std::atomic<T*> head = nullptr;
+
+    public:
+        /**
+         * @brief Add a item to the list. The item should not be in
+         * the list already
+         *
+         * @param item
+         */
+        void push(T* item) {
+            T* current = head.load();
+
+            do {
+                item->deferred_next = current;
+            } while (!head.compare_exchange_weak(current, item));
+        }
+
+        /**
+         * @brief Returns if the list has no items
+         *
+         * @return true
+         * @return false
+         */
+        bool empty() const {
+            return head.load() == nullptr;
+        }
+
+        /**
+         * @brief Take all the items from the list. The items are
+         * linked using deferred_next, the last added item first
+         *
+         * @return T*
+         */
+        T* take() {
+            return head.exchange(nullptr);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef KLIB_RTOS_EVENT_GROUP_HPP
+#define KLIB_RTOS_EVENT_GROUP_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include <rtos/rtos.hpp>
+
+#include "base_task.hpp"
+#include "deferred.hpp"
+#include "syscall.hpp"
+#include "waitable.hpp"
+
+namespace klib::rtos {
+    // forward declaration of the event group
+    class event_group;
+}
+
+namespace klib::rtos::detail {
+    /**
+     * @brief Request of a task waiting on a event group. Stored on
+     * the stack of the waiting task
+     * 
+     */
+    struct event_wait {
+        // bits the task waits on
+        uint32_t mask;
+
+        // wait until all the bits are set instead of any bit
+        bool all;
+
+        // clear the bits in the mask when the wait is done
+        bool clear;
+
+        // bits of the event group when the wait was done
+        uint32_t result;
+    };
+
+    // event groups that have bits set while tasks are waiting. The 
+    // scheduler checks the waiters of these event groups
+    inline deferred_list<rtos::event_group> signalled_groups = {};
+}
+
+namespace klib::rtos {
+    /**
+     * @brief Group of 31 event bits. Tasks can wait until any or all
+     * of a set of bits are set. Setting bits only needs a single 
+     * atomic operation when no task is waiting
+     * 
+     */
+    class event_group: public waitable {
+    public:
+        // bit that marks that tasks are waiting on the group. Cannot
+        // be used as a event
+        constexpr static uint32_t waiting_flag = (0x1 << 31);
+
+        // link for the list of event groups the scheduler needs to check
+        event_group* deferred_next = nullptr;
+
+    protected:
+        // event bits of the group and the waiting flag
+        std::atomic<uint32_t> bits;
+
+        // flag if the group is in the list of signalled groups
+        std::atomic<bool> queued;
+
+        /**
+         * @brief Returns if a request is done with the given bits
+         * 
+         * @param value 
+         * @param request 
+         * @return true 
+         * @return false 
+         */
+        static bool matches(const uint32_t value, const detail::event_wait& request) {
+            if (request.all) {
+                return (value & request.mask) == request.mask;
+            }
+
+            return (value & request.mask) != 0;
+        }
+
+        /**
+         * @brief Set bits in the group
+         * 
+         * @param value 
+         * @return true the scheduler needs to check the waiters
+         * @return false 
+         */
+        bool signal(const uint32_t value) {
+            const uint32_t previous = bits.fetch_or(value & ~waiting_flag);
+
+            // check if we have waiters
+            if (!(previous & waiting_flag)) {
+                return false;
+            }
+
+            // add the group to the list only once
+            if (queued.exchange(true)) {
+                return false;
+            }
+
+            detail::signalled_groups.push(this);
+
+            return true;
+        }
+
+    public:
+        /**
+         * @brief Construct a new event group
+         * 
+         * @param initial 
+         */
+        event_group(const uint32_t initial = 0):
+            bits(initial & ~waiting_flag),
+            queued(false)
+        {}
+
+        /**
+         * @brief Set bits in the group. Should be called from a task.
+         * Only uses a syscall when tasks are waiting
+         * 
+         * @param value 
+         */
+        void set(const uint32_t value) {
+            if (signal(value)) {
+                // let the scheduler check the waiters
+                syscall::deferred();
+            }
+        }
+
+        /**
+         * @brief Set bits in the group from a interrupt
+         * 
+         * @param value 
+         */
+        void set_from_isr(const uint32_t value) {
+            if (signal(value)) {
+                // the scheduler checks the waiters before the 
+                // context switch
+                klib::target::rtos::detail::request_switch();
+            }
+        }
+
+        /**
+         * @brief Clear bits in the group
+         * 
+         * @param value 
+         */
+        void clear(const uint32_t value) {
+            bits.fetch_and(~(value & ~waiting_flag));
+        }
+
+        /**
+         * @brief Get the bits of the group
+         * 
+         * @return uint32_t 
+         */
+        uint32_t get() const {
+            return bits.load() & ~waiting_flag;
+        }
+
+        /**
+         * @brief Wait until bits in the group are set
+         * 
+         * @param mask bits to wait on
+         * @param all wait until all the bits are set instead of any bit
+         * @param clear clear the bits in the mask when the wait is done
+         * @return uint32_t bits of the group when the wait was done
+         */
+        uint32_t wait(const uint32_t mask, const bool all = false, const bool clear = true) {
+            detail::event_wait request = {mask & ~waiting_flag, all, clear, 0};
+
+            // check if we can return without a syscall
+            uint32_t current = bits.load();
+
+            while (matches(current, request)) {
+                if (!clear || bits.compare_exchange_weak(current, current & ~request.mask)) {
+                    return current & ~waiting_flag;
+                }
+            }
+
+            // wait in the scheduler until the request is done
+            detail::base_task *const task = detail::current_task;
+
+            task->events = &request;
+            syscall::wait(*this);
+            task->events = nullptr;
+
+            return request.result;
+        }
+
+        /**
+         * @brief Function for the scheduler to check the request of a
+         * task. Marks the group as waited on when the request is not 
+         * done
+         * 
+         * @param task 
+         * @return true 
+         * @return false 
+         */
+        virtual bool try_acquire(detail::base_task* task) override {
+            detail::event_wait& request = *task->events;
+            uint32_t current = bits.load();
+
+            while (true) {
+                if (matches(current, request)) {
+                    // clear the bits if requested
+                    if (request.clear && !bits.compare_exchange_weak(current, current & ~request.mask)) {
+                        continue;
+                    }
+
+                    request.result = current & ~waiting_flag;
+
+                    return true;
+                }
+
+                // mark that a task is waiting so the next set of the 
+                // bits goes through the scheduler
+                if (bits.compare_exchange_weak(current, current | waiting_flag)) {
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * @brief Event groups are not released
+         * 
+         * @return true 
+         * @return false 
+         */
+        virtual bool release() override {
+            return true;
+        }
+
+        /**
+         * @brief Called by the scheduler before it checks the waiters 
+         * after bits were set
+         * 
+         */
+        void dequeue() {
+            queued.store(false);
+        }
+
+        /**
+         * @brief Called by the scheduler when no task is waiting
+         * anymore
+         * 
+         */
+        void clear_waiting() {
+            bits.fetch_and(~waiting_flag);
+        }
+    };
+}
+
+#endif
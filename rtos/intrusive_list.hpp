@@ -0,0 +1,123 @@
+#ifndef KLIB_RTOS_INTRUSIVE_LIST_HPP
+#define KLIB_RTOS_INTRUSIVE_LIST_HPP
+
+namespace klib::rtos::detail {
+    /**
+     * @brief Intrusive doubly linked list. Uses the next, previous and
+     * list members of the items so no memory is allocated. An item is
+     * always in at most one list
+     *
+     * @tparam T type of the items in the list
+     * @tparam List type of the list that is stored in the items
+     */
+    template <typename T, typename List>
+    class intrusive_list {
+    protected:
+        // first and last item in the list
+        T* head = nullptr;
+        T* tail = nullptr;
+
+    public:
+        /**
+         * @brief Returns if the list is empty
+         *
+         * @return true
+         * @return false
+         */
+        bool empty() const {
+            return head == nullptr;
+        }
+
+        /**
+         * @brief Returns the first item in the list
+         *
+         * @return T*
+         */
+        T* front() const {
+            return head;
+        }
+
+        /**
+         * @brief Add a item at the end of the list
+         *
+         * @param item
+         */
+        void push_back(T* item) {
+            insert(nullptr, item);
+        }
+
+        /**
+         * @brief Insert a item before position. Adds the item at
+         * the end of the list when position is a nullptr
+         *
+         * @param position
+         * @param item
+         */
+        void insert(T* position, T* item) {
+            // get the item that will be before the new item
+            T *const previous = position ? position->previous : tail;
+
+            item->next = position;
+            item->previous = previous;
+            item->list = static_cast<List*>(this);
+
+            // update the links of the neighbours
+            if (previous) {
+                previous->next = item;
+            }
+            else {
+                head = item;
+            }
+
+            if (position) {
+                position->previous = item;
+            }
+            else {
+                tail = item;
+            }
+        }
+
+        /**
+         * @brief Remove a item from the list
+         *
+         * @param item
+         */
+        void remove(T* item) {
+            // update the links of the neighbours
+            if (item->previous) {
+                item->previous->next = item->next;
+            }
+            else {
+                head = item->next;
+            }
+
+            if (item->next) {
+                item->next->previous = item->previous;
+            }
+            else {
+                tail = item->previous;
+            }
+
+            item->next = nullptr;
+            item->previous = nullptr;
+            item->list = nullptr;
+        }
+
+        /**
+         * @brief Remove and return the first item in the list
+         *
+         * @return T*
+         */
+        T* pop_front() {
+            T *const item = head;
+
+            if (item) {
+                remove(item);
+            }
+
+            return item;
+        }
+    };
+}
+
+#endif
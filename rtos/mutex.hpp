@@ -1,22 +1,23 @@
 #ifndef KLIB_RTOS_MUTEX_HPP
 #define KLIB_RTOS_MUTEX_HPP
 
-#include <atomic>
-
 #include "waitable.hpp"
 #include "syscall.hpp"
 
 namespace klib::rtos {
+    /**
+     * @brief Mutex with priority inheritance. The owner of the mutex
+     * runs with the priority of the highest priority task waiting on
+     * the mutex until it unlocks the mutex
+     * 
+     */
     class mutex : public waitable {
-    private:
-        std::atomic_bool locked;
-
     public:
         /**
          * @brief Construct a new mutex object
          * 
          */
-        mutex(): locked(false) {}
+        mutex() {}
 
         /**
          * @brief Lock the mutex. This function will block until the mutex
@@ -24,17 +25,8 @@ namespace klib::rtos {
          * 
          */
         void lock() {
-            // wait until we can lock the mutex
-            while (true) {
-                // try to lock the mutex
-                if (try_lock()) {
-                    // locked successfully
-                    return;
-                }
-
-                // yield to other tasks
-                rtos::syscall::yield(*this);
-            }
+            // wait until the mutex is handed to us
+            rtos::syscall::wait(*this);
         }
 
         /**
@@ -45,35 +37,50 @@ namespace klib::rtos {
          * @return false 
          */
         bool try_lock() {
-            bool expected = false;
-            
-            // compare and try to set the locked flag to true
-            return locked.compare_exchange_strong(expected, true);
+            return rtos::syscall::try_acquire(*this);
         }
 
         /**
-         * @brief Unlock the mutex.
+         * @brief Unlock the mutex. Should be called by the task that
+         * locked the mutex
          * 
          */
         void unlock() {
-            // unlock the mutex
-            locked.store(false);
+            // hand the mutex to the highest priority waiter or unlock
+            // it when no task is waiting
+            rtos::syscall::release(*this);
+        }
+
+        /**
+         * @brief Function for the scheduler to lock the mutex
+         * 
+         * @param task 
+         * @return true 
+         * @return false 
+         */
+        virtual bool try_acquire(detail::base_task* task) override {
+            // a mutex is locked when it has a owner
+            if (owner != nullptr) {
+                return false;
+            }
+
+            owner = task;
 
-            // yield to higher priority tasks waiting on this mutex
-            rtos::syscall::wakeup_highest_priority_waiter(*this);
+            return true;
         }
 
         /**
-         * @brief Function for the scheduler to check if a task is waiting
+         * @brief Function for the scheduler to unlock the mutex
          * 
          * @return true 
          * @return false 
          */
-        virtual bool is_waiting() const override {
-            // a mutex is considered waiting if it is locked
-            return locked.load();
+        virtual bool release() override {
+            owner = nullptr;
+
+            return true;
         }
     };
 }
 
-#endif // KLIB_RTOS_MUTEX_HPP
\ No newline at end of file
+#endif // KLIB_RTOS_MUTEX_HPP
@@ -0,0 +1,144 @@
+#ifndef KLIB_RTOS_NOTIFICATION_HPP
+#define KLIB_RTOS_NOTIFICATION_HPP
+
+#include <cstdint>
+
+#include <rtos/rtos.hpp>
+
+#include "base_task.hpp"
+#include "deferred.hpp"
+#include "syscall.hpp"
+
+namespace klib::rtos {
+    /**
+     * @brief Actions to change the notification word of a task
+     * 
+     */
+    enum class notify_action {
+        // set the bits in the value
+        set_bits,
+        // add the value to the word. Can be used as a counting semaphore
+        increment,
+        // replace the word with the value
+        overwrite,
+    };
+}
+
+namespace klib::rtos::detail {
+    // tasks that got a notification while they were waiting. These
+    // are made ready by the scheduler
+    inline deferred_list<base_task> notified = {};
+
+    /**
+     * @brief Change the notification word of a task. Adds the task to
+     * the notified list when it is waiting for a notification
+     * 
+     * @param task 
+     * @param value 
+     * @param action 
+     * @return true the scheduler needs to handle the notified list
+     * @return false 
+     */
+    inline bool notify(base_task& task, const uint32_t value, const notify_action action) {
+        switch (action) {
+            case notify_action::set_bits:
+                task.notification.fetch_or(value);
+                break;
+            case notify_action::increment:
+                task.notification.fetch_add(value);
+                break;
+            case notify_action::overwrite:
+                task.notification.exchange(value);
+                break;
+        }
+
+        // check if the task is waiting. Only one notifier (or the 
+        // scheduler) can clear the flag so the task is added once
+        if (!task.notify_waiting.load() || !task.notify_waiting.exchange(false)) {
+            return false;
+        }
+
+        notified.push(&task);
+
+        return true;
+    }
+}
+
+namespace klib::rtos::notification {
+    /**
+     * @brief Notify a task. Should be called from a task. Only uses
+     * a syscall when the task is waiting for a notification
+     * 
+     * @param task 
+     * @param value 
+     * @param action 
+     */
+    inline void notify(detail::base_task& task, const uint32_t value = 1, const notify_action action = notify_action::increment) {
+        if (detail::notify(task, value, action)) {
+            // let the scheduler wake the task
+            syscall::deferred();
+        }
+    }
+
+    /**
+     * @brief Notify a task from a interrupt. Requests a context
+     * switch when the task is waiting for a notification
+     * 
+     * @param task 
+     * @param value 
+     * @param action 
+     */
+    inline void notify_from_isr(detail::base_task& task, const uint32_t value = 1, const notify_action action = notify_action::increment) {
+        if (detail::notify(task, value, action)) {
+            // the scheduler wakes the task before the context switch
+            klib::target::rtos::detail::request_switch();
+        }
+    }
+
+    /**
+     * @brief Wait until the notification word of the current task is
+     * not zero
+     * 
+     * @param clear bits to clear in the word after waiting
+     * @return uint32_t value of the word before the bits were cleared
+     */
+    inline uint32_t wait(const uint32_t clear = 0xffffffff) {
+        detail::base_task *const task = detail::current_task;
+
+        while (true) {
+            // check if we already have a notification
+            if (task->notification.load()) {
+                return task->notification.fetch_and(~clear);
+            }
+
+            // block until we are notified
+            syscall::wait_notification();
+        }
+    }
+
+    /**
+     * @brief Wait until the notification word of the current task is
+     * not zero and decrement it. Uses the word as a counting semaphore
+     * 
+     * @return uint32_t value of the word before the decrement
+     */
+    inline uint32_t take() {
+        detail::base_task *const task = detail::current_task;
+        uint32_t current = task->notification.load();
+
+        while (true) {
+            // check if we already have a notification
+            if (!current) {
+                // block until we are notified
+                syscall::wait_notification();
+
+                current = task->notification.load();
+            }
+            else if (task->notification.compare_exchange_weak(current, current - 1)) {
+                return current;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef KLIB_RTOS_RECURSIVE_MUTEX_HPP
+#define KLIB_RTOS_RECURSIVE_MUTEX_HPP
+
+#include <cstdint>
+
+#include "waitable.hpp"
+#include "syscall.hpp"
+
+namespace klib::rtos {
+    /**
+     * @brief Mutex that can be locked multiple times by the task that
+     * owns it. The mutex is unlocked when it is unlocked as many times
+     * as it was locked. Uses priority inheritance the same way as 
+     * rtos::mutex
+     * 
+     */
+    class recursive_mutex : public waitable {
+    protected:
+        // amount of times the owner has locked the mutex
+        uint32_t count;
+
+    public:
+        /**
+         * @brief Construct a new recursive mutex object
+         * 
+         */
+        recursive_mutex(): count(0) {}
+
+        /**
+         * @brief Lock the mutex. This function will block until the mutex
+         * is acquired. Returns directly when the current task owns the
+         * mutex
+         * 
+         */
+        void lock() {
+            // wait until the mutex is handed to us
+            rtos::syscall::wait(*this);
+        }
+
+        /**
+         * @brief Try to lock the mutex. This function will not block and
+         * will return if the mutex could not be acquired.
+         * 
+         * @return true 
+         * @return false 
+         */
+        bool try_lock() {
+            return rtos::syscall::try_acquire(*this);
+        }
+
+        /**
+         * @brief Unlock the mutex. Should be called by the task that
+         * locked the mutex
+         * 
+         */
+        void unlock() {
+            // hand the mutex to the highest priority waiter when this
+            // was the last unlock
+            rtos::syscall::release(*this);
+        }
+
+        /**
+         * @brief Function for the scheduler to lock the mutex
+         * 
+         * @param task 
+         * @return true 
+         * @return false 
+         */
+        virtual bool try_acquire(detail::base_task* task) override {
+            // check if another task owns the mutex
+            if (owner != nullptr && owner != task) {
+                return false;
+            }
+
+            owner = task;
+            count++;
+
+            return true;
+        }
+
+        /**
+         * @brief Function for the scheduler to unlock the mutex
+         * 
+         * @return true 
+         * @return false 
+         */
+        virtual bool release() override {
+            // check if the owner still has the mutex locked
+            if (--count) {
+                return false;
+            }
+
+            owner = nullptr;
+
+            return true;
+        }
+    };
+}
+
+#endif // KLIB_RTOS_RECURSIVE_MUTEX_HPP
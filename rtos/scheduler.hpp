@@ -2,26 +2,54 @@
 #define KLIB_RTOS_HPP
 
 #include <klib/io/systick.hpp>
-#include <klib/dynamic_array.hpp>
+#include <klib/math.hpp>
 #include <klib/units.hpp>
 
 #include <rtos/rtos.hpp>
 
 #include "task.hpp"
 #include "syscall.hpp"
+#include "timer.hpp"
+#include "notification.hpp"
+#include "event_group.hpp"
 
 namespace klib::rtos {
-    template <uint32_t CpuId, typename Irq>
+    /**
+     * @brief Rtos scheduler
+     *
+     * @tparam CpuId
+     * @tparam Irq irq used to register the pendsv and svcall handlers
+     * @tparam Systick timer that calls the scheduler every ms
+     * @tparam Tickless stop the systick while the idle task runs
+     * until the first sleeping task or timer needs to wake up
+     * @tparam Timers timer service for the software timers (see 
+     * rtos::timer_service)
+     */
+    template <
+        uint32_t CpuId, typename Irq, typename Systick = io::systick<CpuId, SYSTICK_CALLBACK_ENABLED>,
+        bool Tickless = false, typename Timers = detail::no_timers
+    >
     class scheduler {
     protected:
         // make sure we can register our callback with the systick handler
         static_assert(SYSTICK_CALLBACK_ENABLED, "Systick callback needs to be enabled to switch tasks");
 
-        // all the task we have
-        static inline klib::dynamic_array<detail::base_task*, 16> tasks = {};
+        // ready tasks for every priority. A bit in the bitmap is set
+        // when the list of that priority has tasks. The running task
+        // stays in its ready list
+        static inline detail::task_list ready[detail::max_priority] = {};
+        static inline uint32_t ready_bitmap = 0;
 
-        // current and next task index
-        static inline detail::base_task* current_task = nullptr;
+        // sleeping tasks sorted on wakeup time. Tasks waiting on a
+        // waitable are in the wait queue of the waitable
+        static inline detail::task_list sleeping = {};
+
+        // amount of tasks added to the scheduler
+        static inline uint32_t task_count = 0;
+
+        // current and next task index. The current task is shared with
+        // the code that runs without a syscall (e.g. notifications)
+        static inline detail::base_task*& current_task = detail::current_task;
         static inline detail::base_task* next_task = nullptr;
 
         /**
@@ -32,108 +60,388 @@ namespace klib::rtos {
          */
         static void idle() {
             while (true) {
+                // let the scheduler stop the tick if nothing needs
+                // to run for a while
+                if constexpr (Tickless) {
+                    syscall::enter_idle();
+                }
+
                 // wait for an interrupt
-                asm volatile("wfi");
+                klib::target::rtos::detail::wait_for_interrupt();
             }
         }
 
-        // create an idle task that runs when no other task is available
+        // create an idle task that runs when no other task is available.
+        // The idle task is not stored in any list
         static inline auto idle_task = task<>(idle);
 
         /**
-         * @brief Scheduler that is called on every systick interrupt. This
-         * function decrements the sleep time for all tasks and calls the
-         * scheduler to pick the next task.
-         * 
+         * @brief Get the highest priority that has a ready task
+         *
+         * @return uint32_t
          */
-        static void schedule_irq() {
-            // check if we have any tasks when we are called
-            // by the systick interrupt
-            if (tasks.size() == 0) {
-                // no tasks to schedule
+        static uint32_t highest_priority() {
+            return (detail::max_priority - 1) - klib::clz(ready_bitmap);
+        }
+
+        /**
+         * @brief Add a task to the ready list of its priority
+         *
+         * @param task
+         */
+        static void make_ready(detail::base_task* task) {
+            ready[task->current_priority].push_back(task);
+            ready_bitmap |= (0x1 << task->current_priority);
+        }
+
+        /**
+         * @brief Remove a task from the list it is in
+         *
+         * @param task
+         */
+        static void detach(detail::base_task* task) {
+            // check if the task is in a list
+            if (task->list == nullptr) {
                 return;
             }
 
-            // call the scheduler to pick the next task
-            schedule();
+            detail::task_list *const list = task->list;
+            list->remove(task);
+
+            // clear the priority bit when the ready list is empty
+            if (list == &ready[task->current_priority] && list->empty()) {
+                ready_bitmap &= ~(0x1 << task->current_priority);
+            }
         }
 
         /**
-         * @brief Rtos scheduler. Checks which task to run next and
-         * triggers a context switch if needed.
+         * @brief Add a task to the sleep queue. The queue is sorted on
+         * the wakeup time. Tasks with the same wakeup time keep the
+         * order they were added
          *
+         * @param task
          */
-        static void schedule() {
-            // get the current time
-            const auto now = io::systick<CpuId, SYSTICK_CALLBACK_ENABLED>::get_runtime();
-
-            // schedule the next task. We use the priority to pick
-            // the next task to run. We always pick the first task
-            // with the highest priority that is not sleeping. If no
-            // task is ready we run the idle task.
-            if (current_task == nullptr) {
-                next_task = &idle_task;
+        static void make_sleeping(detail::base_task* task) {
+            detail::base_task* position = sleeping.front();
+
+            // search the first task that wakes up after this task
+            while (position != nullptr && position->wakup_time <= task->wakup_time) {
+                position = position->next;
             }
-            else if (current_task->is_sleeping && current_task->wakup_time > now) {
-                // current task is sleeping, switch to idle
-                next_task = &idle_task;
+
+            sleeping.insert(position, task);
+        }
+
+        /**
+         * @brief Wake all the sleeping tasks that have an elapsed
+         * wakeup time
+         *
+         * @param now
+         */
+        static void wake_sleeping(const klib::time::ms now) {
+            // the queue is sorted so we can stop at the first task
+            // that is still sleeping
+            while (!sleeping.empty() && sleeping.front()->wakup_time <= now) {
+                detail::base_task *const task = sleeping.pop_front();
+
+                task->is_sleeping = false;
+                make_ready(task);
             }
-            else if (current_task->waitable != nullptr) {
-                next_task = &idle_task;
+        }
+
+        /**
+         * @brief Add a task to the wait queue of a waitable. The queue
+         * is sorted on priority. Tasks with the same priority keep
+         * the order they were added
+         *
+         * @param waitable
+         * @param task
+         */
+        static void make_waiting(rtos::waitable* waitable, detail::base_task* task) {
+            detail::base_task* position = waitable->waiters.front();
+
+            // search the first task with a lower priority
+            while (position != nullptr && position->current_priority >= task->current_priority) {
+                position = position->next;
+            }
+
+            task->waitable = waitable;
+            waitable->waiters.insert(position, task);
+        }
+
+        /**
+         * @brief Change the priority of a task. Moves the task to the
+         * position of the new priority in the list it is in
+         *
+         * @param task
+         * @param priority
+         */
+        static void set_priority(detail::base_task* task, const uint8_t priority) {
+            // check if the task is in a ready list
+            if (task->list == &ready[task->current_priority]) {
+                detach(task);
+                task->current_priority = priority;
+                make_ready(task);
+            }
+            else if (task->waitable != nullptr) {
+                // keep the wait queue sorted on priority
+                task->waitable->waiters.remove(task);
+                task->current_priority = priority;
+                make_waiting(task->waitable, task);
             }
             else {
-                next_task = current_task;
+                // the sleep queue is not sorted on priority
+                task->current_priority = priority;
             }
+        }
 
-            // TODO: implement a better scheduling algorithm
-            for (size_t i = 0; i < tasks.size(); i++) {
-                // get a reference to the task
-                auto& task = *tasks[i];
+        /**
+         * @brief Update the priority of a task to the highest priority
+         * of the tasks waiting on the objects it holds. The change is 
+         * passed to the owner of the object the task is waiting on
+         *
+         * @param task
+         */
+        static void update_priority(detail::base_task* task) {
+            while (task != nullptr) {
+                uint8_t priority = task->priority;
+
+                // get the highest priority waiter. The wait queues are
+                // sorted so we only need to check the first waiter
+                for (rtos::waitable* held = task->held; held != nullptr; held = held->next_held) {
+                    if (!held->waiters.empty()) {
+                        priority = klib::max(priority, held->waiters.front()->current_priority);
+                    }
+                }
 
-                // no need to check the next_task again. We checked
-                // it above to determine if we need to switch to the
-                // idle task
-                if (&task == next_task) {
-                    continue;
+                // check if we need to change anything
+                if (priority == task->current_priority) {
+                    return;
                 }
 
-                // check if the task is sleeping
-                if (task.is_sleeping) {
-                    // check if the sleep time has elapsed
-                    if (task.wakup_time <= now) {
-                        // wake up the task
-                        task.is_sleeping = false;
-                    }
-                    else {
-                        // task is still sleeping
-                        continue;
-                    }
+                set_priority(task, priority);
+
+                // pass the change to the owner of the object the task is
+                // waiting on (nested locks)
+                task = (task->waitable != nullptr) ? task->waitable->owner : nullptr;
+            }
+        }
+
+        /**
+         * @brief Try to acquire a waitable for a task. Adds the waitable
+         * to the objects the task holds when the task became the owner
+         *
+         * @param waitable
+         * @param task
+         * @return true
+         * @return false
+         */
+        static bool acquire(rtos::waitable* waitable, detail::base_task* task) {
+            detail::base_task *const previous = waitable->owner;
+
+            if (!waitable->try_acquire(task)) {
+                return false;
+            }
+
+            // check if the task is a new owner
+            if (waitable->owner == task && previous != task) {
+                waitable->next_held = task->held;
+                task->held = waitable;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Remove a waitable from the objects a task holds
+         *
+         * @param waitable
+         * @param task
+         */
+        static void remove_held(rtos::waitable* waitable, detail::base_task* task) {
+            // search the link that points to the waitable
+            for (rtos::waitable** held = &task->held; *held != nullptr; held = &(*held)->next_held) {
+                if (*held == waitable) {
+                    *held = waitable->next_held;
+                    waitable->next_held = nullptr;
+
+                    return;
+                }
+            }
+        }
+
+        /**
+         * @brief Stop the tick until the first sleeping task needs
+         * to wake up. Called from the idle task
+         *
+         */
+        static void enter_idle() {
+            // update the runtime if we woke up before the suppressed
+            // tick. This also starts the normal tick again
+            Systick::resume_ticks();
+
+            // check if we need the tick
+            if (ready_bitmap) {
+                return;
+            }
+
+            // get the amount of ticks until the first task wakes up
+            const klib::time::ms now = Systick::get_runtime();
+            uint32_t ticks = sleeping.empty() ? 0xffffffff : (
+                (sleeping.front()->wakup_time <= now) ? 0 : (sleeping.front()->wakup_time - now).value
+            );
+
+            // do not sleep past the next timer
+            ticks = klib::min(ticks, Timers::next_event(now));
+
+            // delay the tick. The timer limits the amount of ticks
+            // to what it supports
+            Systick::suppress_ticks(ticks);
+        }
+
+        /**
+         * @brief Move the time of the timer service to the current time.
+         * Wakes the daemon task of the timer service when timers have
+         * expired
+         *
+         */
+        static void advance_timers() {
+            Timers::advance(Systick::get_runtime());
+
+            if constexpr (Timers::daemon) {
+                // the daemon task is not in any list while it waits
+                // for a timer to expire
+                if (Timers::has_expired() && Timers::get_task()->list == nullptr) {
+                    make_ready(Timers::get_task());
                 }
+            }
+        }
 
-                // check if the task is waiting on a waitable
-                if (task.waitable != nullptr) {
-                    if (task.waitable->is_waiting()) {
-                        // task is waiting on a waitable
-                        continue;
-                    }
-                    else {
-                        // clear the waitable as it is no longer waiting
-                        task.waitable = nullptr;
+        /**
+         * @brief Wake the tasks that got a notification and check the 
+         * waiters of the event groups that had bits set. These are 
+         * signalled without a syscall (e.g. from interrupts) so they
+         * are handled the next time the scheduler runs
+         *
+         * @return true a task was made ready
+         * @return false
+         */
+        static bool __attribute__((noinline)) process_deferred() {
+            bool woken = false;
+
+            // wake the tasks that got a notification
+            for (detail::base_task* task = detail::notified.take(); task != nullptr;) {
+                detail::base_task *const next = task->deferred_next;
+
+                make_ready(task);
+                woken = true;
+
+                task = next;
+            }
+
+            // check the waiters of the event groups
+            for (rtos::event_group* group = detail::signalled_groups.take(); group != nullptr;) {
+                rtos::event_group *const next = group->deferred_next;
+
+                // allow the group to be added again before we check
+                // the bits so we do not miss a change
+                group->dequeue();
+
+                for (detail::base_task* task = group->waiters.front(); task != nullptr;) {
+                    detail::base_task *const waiter = task;
+                    task = task->next;
+
+                    // multiple waiters can be done with the same bits
+                    if (group->try_acquire(waiter)) {
+                        group->waiters.remove(waiter);
+                        waiter->waitable = nullptr;
+                        make_ready(waiter);
+                        woken = true;
                     }
                 }
 
-                // task is not sleeping, check priority
-                if (task.current_priority >= next_task->current_priority) {
-                    next_task = &task;
-                    break;
+                // set bits do not need the scheduler anymore when
+                // nobody is waiting
+                if (group->waiters.empty()) {
+                    group->clear_waiting();
+                }
+
+                group = next;
+            }
+
+            // we might have woken up before the suppressed tick
+            if constexpr (Tickless) {
+                if (woken) {
+                    Systick::resume_ticks();
                 }
             }
 
+            return woken;
+        }
+
+        /**
+         * @brief Trigger a context switch to the next task
+         *
+         */
+        static void switch_to_next() {
             // check if we need to switch
             if (current_task != next_task) {
                 // switch to the new task by triggering the pendsv interrupt
-                SCB->ICSR = (0x1 << 28);
+                klib::target::rtos::detail::request_switch();
+            }
+        }
+
+        /**
+         * @brief Scheduler that is called on every systick interrupt. This
+         * function decrements the sleep time for all tasks and calls the
+         * scheduler to pick the next task.
+         * 
+         */
+        static void schedule_irq() {
+            // check if we have any tasks when we are called
+            // by the systick interrupt
+            if (task_count == 0) {
+                // no tasks to schedule
+                return;
+            }
+
+            // call the scheduler to pick the next task
+            schedule();
+        }
+
+        /**
+         * @brief Rtos scheduler. Checks which task to run next and
+         * triggers a context switch if needed.
+         *
+         * @details we always pick the first task of the highest
+         * priority that is ready. The running task is moved to the
+         * back of its ready list so tasks with the same priority
+         * are scheduled round robin. If no task is ready we run the
+         * idle task.
+         *
+         */
+        static void schedule() {
+            // wake the tasks that were signalled without a syscall
+            process_deferred();
+
+            // wake the tasks that are done sleeping
+            wake_sleeping(Systick::get_runtime());
+
+            // handle the expired timers
+            advance_timers();
+
+            // move the current task to the back of its ready list
+            if (current_task != nullptr && current_task->list == &ready[current_task->current_priority]) {
+                auto& list = ready[current_task->current_priority];
+
+                list.remove(current_task);
+                list.push_back(current_task);
             }
+
+            // pick the first task of the highest priority
+            next_task = ready_bitmap ? ready[highest_priority()].front() : &idle_task;
+
+            switch_to_next();
         }
 
         /**
@@ -141,6 +449,16 @@ namespace klib::rtos {
          * 
          */
         static void pendsv() {
+            // interrupts request a switch when they signal a waiting
+            // task. Check if a task with a higher priority is ready 
+            // now. This is done in a separate function as we cannot 
+            // change the registers that are used by the context switcher
+            if (process_deferred()) {
+                if (next_task == &idle_task || highest_priority() > next_task->current_priority) {
+                    next_task = ready[highest_priority()].front();
+                }
+            }
+
             // call the context switcher from the target. Note: we cannot
             // do too much work in the pendsv handler as it will modify registers
             // that are needed by the context switcher
@@ -154,7 +472,7 @@ namespace klib::rtos {
          */
         static void start() {
             // update the callback to our scheduler
-            io::systick<CpuId, SYSTICK_CALLBACK_ENABLED>::set_callback(schedule_irq);
+            Systick::set_callback(schedule_irq);
 
             // register our interrupt to the pendsv interrupt
             Irq::template register_irq<Irq::arm_vector::pendsv>(pendsv);
@@ -162,8 +480,10 @@ namespace klib::rtos {
             // register the syscall handler
             Irq::template register_irq<Irq::arm_vector::svcall>(klib::target::rtos::detail::syscall_handler<scheduler>);
 
-            // add the idle task to the scheduler. This task is always ready to run
-            create_task(&idle_task);
+            // add the daemon task of the timer service
+            if constexpr (Timers::daemon) {
+                create_task(Timers::get_task());
+            }
 
             // start the scheduler from the target
             klib::target::rtos::detail::scheduler_start();
@@ -176,8 +496,9 @@ namespace klib::rtos {
          * @param task
          */
         static void create_task(detail::base_task* task) {
-            // add the task to the queue
-            tasks.push_back(task);
+            // add the task to the ready list
+            make_ready(task);
+            task_count++;
         }
         
     public:
@@ -185,114 +506,248 @@ namespace klib::rtos {
          * @brief Syscall handler, called when a syscall is invoked 
          * by the target implementation. Parameters need to be passed
          * in registers r1-r3. These are converted to the correct
-         * types based on the syscall.
+         * types based on the syscall. The arguments are pointer sized
+         * so targets with 64 bit pointers can pass pointers.
          * 
          * @param number 
          * @param arg0 
          * @param arg1 
          * @param arg2 
-         * @return uint32_t 
+         * @return uintptr_t 
          */
-        static uint32_t syscall_handler(detail::syscalls number, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+        static uintptr_t syscall_handler(detail::syscalls number, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2) {
             switch (number) {
                 case detail::syscalls::create_task:
                     // add the task to the scheduler
-                    tasks.push_back(reinterpret_cast<detail::base_task*>(arg0));
+                    create_task(reinterpret_cast<detail::base_task*>(arg0));
                     break;
 
-                case detail::syscalls::delete_task:
-                    // check if we have any tasks
-                    if (tasks.empty()) {
-                        // no tasks to delete
+                case detail::syscalls::delete_task: {
+                    // get the task to delete
+                    detail::base_task *const task = reinterpret_cast<detail::base_task*>(arg0);
+
+                    // check if the task is added to the scheduler
+                    if (task->list == nullptr) {
+                        // task not found
                         return false;
                     }
 
-                    // find and remove the task from the scheduler. We move backwards
-                    // to not mess up the indexing when erasing. Note this is something
-                    // that is specific to our dynamic array implementation. 
-                    // TODO: update this when changing away from the dynamic array
-                    for (uint32_t i = tasks.size(); i > 0; i--) {
-                        // get the index
-                        const uint32_t index = i - 1;
-
-                        // check if this is the task we want to delete
-                        if (tasks[index] != reinterpret_cast<detail::base_task*>(arg0)) {
-                            continue;
-                        }
+                    // get the object the task is waiting on
+                    rtos::waitable *const waitable = task->waitable;
 
-                        // erase the provided task
-                        tasks.erase(tasks.begin() + index);
+                    // remove the task from the list it is in
+                    detach(task);
+                    task->waitable = nullptr;
+                    task_count--;
 
-                        // check if we are running the task we are deleting
-                        if (current_task == reinterpret_cast<detail::base_task*>(arg0)) {
-                            // clear the current task and switch to the 
-                            // next one
-                            current_task = nullptr;
+                    // the owner of the object might have inherited the
+                    // priority of the task
+                    if (waitable != nullptr) {
+                        update_priority(waitable->owner);
+                    }
 
-                            // switch to the next task
-                            schedule();
-                        }
-                        
-                        // task found and deleted
-                        return true;
+                    // check if we are running the task we are deleting
+                    if (current_task == task) {
+                        // clear the current task and switch to the 
+                        // next one
+                        current_task = nullptr;
+
+                        // switch to the next task
+                        schedule();
                     }
 
-                    // task not found
-                    return false;
+                    // task found and deleted
+                    return true;
+                }
 
                 case detail::syscalls::sleep:
+                    // check if we were woken up before we went to sleep
+                    if (current_task->wakeup_pending) {
+                        current_task->wakeup_pending = false;
+                        break;
+                    }
+
                     // set the time to sleep for the current task
                     current_task->wakup_time = (
-                        io::systick<CpuId, SYSTICK_CALLBACK_ENABLED>::get_runtime() + 
+                        Systick::get_runtime() + 
                         klib::time::ms(arg0)
                     );
 
-                    // mark the task as sleeping
+                    // mark the task as sleeping and move it to the
+                    // sleep queue
                     current_task->is_sleeping = true;
 
+                    detach(current_task);
+                    make_sleeping(current_task);
+
                     // switch to the next task
                     schedule();
                     break;
 
                 case detail::syscalls::yield:
                     // yield the cpu to the next task
-                    current_task->waitable = reinterpret_cast<rtos::waitable*>(arg0);
+                    schedule();
+                    break;
 
-                    // switch to the next task
+                case detail::syscalls::wakeup: {
+                    detail::base_task *const task = reinterpret_cast<detail::base_task*>(arg0);
+
+                    // remember the wakeup when the task is not sleeping
+                    if (!task->is_sleeping) {
+                        task->wakeup_pending = true;
+                        break;
+                    }
+
+                    // move the task from the sleep queue to the ready list
+                    detach(task);
+                    task->is_sleeping = false;
+                    make_ready(task);
+
+                    // yield only if the task has a higher priority
+                    if (task->current_priority > current_task->current_priority) {
+                        next_task = ready[highest_priority()].front();
+
+                        switch_to_next();
+                    }
+                    break;
+                }
+
+                case detail::syscalls::wait: {
+                    rtos::waitable *const waitable = reinterpret_cast<rtos::waitable*>(arg0);
+
+                    // check if we can acquire the waitable directly
+                    if (acquire(waitable, current_task)) {
+                        break;
+                    }
+
+                    // move the task to the wait queue of the waitable.
+                    // It is not scheduled until the waitable is handed
+                    // to it
+                    detach(current_task);
+                    make_waiting(waitable, current_task);
+
+                    // let the owner inherit our priority
+                    update_priority(waitable->owner);
+
+                    // switch to the next task. The task continues when
+                    // it owns the waitable
                     schedule();
                     break;
+                }
 
-                case detail::syscalls::wakeup_highest_priority_waiter:
-                    // yield only if a higher priority task is waiting
-                    next_task = current_task;
+                case detail::syscalls::try_acquire:
+                    // try to acquire the waitable without waiting
+                    return acquire(reinterpret_cast<rtos::waitable*>(arg0), current_task);
 
-                    // TODO: change to a better data structure for tasks
-                    for (const auto& t: tasks) {
-                        // skip our current task and skip all tasks that are
-                        // sleeping or not waiting
-                        if (t == next_task || t->is_sleeping || t->waitable == nullptr) {
-                            continue;
-                        }
+                case detail::syscalls::release: {
+                    rtos::waitable *const waitable = reinterpret_cast<rtos::waitable*>(arg0);
+                    detail::base_task *const owner = waitable->owner;
 
-                        // check if the task is waiting on the provided waitable
-                        if (t->waitable == reinterpret_cast<rtos::waitable*>(arg0)) {
-                            // check if the task has a higher priority
-                            if (t->current_priority > next_task->current_priority) {
-                                next_task = t;
-                            }
-                        }
+                    // only the owner can release a object with a owner
+                    if (owner != nullptr && owner != current_task) {
+                        return false;
+                    }
+
+                    // check if the waitable is released
+                    if (!waitable->release()) {
+                        break;
+                    }
+
+                    if (owner != nullptr) {
+                        remove_held(waitable, owner);
+                    }
+
+                    // hand the waitable to the highest priority waiter
+                    detail::base_task *const task = waitable->waiters.front();
+
+                    if (task != nullptr && acquire(waitable, task)) {
+                        waitable->waiters.remove(task);
+                        task->waitable = nullptr;
+                        make_ready(task);
+
+                        // the new owner inherits the priority of the
+                        // tasks that are still waiting
+                        update_priority(waitable->owner);
                     }
 
-                    // check if we found a higher priority task
-                    if (next_task != current_task) {
-                        // switch to the new task by triggering the pendsv interrupt
-                        SCB->ICSR = (0x1 << 28);
+                    // restore the priority of the previous owner
+                    update_priority(owner);
+
+                    // yield only if a task with a higher priority is ready
+                    if (ready_bitmap && highest_priority() > current_task->current_priority) {
+                        next_task = ready[highest_priority()].front();
+
+                        switch_to_next();
+                    }
+                    break;
+                }
+
+                case detail::syscalls::wait_notification:
+                    // mark that a notifier needs to move us to the
+                    // list of notified tasks
+                    current_task->notify_waiting.store(true);
+
+                    // check if we got a notification before we marked
+                    // the task. Only one of us or the notifier can 
+                    // clear the flag
+                    if (current_task->notification.load() && current_task->notify_waiting.exchange(false)) {
+                        break;
+                    }
+
+                    // switch to the next task. The task continues when
+                    // it is notified. Interrupts cannot handle the 
+                    // notified list before we return
+                    detach(current_task);
+                    schedule();
+                    break;
+
+                case detail::syscalls::deferred:
+                    // yield only if a signalled task has a higher priority
+                    if (process_deferred() && highest_priority() > current_task->current_priority) {
+                        next_task = ready[highest_priority()].front();
+
+                        switch_to_next();
                     }
                     break;
 
                 case detail::syscalls::get_time:
                     // get the current time in ms
-                    return io::systick<CpuId, SYSTICK_CALLBACK_ENABLED>::get_runtime().value;
+                    return Systick::get_runtime().value;
+
+                case detail::syscalls::idle:
+                    // stop the tick if nothing needs to run
+                    if constexpr (Tickless) {
+                        enter_idle();
+                    }
+                    break;
+
+                case detail::syscalls::start_timer:
+                    // make sure the timer starts from the current time
+                    advance_timers();
+
+                    return Timers::start(reinterpret_cast<rtos::timer*>(arg0), arg1, arg2);
+
+                case detail::syscalls::stop_timer:
+                    Timers::stop(reinterpret_cast<rtos::timer*>(arg0));
+                    break;
+
+                case detail::syscalls::next_timer:
+                    if constexpr (Timers::daemon) {
+                        rtos::timer *const timer = Timers::pop_expired();
+
+                        // wait until a timer expires when we do not
+                        // have any expired timers. We are made ready 
+                        // again by the scheduler
+                        if (timer == nullptr) {
+                            detach(current_task);
+                            schedule();
+                        }
+
+                        return reinterpret_cast<uintptr_t>(timer);
+                    }
+                    else {
+                        return 0;
+                    }
             }
 
             return true;
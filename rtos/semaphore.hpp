@@ -27,17 +27,13 @@ namespace klib::rtos {
          * 
          */
         void decrement() {
-            uint32_t expected;
-
-            while (true) {
-                // try to acquire the semaphore
-                if (try_decrement()) {
-                    return;
-                }
-
-                // yield to other tasks if no resources available
-                rtos::syscall::yield(*this);
+            // try to acquire the semaphore without a syscall
+            if (try_decrement()) {
+                return;
             }
+
+            // wait until a increment is handed to us
+            rtos::syscall::wait(*this);
         }
 
         /**
@@ -63,20 +59,35 @@ namespace klib::rtos {
          * 
          */
         void increment() {
-            count.fetch_add(1);
+            // hand the increment to the highest priority waiter or
+            // increment the count when no task is waiting
+            rtos::syscall::release(*this);
+        }
+
+        /**
+         * @brief Function for the scheduler to decrement the semaphore
+         * 
+         * @param task 
+         * @return true 
+         * @return false 
+         */
+        virtual bool try_acquire(detail::base_task* task) override {
+            // a semaphore does not have a owner
+            (void)task;
 
-            // yield to higher priority tasks waiting on this semaphore
-            rtos::syscall::wakeup_highest_priority_waiter(*this);
+            return try_decrement();
         }
 
         /**
-         * @brief Returns whether the semaphore is being waited on
+         * @brief Function for the scheduler to increment the semaphore
          * 
          * @return true 
          * @return false 
          */
-        virtual bool is_waiting() const override {
-            return count.load() == 0;
+        virtual bool release() override {
+            count.fetch_add(1);
+
+            return true;
         }
     };
 }
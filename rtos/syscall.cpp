@@ -32,17 +32,22 @@ namespace klib::rtos::syscall {
 
     void yield() {
         // invoke the yield syscall
-        syscall_invoke<void, rtos::waitable*>(detail::syscalls::yield, nullptr);
+        syscall_invoke<void>(detail::syscalls::yield);
     }
 
-    void yield(rtos::waitable& waitable) {
-        // invoke the yield syscall
-        syscall_invoke<void, rtos::waitable*>(detail::syscalls::yield, &waitable);
+    void wait(rtos::waitable& waitable) {
+        // invoke the wait syscall
+        syscall_invoke<void, rtos::waitable*>(detail::syscalls::wait, &waitable);
     }
 
-    void wakeup_highest_priority_waiter(rtos::waitable& waitable) {
-        // invoke the yield syscall
-        syscall_invoke<void, rtos::waitable*>(detail::syscalls::wakeup_highest_priority_waiter, &waitable);
+    bool try_acquire(rtos::waitable& waitable) {
+        // invoke the try_acquire syscall
+        return syscall_invoke<bool, rtos::waitable*>(detail::syscalls::try_acquire, &waitable);
+    }
+
+    void release(rtos::waitable& waitable) {
+        // invoke the release syscall
+        syscall_invoke<void, rtos::waitable*>(detail::syscalls::release, &waitable);
     }
 
     void sleep(klib::time::ms time) {
@@ -55,6 +60,21 @@ namespace klib::rtos::syscall {
         syscall_invoke<void, uint32_t>(detail::syscalls::sleep, time.value);
     }
 
+    void wakeup(detail::base_task* task) {
+        // invoke the wakeup syscall
+        syscall_invoke<void, detail::base_task*>(detail::syscalls::wakeup, task);
+    }
+
+    void wait_notification() {
+        // invoke the wait_notification syscall
+        syscall_invoke<void>(detail::syscalls::wait_notification);
+    }
+
+    void deferred() {
+        // invoke the deferred syscall
+        syscall_invoke<void>(detail::syscalls::deferred);
+    }
+
     klib::time::ms get_time() {
         // invoke the get_time syscall
         return klib::time::ms(syscall_invoke<uint32_t>(detail::syscalls::get_time));
@@ -69,4 +89,24 @@ namespace klib::rtos::syscall {
         // invoke the free syscall
         syscall_invoke<void, const void*>(detail::syscalls::free, ptr);
     }
+
+    void enter_idle() {
+        // invoke the idle syscall
+        syscall_invoke<void>(detail::syscalls::idle);
+    }
+
+    bool start_timer(rtos::timer* timer, uint32_t time, bool periodic) {
+        // invoke the start_timer syscall
+        return syscall_invoke<bool, rtos::timer*, uint32_t, uint32_t>(detail::syscalls::start_timer, timer, time, periodic);
+    }
+
+    void stop_timer(rtos::timer* timer) {
+        // invoke the stop_timer syscall
+        syscall_invoke<void, rtos::timer*>(detail::syscalls::stop_timer, timer);
+    }
+
+    rtos::timer* next_timer() {
+        // invoke the next_timer syscall
+        return syscall_invoke<rtos::timer*>(detail::syscalls::next_timer);
+    }
 }
@@ -8,6 +8,11 @@
 #include "base_task.hpp"
 #include "waitable.hpp"
 
+namespace klib::rtos {
+    // forward declaration of the timer
+    class timer;
+}
+
 namespace klib::rtos::detail {
     /**
      * @brief All the available syscalls
@@ -17,11 +22,20 @@ namespace klib::rtos::detail {
         create_task,
         delete_task,
         yield,
-        wakeup_highest_priority_waiter,
+        wait,
+        try_acquire,
+        release,
         sleep,
         get_time,
         malloc,
         free,
+        idle,
+        start_timer,
+        stop_timer,
+        next_timer,
+        wakeup,
+        wait_notification,
+        deferred,
     };
 }
 
@@ -50,26 +64,64 @@ namespace klib::rtos::syscall {
     void yield();
 
     /**
-     * @brief Yield the CPU and wait on a waitable object
+     * @brief Acquire a waitable object. When the object is not 
+     * available the task is added to the wait queue of the object 
+     * and is not scheduled until the object is handed to it
+     * 
+     * @param waitable 
+     */
+    void wait(rtos::waitable& waitable);
+
+    /**
+     * @brief Try to acquire a waitable object without waiting
      * 
      * @param waitable 
+     * @return true 
+     * @return false 
      */
-    void yield(rtos::waitable& waitable);
+    bool try_acquire(rtos::waitable& waitable);
 
     /**
-     * @brief Yield the CPU if a higher priority task is waiting on the waitable
+     * @brief Release a waitable object. Hands the object to the 
+     * highest priority waiter and yields if a task with a higher
+     * priority than the current task is ready. Objects with a owner
+     * can only be released by the owner
      * 
      * @param waitable 
      */
-    void wakeup_highest_priority_waiter(rtos::waitable& waitable);
+    void release(rtos::waitable& waitable);
 
     /**
-     * @brief Sleep the current task for the given time
+     * @brief Sleep the current task for the given time. Returns early
+     * when another task wakes the task up (see syscall::wakeup)
      * 
      * @param time 
      */
     void sleep(klib::time::ms time);
 
+    /**
+     * @brief Wake up a sleeping task. When the task is not sleeping
+     * the next sleep of the task returns directly
+     * 
+     * @param task 
+     */
+    void wakeup(detail::base_task* task);
+
+    /**
+     * @brief Block the current task until its notification word is
+     * not zero
+     * 
+     */
+    void wait_notification();
+
+    /**
+     * @brief Make the scheduler handle the tasks and event groups that
+     * were signalled without a syscall. Yields if a task with a higher
+     * priority is ready
+     * 
+     */
+    void deferred();
+
     /**
      * @brief Get the time object
      * 
@@ -88,6 +140,41 @@ namespace klib::rtos::syscall {
      * 
      */
     void free(const void *const ptr);
+
+    /**
+     * @brief Called by the idle task before it waits for a interrupt.
+     * Stops the tick until the next task needs to wake up when the
+     * scheduler runs in tickless mode
+     * 
+     */
+    void enter_idle();
+
+    /**
+     * @brief Start a timer. Restarts the timer if it is already running
+     * 
+     * @param timer 
+     * @param time time in ms until the timer expires
+     * @param periodic 
+     * @return true 
+     * @return false the scheduler does not have a timer service
+     */
+    bool start_timer(rtos::timer* timer, uint32_t time, bool periodic);
+
+    /**
+     * @brief Stop a timer
+     * 
+     * @param timer 
+     */
+    void stop_timer(rtos::timer* timer);
+
+    /**
+     * @brief Get the next expired timer. Used by the daemon task of
+     * the timer service. Blocks the task when no timer has expired
+     * 
+     * @return rtos::timer* expired timer or a nullptr when the task 
+     * was blocked
+     */
+    rtos::timer* next_timer();
 }
 
 #endif
\ No newline at end of file
@@ -16,6 +16,9 @@ namespace klib::rtos {
     template <uint8_t Priority = 0, uint32_t StackSize = 128>
     class task: public detail::base_task {
     protected:
+        // every priority has a bit in the ready bitmap of the scheduler
+        static_assert(Priority < detail::max_priority, "Task priority is not supported by the scheduler");
+
         // stack for this task
         size_t stack[StackSize] = {};
 
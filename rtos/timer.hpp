@@ -0,0 +1,159 @@
+#ifndef KLIB_RTOS_TIMER_HPP
+#define KLIB_RTOS_TIMER_HPP
+
+#include <cstdint>
+
+#include <klib/units.hpp>
+
+#include "intrusive_list.hpp"
+#include "syscall.hpp"
+
+namespace klib::rtos::detail {
+    // forward declaration of the timer list
+    class timer_list;
+}
+
+namespace klib::rtos {
+    /**
+     * @brief Software timer. Calls a callback after a amount of time 
+     * once or periodically. Needs a scheduler with a timer service 
+     * (see rtos::timer_service)
+     * 
+     */
+    class timer {
+    public:
+        // using for the callback
+        using timer_callback = void (*)();
+
+        // links for the list the timer is in (a slot in the timer 
+        // wheel or the list of expired timers)
+        timer* next;
+        timer* previous;
+
+        // the list the timer is in. nullptr when the timer is not 
+        // running
+        detail::timer_list* list;
+
+        // time the timer expires in ticks of the timer service
+        uint32_t expires;
+
+        // period of the timer. 0 for a one-shot timer
+        uint32_t period;
+
+        // callback that is called when the timer expires
+        const timer_callback callback;
+
+        /**
+         * @brief Construct a new timer
+         * 
+         * @param callback 
+         */
+        timer(const timer_callback callback):
+            next(nullptr),
+            previous(nullptr),
+            list(nullptr),
+            expires(0),
+            period(0),
+            callback(callback)
+        {}
+
+        /**
+         * @brief Start the timer. Restarts the timer if it is 
+         * already running
+         * 
+         * @param time time until the callback is called
+         * @param periodic call the callback every time instead of once
+         * @return true 
+         * @return false the scheduler does not have a timer service
+         */
+        bool start(const klib::time::ms time, const bool periodic = false) {
+            return syscall::start_timer(this, time.value, periodic);
+        }
+
+        /**
+         * @brief Stop the timer. The callback is not called after 
+         * this returns
+         * 
+         */
+        void stop() {
+            syscall::stop_timer(this);
+        }
+
+        /**
+         * @brief Returns if the timer is running
+         * 
+         * @return true 
+         * @return false 
+         */
+        bool is_active() const {
+            return list != nullptr;
+        }
+    };
+}
+
+namespace klib::rtos::detail {
+    /**
+     * @brief Intrusive doubly linked list of timers
+     * 
+     */
+    class timer_list: public intrusive_list<rtos::timer, timer_list> {};
+
+    /**
+     * @brief Timer service for a scheduler without timers
+     * 
+     */
+    class no_timers {
+    public:
+        // no daemon task is used
+        constexpr static bool daemon = false;
+
+        /**
+         * @brief Move the time of the timers to now
+         * 
+         * @param now 
+         */
+        static void advance(const klib::time::ms now) {
+            (void)now;
+        }
+
+        /**
+         * @brief Get the amount of ticks until the next timer needs 
+         * to be handled
+         * 
+         * @param now 
+         * @return uint32_t 
+         */
+        static uint32_t next_event(const klib::time::ms now) {
+            (void)now;
+
+            return 0xffffffff;
+        }
+
+        /**
+         * @brief Start a timer. Not supported without a timer service
+         * 
+         * @param timer 
+         * @param ticks 
+         * @param periodic 
+         * @return false 
+         */
+        static bool start(rtos::timer* timer, const uint32_t ticks, const bool periodic) {
+            (void)timer;
+            (void)ticks;
+            (void)periodic;
+
+            return false;
+        }
+
+        /**
+         * @brief Stop a timer
+         * 
+         * @param timer 
+         */
+        static void stop(rtos::timer* timer) {
+            (void)timer;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,430 @@
+#ifndef KLIB_RTOS_TIMER_SERVICE_HPP
+#define KLIB_RTOS_TIMER_SERVICE_HPP
+
+#include <bit>
+#include <cstdint>
+
+#include <klib/math.hpp>
+#include <klib/units.hpp>
+
+#include "base_task.hpp"
+#include "syscall.hpp"
+#include "task.hpp"
+#include "timer.hpp"
+
+namespace klib::rtos::detail {
+    /**
+     * @brief Hierarchical timer wheel. Every level has 32 slots with
+     * a list of timers. A slot in level n covers 32^n ticks. Timers
+     * are added to the lowest level that can fit them and are moved
+     * to a lower level when the time reaches their slot. This makes
+     * adding and removing a timer O(1).
+     *
+     * @details timers that expire after the range of the wheel
+     * (32^Levels ticks) are added to the last slot of the highest
+     * level and are added again when the time reaches that slot.
+     *
+     * @tparam Levels
+     */
+    template <uint32_t Levels = 4>
+    class timer_wheel {
+    protected:
+        // amount of bits and slots per level. A level uses a
+        // 32 bit bitmap to search the next slot with timers
+        constexpr static uint32_t bits = 5;
+        constexpr static uint32_t slots = 1 << bits;
+        constexpr static uint32_t mask = slots - 1;
+
+        // make sure the range of the wheel fits the time
+        static_assert(Levels > 0 && (Levels * bits) < 32, "Invalid amount of levels for the timer wheel");
+
+        // the lists of timers for every slot. A bit in the bitmap of
+        // a level is set when the slot has timers
+        timer_list wheel[Levels][slots] = {};
+        uint32_t occupied[Levels] = {};
+
+        // current time of the wheel
+        uint32_t current = 0;
+
+        // amount of timers in the wheel
+        uint32_t count = 0;
+
+        /**
+         * @brief Move all the timers in the slot of a level that
+         * starts at the current time to the lower levels
+         *
+         * @param level
+         */
+        void cascade(const uint32_t level) {
+            const uint32_t slot = (current >> (bits * level)) & mask;
+            timer_list& list = wheel[level][slot];
+
+            // timers never get added to the current slot of a level
+            // so we can clear the bit before we add them again
+            occupied[level] &= ~(0x1 << slot);
+
+            while (!list.empty()) {
+                count--;
+                add(list.pop_front());
+            }
+        }
+
+    public:
+        /**
+         * @brief Get the current time of the wheel
+         *
+         * @return uint32_t
+         */
+        uint32_t time() const {
+            return current;
+        }
+
+        /**
+         * @brief Returns if the wheel has timers
+         *
+         * @return true
+         * @return false
+         */
+        bool empty() const {
+            return count == 0;
+        }
+
+        /**
+         * @brief Returns if a list is a slot of this wheel
+         *
+         * @param list
+         * @return true
+         * @return false
+         */
+        bool contains(const timer_list* list) const {
+            return list >= &wheel[0][0] && list < (&wheel[0][0] + (Levels * slots));
+        }
+
+        /**
+         * @brief Add a timer to the wheel. The timer should expire at
+         * or after the current time of the wheel
+         *
+         * @param timer
+         */
+        void add(rtos::timer* timer) {
+            const uint32_t delta = timer->expires - current;
+
+            // use the slot before the current slot of the highest
+            // level when the timer does not fit in the wheel
+            uint32_t level = Levels - 1;
+            uint32_t slot = ((current >> (bits * level)) + mask) & mask;
+
+            if (delta < (0x1 << (bits * Levels))) {
+                // search the lowest level that can fit the timer
+                for (uint32_t l = 0; l < Levels; l++) {
+                    const uint32_t shift = bits * l;
+
+                    // get the amount of slots from the current slot
+                    // of this level
+                    const uint32_t distance = ((current & ((0x1 << shift) - 1)) + delta) >> shift;
+
+                    if (distance < slots) {
+                        level = l;
+                        slot = ((current >> shift) + distance) & mask;
+                        break;
+                    }
+                }
+            }
+
+            wheel[level][slot].push_back(timer);
+            occupied[level] |= (0x1 << slot);
+            count++;
+        }
+
+        /**
+         * @brief Remove a timer from the wheel
+         *
+         * @param timer
+         */
+        void remove(rtos::timer* timer) {
+            timer_list *const list = timer->list;
+
+            list->remove(timer);
+            count--;
+
+            // clear the bit of the slot when it is empty
+            if (list->empty()) {
+                const uint32_t index = list - &wheel[0][0];
+
+                occupied[index / slots] &= ~(0x1 << (index % slots));
+            }
+        }
+
+        /**
+         * @brief Get the time the next slot with timers is handled.
+         * This can be before the first timer expires when the timers
+         * need to move to a lower level
+         *
+         * @return uint32_t
+         */
+        uint32_t next_event() const {
+            uint32_t next = 0xffffffff;
+
+            for (uint32_t level = 0; level < Levels; level++) {
+                // skip the levels without timers
+                if (!occupied[level]) {
+                    continue;
+                }
+
+                const uint32_t shift = bits * level;
+
+                // get the first slot with timers after the current
+                // slot of this level
+                const uint32_t distance = klib::ctz(
+                    std::rotr(occupied[level], static_cast<int>(((current >> shift) + 1) & mask))
+                ) + 1;
+
+                // get the amount of ticks until the start of the slot
+                next = klib::min(next, ((((current >> shift) + distance) << shift) - current));
+            }
+
+            return current + next;
+        }
+
+        /**
+         * @brief Move the wheel to a new time. Calls expired for every
+         * timer that expired. The timer is removed from the wheel
+         * before expired is called
+         *
+         * @tparam Expired
+         * @param now
+         * @param expired
+         */
+        template <typename Expired>
+        void advance(const uint32_t now, Expired&& expired) {
+            while (current != now) {
+                // skip directly to the new time when nothing can expire
+                if (!count) {
+                    current = now;
+                    return;
+                }
+
+                // get the next time we need to handle a slot
+                const uint32_t next = next_event();
+
+                if ((next - current) > (now - current)) {
+                    current = now;
+                    return;
+                }
+
+                current = next;
+
+                // move the timers of the levels that start a new slot
+                // to the lower levels
+                for (uint32_t level = Levels - 1; level > 0; level--) {
+                    if ((current & ((0x1 << (bits * level)) - 1)) == 0) {
+                        cascade(level);
+                    }
+                }
+
+                // all timers in the current slot of the first level
+                // expire now
+                const uint32_t slot = current & mask;
+                timer_list& list = wheel[0][slot];
+
+                while (!list.empty()) {
+                    count--;
+                    expired(list.pop_front());
+                }
+
+                // the expired callback can add periodic timers again.
+                // These are never added to the current slot
+                occupied[0] &= ~(0x1 << slot);
+            }
+        }
+    };
+}
+
+namespace klib::rtos {
+    /**
+     * @brief Timer service for the scheduler. Handles the software
+     * timers with a hierarchical timer wheel.
+     *
+     * @details when StackSize is 0 the callbacks run from the systick
+     * interrupt. These callbacks should be short and cannot use any
+     * syscalls. When a StackSize is provided the callbacks run from
+     * a daemon task with the given priority.
+     *
+     * @tparam StackSize stack size of the daemon task. 0 to run the
+     * callbacks from the tick
+     * @tparam Priority priority of the daemon task
+     * @tparam Levels amount of levels in the timer wheel
+     */
+    template <uint32_t StackSize = 0, uint8_t Priority = detail::max_priority - 1, uint32_t Levels = 4>
+    class timer_service {
+    public:
+        // flag if the callbacks run from the daemon task
+        constexpr static bool daemon = (StackSize > 0);
+
+    protected:
+        // the timers that are running
+        static inline detail::timer_wheel<Levels> wheel = {};
+
+        // timers that have expired and are waiting for the daemon task
+        static inline detail::timer_list expired = {};
+
+        /**
+         * @brief Add a periodic timer to the wheel again
+         *
+         * @param timer
+         */
+        static void restart(rtos::timer* timer) {
+            timer->expires += timer->period;
+
+            // expire in the next tick when the daemon task has missed
+            // periods
+            if (static_cast<int32_t>(timer->expires - wheel.time()) <= 0) {
+                timer->expires = wheel.time() + 1;
+            }
+
+            wheel.add(timer);
+        }
+
+        /**
+         * @brief Function of the daemon task. Calls the callbacks of
+         * the expired timers
+         *
+         */
+        static void daemon_func() {
+            while (true) {
+                // wait for the next expired timer
+                rtos::timer *const timer = syscall::next_timer();
+
+                if (timer != nullptr) {
+                    timer->callback();
+                }
+            }
+        }
+
+        // daemon task that calls the callbacks. Only used when a
+        // stack size is provided
+        static inline auto daemon_task = task<Priority, StackSize>(daemon_func);
+
+    public:
+        /**
+         * @brief Get the daemon task
+         *
+         * @return detail::base_task*
+         */
+        static detail::base_task* get_task() {
+            return &daemon_task;
+        }
+
+        /**
+         * @brief Returns if timers are waiting for the daemon task
+         *
+         * @return true
+         * @return false
+         */
+        static bool has_expired() {
+            return !expired.empty();
+        }
+
+        /**
+         * @brief Move the time of the timers to now. Calls the callbacks
+         * of the expired timers or moves them to the daemon task
+         *
+         * @param now
+         */
+        static void advance(const klib::time::ms now) {
+            wheel.advance(now.value, [](rtos::timer* timer) {
+                if constexpr (daemon) {
+                    // the daemon task restarts periodic timers after
+                    // it got the timer
+                    expired.push_back(timer);
+                }
+                else {
+                    // restart periodic timers before the callback so
+                    // the callback can stop the timer
+                    if (timer->period) {
+                        restart(timer);
+                    }
+
+                    timer->callback();
+                }
+            });
+        }
+
+        /**
+         * @brief Get the amount of ticks until the next timer needs
+         * to be handled
+         *
+         * @param now
+         * @return uint32_t
+         */
+        static uint32_t next_event(const klib::time::ms now) {
+            if (wheel.empty()) {
+                return 0xffffffff;
+            }
+
+            const int32_t ticks = static_cast<int32_t>(wheel.next_event() - now.value);
+
+            return (ticks <= 0) ? 0 : ticks;
+        }
+
+        /**
+         * @brief Start a timer. Restarts the timer if it is already
+         * running. The time should be advanced before this is called
+         *
+         * @param timer
+         * @param ticks
+         * @param periodic
+         * @return true
+         */
+        static bool start(rtos::timer* timer, const uint32_t ticks, const bool periodic) {
+            stop(timer);
+
+            // a timer expires at least one tick from now
+            const uint32_t time = klib::max(ticks, static_cast<uint32_t>(1));
+
+            timer->period = periodic ? time : 0;
+            timer->expires = wheel.time() + time;
+
+            wheel.add(timer);
+
+            return true;
+        }
+
+        /**
+         * @brief Stop a timer
+         *
+         * @param timer
+         */
+        static void stop(rtos::timer* timer) {
+            // check if the timer is running
+            if (timer->list == nullptr) {
+                return;
+            }
+
+            if (wheel.contains(timer->list)) {
+                wheel.remove(timer);
+            }
+            else {
+                expired.remove(timer);
+            }
+        }
+
+        /**
+         * @brief Get the next expired timer for the daemon task.
+         * Restarts the timer if it is periodic
+         *
+         * @return rtos::timer* nullptr if no timer has expired
+         */
+        static rtos::timer* pop_expired() {
+            rtos::timer *const timer = expired.pop_front();
+
+            if (timer != nullptr && timer->period) {
+                restart(timer);
+            }
+
+            return timer;
+        }
+    };
+}
+
+#endif
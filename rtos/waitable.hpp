@@ -1,23 +1,54 @@
 #ifndef KLIB_RTOS_WAITABLE_HPP
 #define KLIB_RTOS_WAITABLE_HPP
 
+#include "base_task.hpp"
+
 namespace klib::rtos {
     /**
      * @brief Interface for waitable objects. A waitable object can be
      * waited on by a task
      * 
+     * @details tasks that wait on the object are stored in the wait
+     * queue of the object and are not scheduled until the object is
+     * released. The scheduler hands the object directly to the highest
+     * priority waiter. When the object has a owner (e.g. a mutex) the
+     * owner inherits the priority of the highest priority waiter.
+     * 
      */
     class waitable {
     public:
+        // tasks waiting on this object. Sorted on priority, tasks with 
+        // the same priority are in the order they started waiting
+        detail::task_list waiters = {};
+
+        // task that owns the object. Only set by objects that have a
+        // owner. Used by the scheduler for priority inheritance
+        detail::base_task* owner = nullptr;
+
+        // next object in the list of objects the owner holds
+        waitable* next_held = nullptr;
+
         /**
-         * @brief Check if the waitable object is currently
-         * being waited on.
+         * @brief Try to acquire the object for a task. Called by the 
+         * scheduler, so no other task runs while this is called
          * 
-         * @return true 
+         * @param task 
+         * @return true the task acquired the object
          * @return false 
          */
-        virtual bool is_waiting() const = 0;
+        virtual bool try_acquire(detail::base_task* task) = 0;
+
+        /**
+         * @brief Release the object. Called by the scheduler, after 
+         * this the scheduler tries to acquire the object for the 
+         * highest priority waiter
+         * 
+         * @return true the object can be acquired again
+         * @return false the object is still held (e.g. a recursive
+         * mutex that is locked multiple times)
+         */
+        virtual bool release() = 0;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
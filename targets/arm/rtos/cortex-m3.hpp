@@ -170,6 +170,24 @@ namespace klib::rtos::cortex_m3 {
         );
     }
 
+    /**
+     * @brief Request a context switch by triggering the pendsv
+     * interrupt. The switch is done when no other interrupt is
+     * active
+     * 
+     */
+    static void request_switch() {
+        SCB->ICSR = (0x1 << 28);
+    }
+
+    /**
+     * @brief Wait until a interrupt occurs
+     * 
+     */
+    static void wait_for_interrupt() {
+        asm volatile("wfi");
+    }
+
     /**
      * @brief Start the scheduler by switching to unprivileged mode and 
      * switching to the process stack pointer
@@ -0,0 +1,379 @@
+#ifndef KLIB_HOST_HPP
+#define KLIB_HOST_HPP
+
+#include <cstdint>
+
+namespace klib::host {
+    /**
+     * @brief Simulated interrupt controller for the host. Interrupts
+     * only run at defined points: when they are triggered, when the
+     * global interrupts are enabled again or when the cpu waits for
+     * a interrupt. This makes the order of execution deterministic.
+     *
+     * @details interrupts run on the stack of the code that triggers
+     * them. Pending interrupts run in order of their number. The
+     * pendsv interrupt always runs last as it has the lowest priority
+     * on the arm targets.
+     *
+     * @tparam CpuId
+     * @tparam IrqCount
+     */
+    template <uint32_t CpuId, uint16_t IrqCount>
+    class simulated_irq {
+    public:
+        // using for the array of callbacks
+        using interrupt_callback = void (*)();
+
+        /**
+         * @brief Available arm vector entries. Uses the same numbers
+         * as the arm targets so the same code can run on the host
+         *
+         */
+        enum class arm_vector: uint8_t {
+            stack_ptr = 0,
+            reset = 1,
+            nmi = 2,
+            hard_fault = 3,
+            memory_managagement_fault = 4,
+            bus_fault = 5,
+            usage_fault = 6,
+            svcall = 11,
+            pendsv = 14,
+            systick = 15,
+            // end of the arm vector table. vector count should not
+            // be used as a valid vector entry.
+            count
+        };
+
+        // make sure we have at least enough entries to fit the arm vector table
+        static_assert(IrqCount >= static_cast<const uint8_t>(arm_vector::count),
+            "Invalid IRQ count, cannot fit the arm vector table"
+        );
+
+    protected:
+        // array with all the function callbacks
+        static inline interrupt_callback callbacks[IrqCount] = {};
+
+        // pending and enabled flags of every interrupt
+        static inline bool pending[IrqCount] = {};
+        static inline bool disabled[IrqCount] = {};
+
+        // flag if the global interrupts are disabled
+        static inline bool masked = false;
+
+        // amount of active interrupts. Pending interrupts are only
+        // handled when no interrupt is active (no nesting)
+        static inline uint32_t active = 0;
+
+        /**
+         * @brief Run a interrupt handler
+         *
+         * @param irq
+         */
+        static void execute(const uint32_t irq) {
+            // clear the pending flag before calling the handler so it
+            // can be triggered again from the handler
+            pending[irq] = false;
+
+            if (callbacks[irq] == nullptr) {
+                return;
+            }
+
+            active++;
+            callbacks[irq]();
+            active--;
+        }
+
+    public:
+        /**
+         * @brief Init the interrupt controller. Clears all the
+         * handlers and pending interrupts
+         *
+         */
+        static void init() {
+            for (uint32_t i = 0; i < IrqCount; i++) {
+                callbacks[i] = nullptr;
+                pending[i] = false;
+                disabled[i] = false;
+            }
+
+            masked = false;
+            active = 0;
+        }
+
+        /**
+         * @brief Register a interrupt handler
+         *
+         * @tparam Irq
+         * @param callback
+         */
+        template <uint32_t Irq>
+        static void register_irq(const interrupt_callback &callback) {
+            static_assert(Irq < IrqCount, "Invalid IRQ given to register");
+
+            callbacks[Irq] = callback;
+        }
+
+        /**
+         * @brief Register a arm vector handler
+         *
+         * @tparam Irq
+         * @param callback
+         */
+        template <arm_vector Irq>
+        static void register_irq(const interrupt_callback &callback) {
+            static_assert(Irq < arm_vector::count, "Count can not not be used as a arm vector entry");
+
+            register_irq<static_cast<uint32_t>(Irq)>(callback);
+        }
+
+        /**
+         * @brief Unregister a interrupt handler
+         *
+         * @tparam Irq
+         */
+        template <uint32_t Irq>
+        static void unregister_irq() {
+            static_assert(Irq < IrqCount, "Invalid IRQ given to unregister");
+
+            callbacks[Irq] = nullptr;
+        }
+
+        /**
+         * @brief Enable or disable a single interrupt
+         *
+         * @tparam Irq
+         * @param enabled
+         */
+        template <uint32_t Irq>
+        static void set_enabled(const bool enabled) {
+            static_assert(Irq < IrqCount, "Invalid IRQ given to enable");
+
+            disabled[Irq] = !enabled;
+
+            // run the interrupt if it was pending
+            handle_pending();
+        }
+
+        /**
+         * @brief Enable or disable all the interrupts
+         *
+         * @param enabled
+         */
+        static void set_global(const bool enabled) {
+            masked = !enabled;
+
+            // run the interrupts that were pending
+            handle_pending();
+        }
+
+        /**
+         * @brief Mark a interrupt as pending. It runs at the next
+         * point interrupts are handled
+         *
+         * @tparam Irq
+         */
+        template <uint32_t Irq>
+        static void pend() {
+            static_assert(Irq < IrqCount, "Invalid IRQ given to pend");
+
+            pending[Irq] = true;
+        }
+
+        /**
+         * @brief Mark a arm vector as pending
+         *
+         * @tparam Irq
+         */
+        template <arm_vector Irq>
+        static void pend() {
+            pend<static_cast<uint32_t>(Irq)>();
+        }
+
+        /**
+         * @brief Trigger a interrupt. Runs directly when interrupts
+         * are enabled and no other interrupt is active
+         *
+         * @tparam Irq
+         */
+        template <uint32_t Irq>
+        static void trigger() {
+            pend<Irq>();
+            handle_pending();
+        }
+
+        /**
+         * @brief Trigger a arm vector
+         *
+         * @tparam Irq
+         */
+        template <arm_vector Irq>
+        static void trigger() {
+            trigger<static_cast<uint32_t>(Irq)>();
+        }
+
+        /**
+         * @brief Run a synchronous exception (e.g. svcall). These
+         * ignore the global interrupt mask the same way a svc
+         * instruction does. Interrupts pended by the handler are
+         * handled afterwards
+         *
+         * @tparam Irq
+         */
+        template <arm_vector Irq>
+        static void exception() {
+            execute(static_cast<uint32_t>(Irq));
+
+            handle_pending();
+        }
+
+        /**
+         * @brief Returns if a interrupt can run
+         *
+         * @return true
+         * @return false
+         */
+        static bool has_pending() {
+            for (uint32_t i = 0; i < IrqCount; i++) {
+                if (pending[i] && !disabled[i]) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Run all the pending interrupts
+         *
+         */
+        static void handle_pending() {
+            // do not nest interrupts
+            while (!masked && !active) {
+                constexpr uint32_t pendsv = static_cast<uint32_t>(arm_vector::pendsv);
+                uint32_t irq = IrqCount;
+
+                // search the first pending interrupt. Pendsv has the
+                // lowest priority
+                for (uint32_t i = 0; i < IrqCount; i++) {
+                    if (pending[i] && !disabled[i] && i != pendsv) {
+                        irq = i;
+                        break;
+                    }
+                }
+
+                if (irq == IrqCount) {
+                    // check if we still need to run pendsv
+                    if (!pending[pendsv]) {
+                        return;
+                    }
+
+                    irq = pendsv;
+                }
+
+                execute(irq);
+            }
+        }
+
+        /**
+         * @brief Get the amount of active interrupts. Used to save
+         * the state when switching between contexts
+         *
+         * @return uint32_t
+         */
+        static uint32_t get_active() {
+            return active;
+        }
+
+        /**
+         * @brief Restore the amount of active interrupts. Used when
+         * switching between contexts
+         *
+         * @param value
+         */
+        static void set_active(const uint32_t value) {
+            active = value;
+        }
+    };
+
+    // irq for the host
+    using irq = simulated_irq<0, 16 + 32>;
+
+    // amount of cpu cores
+    constexpr static uint32_t cpu_cores = 1;
+
+    /**
+     * @brief Get the current cpu id
+     *
+     * @return uint32_t
+     */
+    static uint32_t get_cpu_id() {
+        // NOTE: the host simulates a single core. So we
+        // always return id 0
+        return 0;
+    }
+
+    /**
+     * @brief Enable a interrupt
+     *
+     * @tparam Irq
+     */
+    template <uint32_t Irq>
+    static void enable_irq() {
+        static_assert(Irq >= static_cast<uint32_t>(irq::arm_vector::count), "Invalid IRQ given to enable");
+
+        // enable the irq
+        irq::set_enabled<Irq>(true);
+    }
+
+    /**
+     * @brief Disable a interrupt
+     *
+     * @tparam Irq
+     */
+    template <uint32_t Irq>
+    static void disable_irq() {
+        static_assert(Irq >= static_cast<uint32_t>(irq::arm_vector::count), "Invalid IRQ given to disable");
+
+        // disable the irq
+        irq::set_enabled<Irq>(false);
+    }
+
+    /**
+     * @brief Global enable interrupts.
+     *
+     */
+    static void enable_irq() {
+        irq::set_global(true);
+    }
+
+    /**
+     * @brief Global disable interrupts. Prevents any interrupt from triggering
+     *
+     */
+    static void disable_irq() {
+        irq::set_global(false);
+    }
+
+    /**
+     * @brief Set the priority of a interrupt. Not supported on the host
+     *
+     * @tparam Irq
+     */
+    template <irq::arm_vector Irq, uint8_t Priority>
+    static void interrupt_priority() {
+        // the simulated interrupts do not have a priority
+    }
+
+    /**
+     * @brief Set the priority of a interrupt. Not supported on the host
+     *
+     * @tparam Irq
+     */
+    template <uint32_t Irq, uint8_t Priority>
+    static void interrupt_priority() {
+        // the simulated interrupts do not have a priority
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,188 @@
+#ifndef KLIB_HOST_SIMULATED_SYSTICK_HPP
+#define KLIB_HOST_SIMULATED_SYSTICK_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+#include <klib/units.hpp>
+
+namespace klib::host::io {
+    /**
+     * @brief Simulated systick for the host. Has the same interface as
+     * klib::io::systick. Time only moves when the systick interrupt is
+     * triggered (every trigger is 1 ms). This keeps the simulated time
+     * independent of the speed of the host.
+     *
+     * @tparam CpuId
+     * @tparam Callback
+     */
+    template <uint32_t CpuId = 0, bool Callback = true>
+    class simulated_systick {
+    protected:
+        // using for the array of callbacks
+        using interrupt_callback = void (*)();
+
+        // additional callback when the systick is triggered.
+        static inline interrupt_callback callback = nullptr;
+
+        // current runtime value in ms
+        static inline time::ms runtime = 0;
+
+        // flag if the timer is enabled
+        static inline bool enabled = false;
+
+        // amount of ticks the next interrupt is delayed for
+        static inline uint32_t suppressed = 0;
+
+        // amount of interrupts the timer has generated. Used to
+        // check how often the cpu is woken up
+        static inline uint32_t interrupts = 0;
+
+    public:
+        /**
+         * @brief Init the systick. The clock is ignored on the host
+         *
+         * @tparam Irq
+         * @tparam ExternalClockSource
+         * @param clock
+         */
+        template <typename Irq, bool ExternalClockSource = false>
+        static void init(const uint32_t clock = 0) {
+            // clear the runtime
+            runtime = 0;
+            suppressed = 0;
+            interrupts = 0;
+
+            // register our handler
+            Irq::template register_irq<Irq::arm_vector::systick>(irq_handler);
+        }
+
+        /**
+         * @brief Disable the timer
+         *
+         */
+        static void disable() {
+            enabled = false;
+        }
+
+        /**
+         * @brief Enable the timer
+         *
+         */
+        static void enable() {
+            enabled = true;
+        }
+
+        /**
+         * @brief Returns the current value of the counter. The
+         * simulated timer does not have any time between ticks
+         *
+         * @return uint32_t
+         */
+        static uint32_t get_counter() {
+            return 0;
+        }
+
+        /**
+         * @brief Clear the counter in the timer
+         *
+         */
+        static void clear_counter() {
+            // nothing to clear
+        }
+
+        /**
+         * @brief Get the runtime in the requested time unit
+         *
+         * @tparam T
+         * @return T
+         */
+        template <typename T = time::ms>
+        static T get_runtime() requires time::is_time_unit<T> {
+            if constexpr (std::is_same_v<T, time::ms>) {
+                return runtime;
+            }
+            else {
+                return static_cast<T>(runtime);
+            }
+        }
+
+        /**
+         * @brief Delay the next interrupt by a amount of ticks. The
+         * next interrupt adds all the suppressed ticks to the runtime
+         *
+         * @param ticks
+         * @return uint32_t amount of ticks the interrupt is delayed
+         */
+        static uint32_t suppress_ticks(const uint32_t ticks) {
+            // check if we need to suppress anything
+            if (ticks <= 1) {
+                return 0;
+            }
+
+            suppressed = ticks;
+
+            return ticks;
+        }
+
+        /**
+         * @brief Start the normal tick again after a early wakeup. No
+         * time passes between interrupts on the host so we do not need
+         * to update the runtime
+         *
+         */
+        static void resume_ticks() {
+            suppressed = 0;
+        }
+
+        /**
+         * @brief Get the amount of interrupts the timer has generated
+         *
+         * @return uint32_t
+         */
+        static uint32_t get_interrupts() {
+            return interrupts;
+        }
+
+        /**
+         * @brief Register a callback after the init sequence
+         *
+         * @param irq
+         */
+        static void set_callback(const interrupt_callback& irq = nullptr) {
+            // only register the callback when enabled
+            if constexpr (Callback) {
+                // register the callback
+                callback = irq;
+            }
+        }
+
+        /**
+         * @brief Interrupt handler. Should not be called by the user.
+         * Use the irq to trigger a systick
+         *
+         */
+        static void irq_handler() {
+            // check if the timer is running
+            if (!enabled) {
+                return;
+            }
+
+            // increment the current runtime value with all the
+            // ticks we have suppressed
+            runtime.value += (suppressed ? suppressed : 1);
+            suppressed = 0;
+            interrupts++;
+
+            // only run the callback when enabled
+            if constexpr (Callback) {
+                // run the callback if provided
+                if (callback) {
+                    callback();
+                }
+            }
+        }
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,307 @@
+#ifndef KLIB_HOST_RTOS_HPP
+#define KLIB_HOST_RTOS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <ucontext.h>
+
+#include <klib/klib.hpp>
+#include <klib/units.hpp>
+#include <rtos/base_task.hpp>
+#include <rtos/syscall.hpp>
+
+// size of the stack of every task on the host. The stack of the task
+// itself is too small for the host libraries (e.g. printf)
+#ifndef KLIB_HOST_STACK_SIZE
+    #define KLIB_HOST_STACK_SIZE (64 * 1024)
+#endif
+
+namespace klib::host::rtos::detail {
+    /**
+     * @brief Execution context of a task on the host
+     *
+     */
+    struct context {
+        // the saved registers and stack of the context
+        ucontext_t ucontext;
+
+        // amount of active interrupts when the context was suspended
+        uint32_t active;
+
+        // function that runs the task when the context is started
+        void (*entry)(context*);
+
+        // result of the last syscall of the context. A syscall can
+        // switch to a different context before the caller reads the
+        // result (the stacked r0 on arm)
+        uintptr_t result;
+    };
+
+    /**
+     * @brief Context with the function and the parameters of a task
+     *
+     * @tparam Args
+     */
+    template <typename... Args>
+    struct task_context: public context {
+        // the function of the task
+        void (*func)(Args...);
+
+        // parameters passed to the function
+        std::tuple<std::decay_t<Args>...> parameters;
+    };
+
+    // context of the code that started the scheduler
+    inline context main_context = {};
+
+    // context that is running at the moment
+    inline context* running = &main_context;
+
+    // simulated registers used to pass the syscall number and the
+    // arguments to the svcall handler (r0-r3 on arm)
+    inline uintptr_t registers[4] = {};
+
+    // flag if the scheduler should return to the main context
+    inline bool stopped = false;
+
+    /**
+     * @brief Switch to a different context. Returns when the current
+     * context is switched to again
+     *
+     * @param next
+     */
+    inline void switch_context(context* next) {
+        context *const current = running;
+
+        // check if we need to switch
+        if (current == next) {
+            return;
+        }
+
+        // save the amount of active interrupts. Every context has its
+        // own state the same way the stacked exception frame on arm
+        // does
+        current->active = klib::host::irq::get_active();
+
+        running = next;
+        swapcontext(&current->ucontext, &next->ucontext);
+
+        // we are running again. Restore the interrupt state
+        klib::host::irq::set_active(running->active);
+    }
+
+    /**
+     * @brief Entry point of every context on the host
+     *
+     */
+    inline void start_context() {
+        // new contexts start in thread mode
+        klib::host::irq::set_active(0);
+
+        running->entry(running);
+    }
+
+    /**
+     * @brief Convert a syscall argument to a register value
+     *
+     * @tparam T
+     * @param value
+     * @return uintptr_t
+     */
+    template <typename T>
+    uintptr_t to_register(const T value) {
+        if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<uintptr_t>(value);
+        }
+        else {
+            return static_cast<uintptr_t>(value);
+        }
+    }
+
+    /**
+     * @brief Setup the context of a task. The task gets its own host
+     * stack of KLIB_HOST_STACK_SIZE bytes. The stack of the task is
+     * not used on the host
+     *
+     * @tparam Args
+     * @param func
+     * @param stack
+     * @param stack_size
+     * @param parameters
+     * @return size_t* pointer to the context of the task
+     */
+    template <typename... Args>
+    size_t* setup_task_stack(void (*func)(Args...), size_t* stack, const size_t stack_size, Args&&... parameters) {
+        // create the context with the function and the parameters
+        auto *const ctx = new (std::malloc(sizeof(task_context<Args...>))) task_context<Args...>{};
+
+        ctx->func = func;
+        ctx->parameters = {parameters...};
+        ctx->active = 0;
+        ctx->entry = [](context* c) {
+            auto *const task = static_cast<task_context<Args...>*>(c);
+
+            std::apply(task->func, task->parameters);
+        };
+
+        // create the host context on its own stack
+        getcontext(&ctx->ucontext);
+
+        ctx->ucontext.uc_stack.ss_sp = std::malloc(KLIB_HOST_STACK_SIZE);
+        ctx->ucontext.uc_stack.ss_size = KLIB_HOST_STACK_SIZE;
+        ctx->ucontext.uc_link = &main_context.ucontext;
+
+        makecontext(&ctx->ucontext, start_context, 0);
+
+        // the stack of the task is not used
+        (void)stack;
+        (void)stack_size;
+
+        return reinterpret_cast<size_t*>(ctx);
+    }
+
+    /**
+     * @brief Switch between tasks. Called from the pendsv handler. The
+     * context of the current task is saved by the switch
+     *
+     * @param current_task
+     * @param next_task
+     */
+    inline void switch_task(klib::rtos::detail::base_task** current_task, klib::rtos::detail::base_task** next_task) {
+        // update the current task before switching as the next task
+        // continues after this point
+        *current_task = *next_task;
+
+        switch_context(reinterpret_cast<context*>((*current_task)->stack_pointer));
+    }
+
+    /**
+     * @brief Request a context switch by pending the pendsv interrupt.
+     * The switch is done when no other interrupt is active
+     *
+     */
+    inline void request_switch() {
+        klib::host::irq::pend<klib::host::irq::arm_vector::pendsv>();
+        klib::host::irq::handle_pending();
+    }
+
+    /**
+     * @brief Wait until a interrupt occurs. When nothing is pending
+     * the time moves to the next systick interrupt
+     *
+     */
+    inline void wait_for_interrupt() {
+        if (klib::host::irq::has_pending()) {
+            klib::host::irq::handle_pending();
+        }
+        else {
+            klib::host::irq::trigger<klib::host::irq::arm_vector::systick>();
+        }
+    }
+
+    /**
+     * @brief Start the scheduler. Returns when a task calls
+     * klib::host::rtos::stop. Calling this again continues the
+     * simulation where it was stopped
+     *
+     */
+    inline void scheduler_start() {
+        stopped = false;
+
+        // wait until a task stops the scheduler. The systick
+        // interrupt switches to the first task
+        while (!stopped) {
+            wait_for_interrupt();
+        }
+    }
+
+    /**
+     * @brief Svcall handler. Reads the syscall from the simulated
+     * registers and stores the result in the calling context. The
+     * context switch is done after the handler returns so the caller
+     * is still running
+     *
+     * @tparam Scheduler
+     */
+    template <typename Scheduler>
+    void syscall_handler() {
+        running->result = Scheduler::syscall_handler(
+            static_cast<klib::rtos::detail::syscalls>(registers[0]),
+            registers[1], registers[2], registers[3]
+        );
+    }
+
+    /**
+     * @brief Invoke a syscall using the simulated svcall exception
+     *
+     * @tparam Return
+     * @tparam Args
+     * @param syscall_number
+     * @param args
+     * @return Return
+     */
+    template <typename Return, typename... Args>
+    Return syscall_invoke(uint8_t syscall_number, Args... args) {
+        // make sure we have at most 3 arguments
+        static_assert(sizeof...(Args) <= 3, "A maximum of 3 arguments can be used in a syscall");
+
+        // store the arguments in the registers
+        const uintptr_t values[4] = {syscall_number, to_register(args)...};
+
+        for (uint32_t i = 0; i < 4; i++) {
+            registers[i] = values[i];
+        }
+
+        // invoke the syscall. We are running again when this returns
+        klib::host::irq::exception<klib::host::irq::arm_vector::svcall>();
+
+        const uintptr_t ret = running->result;
+
+        // convert the return value based on type
+        if constexpr (std::is_void_v<Return>) {
+            return;
+        }
+        else if constexpr (std::is_same_v<Return, bool>) {
+            return static_cast<bool>(ret);
+        }
+        else if constexpr (std::is_pointer_v<Return>) {
+            return reinterpret_cast<Return>(ret);
+        }
+        else {
+            return static_cast<Return>(ret);
+        }
+    }
+}
+
+namespace klib::host::rtos {
+    /**
+     * @brief Stop the scheduler. Returns to the code that started
+     * the scheduler. Should be called from a task
+     *
+     */
+    inline void stop() {
+        detail::stopped = true;
+
+        detail::switch_context(&detail::main_context);
+    }
+
+    /**
+     * @brief Simulate a task using the cpu for a amount of time. Every
+     * ms the systick interrupt is triggered, which can switch to other
+     * tasks. Tasks on the host are only preempted in syscalls and in
+     * this function
+     *
+     * @param time
+     */
+    inline void consume(const klib::time::ms time) {
+        for (uint32_t i = 0; i < time.value; i++) {
+            klib::host::irq::trigger<klib::host::irq::arm_vector::systick>();
+        }
+    }
+}
+
+#endif
\ No newline at end of file